@@ -0,0 +1,124 @@
+#include "nbsim/benchmark/distributions.hpp"
+
+#include <cmath>
+#include <map>
+#include <numbers>
+#include <random>
+#include <utility>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+
+using namespace std;
+
+namespace {
+// Seed of all benchmark distributions
+constexpr unsigned SEED = 42;
+// Mass of every body
+constexpr double MASS = 1e30;
+// Size of every distribution: the half width of the cube, the Plummer radius
+// and the scale length of the disk
+constexpr double SCALE = 1e15;
+
+// Bodies are always drawn in double precision and only then rounded to the
+// build's scalar type, so that every precision mode sees the same system.
+
+// Returns a direction drawn uniformly from the unit sphere
+Vec3T<double> randomDirection(mt19937& twister) {
+    uniform_real_distribution<double> unit(-1, 1);
+    uniform_real_distribution<double> angle(0, 2 * numbers::pi);
+    const double z = unit(twister);
+    const double phi = angle(twister);
+    const double r = sqrt(1 - z * z);
+    return Vec3T<double>{r * cos(phi), r * sin(phi), z};
+}
+} // namespace
+
+string distributionName(Distribution distribution) {
+    switch (distribution) {
+    case Distribution::UNIFORM:
+        return "uniform";
+    case Distribution::PLUMMER:
+        return "plummer";
+    default:
+        return "disk";
+    }
+}
+
+vector<Body> uniformBodies(size_t count, unsigned seed) {
+    mt19937 twister(seed);
+    uniform_real_distribution<double> positionGen(-SCALE, SCALE);
+    uniform_real_distribution<double> velocityGen(-5e4, 5e4);
+    vector<Body> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        Vec3T<double> position{positionGen(twister), positionGen(twister), positionGen(twister)};
+        Vec3T<double> velocity{velocityGen(twister), velocityGen(twister), velocityGen(twister)};
+        result.push_back(Body(MASS, position.to<Real>(), velocity.to<Real>(), Vec3{0, 0, 0}));
+    }
+    return result;
+}
+
+vector<Body> plummerBodies(size_t count, unsigned seed) {
+    mt19937 twister(seed);
+    uniform_real_distribution<double> unit(0, 1);
+    const double totalMass = MASS * double(count);
+    vector<Body> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        // invert the cumulative mass profile, cutting off the few bodies
+        // beyond ten radii
+        double radius;
+        do {
+            radius = SCALE / sqrt(pow(unit(twister), -2.0 / 3.0) - 1);
+        } while (radius > 10 * SCALE);
+        // speeds relative to the local escape speed follow
+        // q^2 (1 - q^2)^(7/2), sampled by rejection
+        double q, g;
+        do {
+            q = unit(twister);
+            g = 0.1 * unit(twister);
+        } while (g > q * q * pow(1 - q * q, 3.5));
+        const double escape = sqrt(2 * GRAVITATIONAL_CONSTANT * totalMass / sqrt(radius * radius + SCALE * SCALE));
+        const Vec3T<double> position = randomDirection(twister) * radius;
+        const Vec3T<double> velocity = randomDirection(twister) * (q * escape);
+        result.push_back(Body(MASS, position.to<Real>(), velocity.to<Real>(), Vec3{0, 0, 0}));
+    }
+    return result;
+}
+
+vector<Body> diskBodies(size_t count, unsigned seed) {
+    mt19937 twister(seed);
+    uniform_real_distribution<double> unit(0, 1);
+    uniform_real_distribution<double> angle(0, 2 * numbers::pi);
+    normal_distribution<double> height(0, 0.05 * SCALE);
+    const double totalMass = MASS * double(count);
+    vector<Body> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        // the radius of an exponential disk is the sum of two exponentially
+        // distributed lengths
+        const double radius = -SCALE * log((1 - unit(twister)) * (1 - unit(twister)));
+        const double phi = angle(twister);
+        const double x = radius / SCALE;
+        const double enclosed = totalMass * (1 - (1 + x) * exp(-x));
+        const double speed = radius > 0 ? sqrt(GRAVITATIONAL_CONSTANT * enclosed / radius) : 0;
+        Vec3T<double> position{radius * cos(phi), radius * sin(phi), height(twister)};
+        Vec3T<double> velocity{-speed * sin(phi), speed * cos(phi), 0};
+        result.push_back(Body(MASS, position.to<Real>(), velocity.to<Real>(), Vec3{0, 0, 0}));
+    }
+    return result;
+}
+
+const vector<Body>& bodies(Distribution distribution, size_t count) {
+    static map<pair<Distribution, size_t>, vector<Body>> cache;
+    auto [entry, inserted] = cache.try_emplace({distribution, count});
+    if (inserted) {
+        if (distribution == Distribution::UNIFORM)
+            entry->second = uniformBodies(count, SEED);
+        else if (distribution == Distribution::PLUMMER)
+            entry->second = plummerBodies(count, SEED);
+        else
+            entry->second = diskBodies(count, SEED);
+    }
+    return entry->second;
+}
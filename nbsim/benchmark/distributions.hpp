@@ -0,0 +1,34 @@
+#pragma once
+#ifndef DISTRIBUTIONS_H
+#define DISTRIBUTIONS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "nbsim/core/octree/body.hpp"
+
+// Initial conditions benchmarks run on. Every distribution is drawn from a
+// fixed seed, so runs on different builds see the same bodies.
+enum class Distribution : int { UNIFORM, PLUMMER, DISK };
+
+// Returns the name of a distribution, for benchmark labels
+std::string distributionName(Distribution distribution);
+
+// Returns count bodies of equal mass spread uniformly through a cube, with
+// random velocities
+std::vector<Body> uniformBodies(size_t count, unsigned seed);
+
+// Returns count bodies of equal mass drawn from a Plummer sphere in virial
+// equilibrium, which is strongly concentrated towards its center
+std::vector<Body> plummerBodies(size_t count, unsigned seed);
+
+// Returns count bodies of equal mass drawn from a thin exponential disk, on
+// circular orbits around its center
+std::vector<Body> diskBodies(size_t count, unsigned seed);
+
+// Returns count bodies of the given distribution. Bodies are generated once
+// per distribution and count, and shared by all later calls.
+const std::vector<Body>& bodies(Distribution distribution, size_t count);
+
+#endif
@@ -0,0 +1,179 @@
+#include <benchmark/benchmark.h>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "nbsim/benchmark/distributions.hpp"
+#include "nbsim/core/input/body_parser.hpp"
+#include "nbsim/core/octree/octree.hpp"
+#include "nbsim/core/snapshot/snapshot_writer.hpp"
+#include "nbsim/engine/engine.hpp"
+
+// Benchmarks of the phases of a simulation step and of input and output.
+//
+// Every benchmark runs over fixed seed distributions of 1e3 to 1e6 bodies.
+// Run with --benchmark_format=json, or --benchmark_out=file.json, for machine
+// readable results, and --benchmark_filter=regex to pick benchmarks.
+
+using namespace std;
+
+// Grants access to the phases of Engine::step
+struct EnginePhases {
+    static void updateForces(Engine& engine) { engine.updateForces(engine.theta); }
+    static void updateMotion(Engine& engine) { engine.updateMotion(engine.dt); }
+};
+
+namespace {
+// Opening parameter and time step of all engine benchmarks
+constexpr double THETA = 0.5;
+constexpr double DT = 100;
+
+// Ways of computing forces that are compared
+enum class ForceSetup : int { POINTER, FLAT_GROUPED, FMM, DIRECT };
+
+// Stream buffer that discards everything written to it, so that output
+// benchmarks time encoding only
+class NullBuffer : public streambuf {
+  protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+// Counts processed bodies, so that results are also reported per body
+void countBodies(benchmark::State& state, size_t count) {
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(count));
+}
+
+// Returns bodies as an input file
+string inputJson(const vector<Body>& bodies) {
+    ostringstream out;
+    out << setprecision(17) << "{\"bodies\":[";
+    for (size_t i = 0; i < bodies.size(); i++) {
+        const Body& body = bodies[i];
+        out << (i ? "," : "") << "{\"mass\":" << body.mass << ",\"position\":{\"x\":" << body.position.x
+            << ",\"y\":" << body.position.y << ",\"z\":" << body.position.z << "},\"velocity\":{\"x\":"
+            << body.velocity.x << ",\"y\":" << body.velocity.y << ",\"z\":" << body.velocity.z << "}}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+// Registers every distribution with every body count, and the given extra
+// arguments
+void allDistributions(benchmark::internal::Benchmark* benchmark, const vector<int64_t>& extra) {
+    benchmark->ArgsProduct({{0, 1, 2}, {1000, 10000, 100000, 1000000}, extra});
+}
+
+void BM_BuildTree(benchmark::State& state) {
+    const Distribution distribution = Distribution(state.range(0));
+    vector<Body> input = bodies(distribution, size_t(state.range(1)));
+    Octree tree(input);
+    tree.setLayout(state.range(2) ? OctreeLayout::FLAT : OctreeLayout::POINTER);
+    for (auto _ : state) {
+        tree.buildTree();
+    }
+    countBodies(state, input.size());
+    state.SetLabel(distributionName(distribution));
+}
+BENCHMARK(BM_BuildTree)
+    ->Apply([](auto* benchmark) { allDistributions(benchmark, {0, 1}); })
+    ->ArgNames({"distribution", "bodies", "flat"})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_UpdateForces(benchmark::State& state) {
+    const Distribution distribution = Distribution(state.range(0));
+    const ForceSetup setup = ForceSetup(state.range(2));
+    vector<Body> input = bodies(distribution, size_t(state.range(1)));
+    Engine engine(THETA, DT, input);
+    if (setup != ForceSetup::POINTER) {
+        engine.setLayout(OctreeLayout::FLAT);
+        engine.setLeafSize(setup == ForceSetup::FMM ? 64 : 8);
+    }
+    if (setup == ForceSetup::FLAT_GROUPED)
+        engine.setGroupSize(32);
+    if (setup == ForceSetup::FMM)
+        engine.setSolver(ForceSolver::FMM);
+    if (setup == ForceSetup::DIRECT)
+        engine.setSolver(ForceSolver::DIRECT);
+    for (auto _ : state) {
+        EnginePhases::updateForces(engine);
+    }
+    countBodies(state, input.size());
+    state.SetLabel(distributionName(distribution));
+}
+BENCHMARK(BM_UpdateForces)
+    ->Apply([](auto* benchmark) {
+        allDistributions(
+            benchmark, {int64_t(ForceSetup::POINTER), int64_t(ForceSetup::FLAT_GROUPED), int64_t(ForceSetup::FMM)}
+        );
+        // direct summation of more bodies takes minutes per iteration
+        benchmark->ArgsProduct({{0, 1, 2}, {1000, 10000}, {int64_t(ForceSetup::DIRECT)}});
+    })
+    ->ArgNames({"distribution", "bodies", "setup"})
+    ->Unit(benchmark::kMillisecond);
+
+// Integration does not depend on where bodies are, so only one distribution
+// is timed
+void BM_UpdateMotion(benchmark::State& state) {
+    vector<Body> input = bodies(Distribution::UNIFORM, size_t(state.range(0)));
+    Engine engine(THETA, DT, input);
+    if (state.range(1)) {
+        engine.setLayout(OctreeLayout::FLAT);
+        engine.setStorage(BodyStorage::SOA);
+    }
+    for (auto _ : state) {
+        EnginePhases::updateMotion(engine);
+    }
+    countBodies(state, input.size());
+}
+BENCHMARK(BM_UpdateMotion)
+    ->ArgsProduct({{1000, 10000, 100000, 1000000}, {0, 1}})
+    ->ArgNames({"bodies", "soa"})
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_WriteSnapshot(benchmark::State& state) {
+    const Distribution distribution = Distribution(state.range(0));
+    const SnapshotFormat format = SnapshotFormat(state.range(2));
+    vector<Body> input = bodies(distribution, size_t(state.range(1)));
+    Engine engine(THETA, DT, input);
+    Snapshot snapshot;
+    engine.snapshot(snapshot);
+    NullBuffer buffer;
+    ostream out(&buffer);
+    SnapshotWriter writer(out, format);
+    writer.begin();
+    for (auto _ : state) {
+        writer.write(snapshot);
+    }
+    writer.end();
+    countBodies(state, input.size());
+    state.SetLabel(distributionName(distribution));
+}
+BENCHMARK(BM_WriteSnapshot)
+    ->Apply([](auto* benchmark) {
+        allDistributions(benchmark, {int64_t(SnapshotFormat::JSON), int64_t(SnapshotFormat::FLOAT64)});
+    })
+    ->ArgNames({"distribution", "bodies", "format"})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_ParseInput(benchmark::State& state) {
+    const Distribution distribution = Distribution(state.range(0));
+    const string text = inputJson(bodies(distribution, size_t(state.range(1))));
+    vector<Body> parsed;
+    for (auto _ : state) {
+        parsed.clear();
+        BodyParser(text).parse(parsed);
+        benchmark::DoNotOptimize(parsed.data());
+    }
+    countBodies(state, parsed.size());
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(text.size()));
+    state.SetLabel(distributionName(distribution));
+}
+BENCHMARK(BM_ParseInput)
+    ->ArgsProduct({{0, 1, 2}, {1000, 10000, 100000, 1000000}})
+    ->ArgNames({"distribution", "bodies"})
+    ->Unit(benchmark::kMillisecond);
+} // namespace
@@ -0,0 +1,92 @@
+#include "nbsim/core/direct/direct_solver.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+void DirectSolver::gather(const Octree& tree) {
+    const size_t count = tree.count();
+    xs.resize(count);
+    ys.resize(count);
+    zs.resize(count);
+    masses.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const Vec3 position = tree.getPosition(i);
+        xs[i] = position.x;
+        ys[i] = position.y;
+        zs[i] = position.z;
+        masses[i] = tree.getMass(i);
+    }
+}
+
+MutualBodies DirectSolver::tile(size_t index) {
+    const size_t begin = index * TILE;
+    const size_t count = min(TILE, xs.size() - begin);
+    return MutualBodies{
+        &xs[begin], &ys[begin], &zs[begin], &masses[begin], &axs[begin], &ays[begin], &azs[begin], count
+    };
+}
+
+void DirectSolver::interact(size_t first, size_t second) {
+    const MutualBodies targets = tile(first);
+    const MutualBodies sources = tile(second);
+    for (size_t i = 0; i < targets.count; i++) {
+        // within a tile, each body only meets the bodies after it
+        const MutualBodies others = first == second ? sources.from(i + 1) : sources;
+        const Vec3 pull = mutualGravity(others, Vec3{targets.x[i], targets.y[i], targets.z[i]}, targets.mass[i]);
+        targets.ax[i] += pull.x;
+        targets.ay[i] += pull.y;
+        targets.az[i] += pull.z;
+    }
+}
+
+void DirectSolver::evaluate(const Octree& tree, ThreadPool* pool, vector<Vec3>& accelerations) {
+    const size_t count = tree.count();
+    gather(tree);
+    axs.assign(count, 0);
+    ays.assign(count, 0);
+    azs.assign(count, 0);
+    const size_t tiles = (count + TILE - 1) / TILE;
+    forEach(pool, tiles, 1, [&](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; index++) {
+            interact(index, index);
+        }
+    });
+    // Round robin schedule: slot 0 stays put while the others rotate by one
+    // slot per round, and each round pairs up slot k with the slot mirrored
+    // from the end. With an odd number of tiles, the tile paired with the
+    // extra slot sits the round out.
+    const size_t slots = tiles + tiles % 2;
+    auto slotTile = [&](size_t round, size_t slot) { return slot == 0 ? 0 : 1 + (slot - 1 + round) % (slots - 1); };
+    for (size_t round = 0; round + 1 < slots; round++) {
+        forEach(pool, slots / 2, 1, [&](size_t begin, size_t end) {
+            for (size_t pair = begin; pair < end; pair++) {
+                const size_t first = slotTile(round, pair);
+                const size_t second = slotTile(round, slots - 1 - pair);
+                if (first < tiles && second < tiles)
+                    interact(first, second);
+            }
+        });
+    }
+    accelerations.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        accelerations[i] = Vec3{axs[i], ays[i], azs[i]};
+    }
+}
+
+void DirectSolver::evaluate(
+    const Octree& tree, ThreadPool* pool, const vector<uint32_t>& targets, vector<Vec3>& accelerations
+) {
+    const size_t count = tree.count();
+    gather(tree);
+    accelerations.resize(count);
+    auto sum = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t target = targets[i];
+            accelerations[target] = accelerationGravity(
+                xs.data(), ys.data(), zs.data(), masses.data(), count, tree.getPosition(target)
+            );
+        }
+    };
+    forEach(pool, targets.size(), GRAIN, sum);
+}
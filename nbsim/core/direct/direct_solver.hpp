@@ -0,0 +1,65 @@
+#pragma once
+#ifndef DIRECT_SOLVER_H
+#define DIRECT_SOLVER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include "nbsim/core/octree/octree.hpp"
+#include "nbsim/core/parallel/thread_pool.hpp"
+#include "nbsim/core/vec3/vec3.hpp"
+
+/**
+ * Computes exact gravitational accelerations by summing over all pairs of
+ * bodies. Needs no tree, so it is the fastest solver for small systems and
+ * the reference for the accuracy of the others.
+ *
+ * Bodies are split into tiles that fit in the L1 cache together, and every
+ * pair of tiles is evaluated once, applying each interaction to both bodies.
+ * Pairs of tiles are scheduled in rounds in which no tile appears twice, so
+ * the pairs of a round run on separate threads without sharing any
+ * accelerations, and every acceleration is summed in the same order however
+ * many threads there are.
+ */
+class DirectSolver {
+  private:
+    // Number of bodies per tile
+    static constexpr size_t TILE = 64;
+    // Number of target bodies handed to a thread at a time
+    static constexpr size_t GRAIN = 64;
+    // Positions, masses and accelerations of the bodies, in the order of the
+    // body buffer
+    std::vector<Real> xs, ys, zs, masses;
+    std::vector<Real> axs, ays, azs;
+    // Copies positions and masses of all bodies
+    void gather(const Octree& tree);
+    // Returns the bodies of the tile with the given index
+    MutualBodies tile(size_t index);
+    // Adds the interactions between the bodies of tiles first and second, or
+    // among the bodies of first if both are the same
+    void interact(size_t first, size_t second);
+    // Calls body(begin, end) over consecutive ranges of at most grain indices
+    // covering [0, count), on pool if given
+    template <typename F> static void forEach(ThreadPool* pool, size_t count, size_t grain, F&& body) {
+        if (pool)
+            pool->parallelFor(count, grain, body);
+        else
+            body(0, count);
+    }
+
+  public:
+    // Computes the acceleration of every body of tree into accelerations,
+    // indexed like the body buffer of tree. If a thread pool is given, work is
+    // split across it; results do not depend on the number of threads.
+    void evaluate(const Octree& tree, ThreadPool* pool, std::vector<Vec3>& accelerations);
+    // Computes the acceleration of the bodies at the given indices of the body
+    // buffer of tree only, summing over all bodies for each. Other entries of
+    // accelerations are left as they are. Cheaper than evaluating all bodies
+    // when fewer than about half of them are needed.
+    void evaluate(
+        const Octree& tree, ThreadPool* pool, const std::vector<uint32_t>& targets, std::vector<Vec3>& accelerations
+    );
+};
+
+#endif
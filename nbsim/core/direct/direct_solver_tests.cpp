@@ -0,0 +1,76 @@
+#include "nbsim/core/direct/direct_solver.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <type_traits>
+#include <vector>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include "nbsim/core/testing/random_bodies.hpp"
+
+using namespace std;
+
+class TestDirectSolver : public ::testing::Test {
+  protected:
+    TestDirectSolver() = default;
+    // Relative error allowed against the reference, which sums in a
+    // different order, depending on the precision of the kernel's terms
+    static constexpr double TOLERANCE = is_same_v<FieldReal, float> ? 1e-5 : 1e-12;
+
+    // Returns the exact accelerations of the bodies of tree, in body buffer
+    // order
+    static vector<Vec3> reference(const Octree& tree) {
+        vector<Body> bodies;
+        for (size_t i = 0; i < tree.count(); i++) {
+            bodies.push_back(tree.loadBody(i));
+        }
+        return directAccelerations(bodies);
+    }
+
+    static void expectClose(const vector<Vec3>& actual, const vector<Vec3>& expected) {
+        ASSERT_EQ(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); i++) {
+            EXPECT_LE((actual[i] - expected[i]).length(), TOLERANCE * expected[i].length());
+        }
+    }
+};
+
+TEST_F(TestDirectSolver, MatchesReferenceForAnyTiling) {
+    // partial tiles, and odd and even numbers of tiles
+    for (size_t count : {0, 1, 2, 63, 64, 65, 200, 300}) {
+        vector<Body> bodies = randomBodies(count, unsigned(count));
+        Octree tree(bodies);
+        DirectSolver solver;
+        vector<Vec3> accelerations;
+        solver.evaluate(tree, nullptr, accelerations);
+        expectClose(accelerations, reference(tree));
+    }
+}
+
+TEST_F(TestDirectSolver, ResultsDoNotDependOnThreadCount) {
+    vector<Body> bodies = randomBodies(1000, 7);
+    Octree tree(bodies);
+    DirectSolver solver;
+    vector<Vec3> serial, parallel;
+    solver.evaluate(tree, nullptr, serial);
+    ThreadPool pool(4);
+    solver.evaluate(tree, &pool, parallel);
+    for (size_t i = 0; i < serial.size(); i++) {
+        EXPECT_EQ(serial[i], parallel[i]);
+    }
+}
+
+TEST_F(TestDirectSolver, EvaluatesOnlyTargets) {
+    vector<Body> bodies = randomBodies(150, 9);
+    Octree tree(bodies);
+    DirectSolver solver;
+    vector<Vec3> accelerations(tree.count(), Vec3{1, 2, 3});
+    vector<uint32_t> targets{0, 17, 64, 149};
+    solver.evaluate(tree, nullptr, targets, accelerations);
+    vector<Vec3> expected = reference(tree);
+    for (size_t i = 0; i < tree.count(); i++) {
+        if (find(targets.begin(), targets.end(), uint32_t(i)) != targets.end())
+            EXPECT_LT((accelerations[i] - expected[i]).length(), 1e-12 * expected[i].length());
+        else
+            EXPECT_EQ(accelerations[i], (Vec3{1, 2, 3}));
+    }
+}
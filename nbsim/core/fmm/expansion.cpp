@@ -0,0 +1,68 @@
+#include "nbsim/core/fmm/expansion.hpp"
+
+using namespace std;
+
+vector<MultiIndex> multiIndices(int order) {
+    vector<MultiIndex> indices;
+    indices.reserve(termCount(order));
+    for (int n = 0; n <= order; n++) {
+        for (int rest = 0; rest <= n; rest++) {
+            for (int z = 0; z <= rest; z++) {
+                indices.push_back(MultiIndex{n - rest, rest - z, z});
+            }
+        }
+    }
+    return indices;
+}
+
+void monomials(const Vec3T<double>& r, int order, double* powers) {
+    powers[0] = 1;
+    size_t index = 1;
+    for (int n = 1; n <= order; n++) {
+        for (int rest = 0; rest <= n; rest++) {
+            for (int z = 0; z <= rest; z++) {
+                const int x = n - rest;
+                const int y = rest - z;
+                // every monomial is a lower one times a single component
+                if (x > 0)
+                    powers[index++] = powers[termIndex(x - 1, y, z)] * r.x;
+                else if (y > 0)
+                    powers[index++] = powers[termIndex(x, y - 1, z)] * r.y;
+                else
+                    powers[index++] = powers[termIndex(x, y, z - 1)] * r.z;
+            }
+        }
+    }
+}
+
+void inverseDistanceDerivatives(const Vec3T<double>& r, int order, double* coefficients) {
+    const double r2 = r.x * r.x + r.y * r.y + r.z * r.z;
+    coefficients[0] = 1 / sqrt(r2);
+    size_t index = 1;
+    // Coefficients a_k of 1/r satisfy
+    //   n r^2 a_k + (2n - 1) sum_i r_i a_(k - e_i) + (n - 1) sum_i a_(k - 2 e_i) = 0
+    // for n = |k|, where terms with negative exponents are dropped.
+    for (int n = 1; n <= order; n++) {
+        for (int rest = 0; rest <= n; rest++) {
+            for (int z = 0; z <= rest; z++) {
+                const int x = n - rest;
+                const int y = rest - z;
+                double first = 0;
+                double second = 0;
+                if (x > 0)
+                    first += r.x * coefficients[termIndex(x - 1, y, z)];
+                if (y > 0)
+                    first += r.y * coefficients[termIndex(x, y - 1, z)];
+                if (z > 0)
+                    first += r.z * coefficients[termIndex(x, y, z - 1)];
+                if (x > 1)
+                    second += coefficients[termIndex(x - 2, y, z)];
+                if (y > 1)
+                    second += coefficients[termIndex(x, y - 2, z)];
+                if (z > 1)
+                    second += coefficients[termIndex(x, y, z - 2)];
+                coefficients[index++] = -((2 * n - 1) * first + (n - 1) * second) / (n * r2);
+            }
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef EXPANSION_H
+#define EXPANSION_H
+
+#include <cstddef>
+#include <vector>
+
+#include "nbsim/core/vec3/vec3.hpp"
+
+// Building blocks of Cartesian Taylor expansions of the 1/r potential.
+//
+// A multi-index k = (kx, ky, kz) of order |k| = kx + ky + kz names the monomial
+// x^kx y^ky z^kz. Expansions store one coefficient per multi-index up to some
+// order in a single array, sorted by order, then by ky + kz, then by kz.
+//
+// Expansions are always computed in double precision, whatever the build's
+// scalar type, as high powers of astronomical distances overflow floats.
+
+/**
+ * Exponents of one term of an expansion
+ */
+struct MultiIndex {
+    int x; // exponent of the x component
+    int y; // exponent of the y component
+    int z; // exponent of the z component
+
+    // Returns the order of the term
+    int order() const { return x + y + z; }
+};
+
+// Returns the number of terms of order at most order
+constexpr size_t termCount(int order) { return size_t(order + 1) * size_t(order + 2) * size_t(order + 3) / 6; }
+
+// Returns the position of the term with the given exponents in an expansion
+constexpr size_t termIndex(int x, int y, int z) {
+    const size_t rest = size_t(y + z);
+    return termCount(x + y + z - 1) + rest * (rest + 1) / 2 + size_t(z);
+}
+
+// Returns the exponents of all terms of order at most order, in storage order
+std::vector<MultiIndex> multiIndices(int order);
+
+// Writes the monomial r^k of every multi-index k of order at most order to
+// powers, which must hold termCount(order) values
+void monomials(const Vec3T<double>& r, int order, double* powers);
+
+// Writes the Taylor coefficients D^k(1/|r|) / k! of every multi-index k of
+// order at most order to coefficients, which must hold termCount(order)
+// values. r must not be zero.
+void inverseDistanceDerivatives(const Vec3T<double>& r, int order, double* coefficients);
+
+#endif
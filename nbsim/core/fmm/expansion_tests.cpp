@@ -0,0 +1,62 @@
+#include "nbsim/core/fmm/expansion.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace std;
+
+class TestExpansion : public ::testing::Test {
+  protected:
+    TestExpansion() = default;
+};
+
+TEST_F(TestExpansion, TermIndexMatchesMultiIndexOrder) {
+    vector<MultiIndex> indices = multiIndices(6);
+    EXPECT_EQ(indices.size(), termCount(6));
+    for (size_t i = 0; i < indices.size(); i++) {
+        EXPECT_EQ(termIndex(indices[i].x, indices[i].y, indices[i].z), i);
+        if (i > 0) {
+            EXPECT_GE(indices[i].order(), indices[i - 1].order());
+        }
+    }
+}
+
+TEST_F(TestExpansion, MonomialsMatchPowers) {
+    Vec3T<double> r{2, -3, 0.5};
+    vector<double> powers(termCount(5));
+    monomials(r, 5, powers.data());
+    for (const MultiIndex& k : multiIndices(5)) {
+        double expected = pow(r.x, k.x) * pow(r.y, k.y) * pow(r.z, k.z);
+        EXPECT_DOUBLE_EQ(powers[termIndex(k.x, k.y, k.z)], expected);
+    }
+}
+
+TEST_F(TestExpansion, DerivativesMatchClosedForms) {
+    Vec3T<double> r{1.5, -2, 0.75};
+    double length = r.length();
+    vector<double> coefficients(termCount(2));
+    inverseDistanceDerivatives(r, 2, coefficients.data());
+    EXPECT_DOUBLE_EQ(coefficients[0], 1 / length);
+    EXPECT_DOUBLE_EQ(coefficients[termIndex(1, 0, 0)], -r.x / pow(length, 3));
+    EXPECT_DOUBLE_EQ(coefficients[termIndex(0, 0, 1)], -r.z / pow(length, 3));
+    double scale = 1 / pow(length, 3);
+    double xx = (3 * r.x * r.x - length * length) / (2 * pow(length, 5));
+    EXPECT_NEAR(coefficients[termIndex(2, 0, 0)], xx, 1e-14 * scale);
+    EXPECT_NEAR(coefficients[termIndex(0, 1, 1)], 3 * r.y * r.z / pow(length, 5), 1e-14 * scale);
+}
+
+TEST_F(TestExpansion, TaylorSeriesConvergesToInverseDistance) {
+    // 1 / |r + e| = sum_k a_k(r) e^k for small e
+    Vec3T<double> r{3, 1, -2};
+    Vec3T<double> e{0.2, -0.1, 0.15};
+    const int order = 8;
+    vector<double> coefficients(termCount(order));
+    vector<double> powers(termCount(order));
+    inverseDistanceDerivatives(r, order, coefficients.data());
+    monomials(e, order, powers.data());
+    double sum = 0;
+    for (size_t i = 0; i < termCount(order); i++) {
+        sum += coefficients[i] * powers[i];
+    }
+    EXPECT_NEAR(sum, 1 / (r + e).length(), 1e-10);
+}
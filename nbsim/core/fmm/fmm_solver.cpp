@@ -0,0 +1,300 @@
+#include "nbsim/core/fmm/fmm_solver.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+
+using namespace std;
+
+namespace {
+// Returns the binomial coefficient n choose k
+double binomial(int n, int k) {
+    double result = 1;
+    for (int i = 1; i <= k; i++) {
+        result = result * (n - k + i) / i;
+    }
+    return result;
+}
+} // namespace
+
+FmmSolver::FmmSolver(int order, double theta) : order{order}, theta{theta} { setOrder(order); }
+
+void FmmSolver::setOrder(int newOrder) {
+    if (newOrder < 0 || newOrder > MAX_ORDER)
+        throw runtime_error("Error: FMM expansion order must be between 0 and " + to_string(MAX_ORDER) + ".");
+    order = newOrder;
+    prepare();
+}
+
+int FmmSolver::getOrder() const { return order; }
+
+void FmmSolver::setTheta(double newTheta) { theta = newTheta; }
+
+void FmmSolver::prepare() {
+    const int localOrder = order + 1;
+    multipoleTerms = termCount(order);
+    localTerms = termCount(localOrder);
+    indices = multiIndices(localOrder);
+
+    // Shifting an expansion by s expands (r + s)^k with the binomial theorem,
+    // which couples term k to every term n <= k
+    shifts.clear();
+    multipoleShifts = 0;
+    for (size_t to = 0; to < localTerms; to++) {
+        const MultiIndex& k = indices[to];
+        for (int x = 0; x <= k.x; x++) {
+            for (int y = 0; y <= k.y; y++) {
+                for (int z = 0; z <= k.z; z++) {
+                    double coefficient = binomial(k.x, x) * binomial(k.y, y) * binomial(k.z, z);
+                    shifts.push_back(Shift{
+                        uint32_t(to), uint32_t(termIndex(x, y, z)), uint32_t(termIndex(k.x - x, k.y - y, k.z - z)),
+                        coefficient
+                    });
+                }
+            }
+        }
+        if (to + 1 == multipoleTerms)
+            multipoleShifts = shifts.size();
+    }
+
+    // With multipole moments Q_n about the source center and a the Taylor
+    // coefficients of 1/r at the offset between the centers, the local
+    // expansion is L_m = sum_n (-1)^|n| C(m + n, n) a_(m + n) Q_n
+    transfers.clear();
+    for (size_t to = 0; to < localTerms; to++) {
+        const MultiIndex& m = indices[to];
+        for (size_t from = 0; from < multipoleTerms; from++) {
+            const MultiIndex& n = indices[from];
+            if (m.order() + n.order() > localOrder)
+                break;
+            double coefficient = binomial(m.x + n.x, n.x) * binomial(m.y + n.y, n.y) * binomial(m.z + n.z, n.z);
+            if (n.order() % 2)
+                coefficient = -coefficient;
+            transfers.push_back(Transfer{
+                uint32_t(to), uint32_t(from), uint32_t(termIndex(m.x + n.x, m.y + n.y, m.z + n.z)), coefficient
+            });
+        }
+    }
+
+    lowered.assign(3 * localTerms, -1);
+    for (size_t term = 0; term < localTerms; term++) {
+        const MultiIndex& k = indices[term];
+        if (k.x > 0)
+            lowered[3 * term] = int32_t(termIndex(k.x - 1, k.y, k.z));
+        if (k.y > 0)
+            lowered[3 * term + 1] = int32_t(termIndex(k.x, k.y - 1, k.z));
+        if (k.z > 0)
+            lowered[3 * term + 2] = int32_t(termIndex(k.x, k.y, k.z - 1));
+    }
+}
+
+void FmmSolver::gather(const Octree& tree) {
+    const size_t count = tree.count();
+    xs.resize(count);
+    ys.resize(count);
+    zs.resize(count);
+    masses.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t body = tree.flat.bodyAt(i);
+        const Vec3 position = tree.getPosition(body);
+        xs[i] = position.x;
+        ys[i] = position.y;
+        zs[i] = position.z;
+        masses[i] = tree.getMass(body);
+    }
+}
+
+void FmmSolver::upwardPass(const FlatOctree& flat) {
+    const size_t nodeCount = flat.size();
+    centers.resize(nodeCount);
+    radii.resize(nodeCount);
+    multipoles.assign(nodeCount * multipoleTerms, 0);
+    leaves.clear();
+    vector<double> powers(multipoleTerms);
+    // children always come after their parent, so a reverse pass sees every
+    // child before its parent
+    for (uint32_t index = uint32_t(nodeCount); index-- > 0;) {
+        const FlatOctreeNode& node = flat[index];
+        const Vec3T<double> center = node.centerOfMass.to<double>();
+        double* multipole = &multipoles[index * multipoleTerms];
+        double radius = 0;
+        if (node.isLeaf()) {
+            leaves.push_back(index);
+            for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+                const Vec3T<double> offset = Vec3T<double>{xs[i], ys[i], zs[i]} - center;
+                monomials(offset, order, powers.data());
+                for (size_t term = 0; term < multipoleTerms; term++) {
+                    multipole[term] += masses[i] * powers[term];
+                }
+                radius = max(radius, offset.length());
+            }
+        } else {
+            const uint32_t childEnd = node.firstChild + popcount(node.childMask);
+            for (uint32_t child = node.firstChild; child < childEnd; child++) {
+                const Vec3T<double> offset = centers[child] - center;
+                const double* source = &multipoles[child * multipoleTerms];
+                monomials(offset, order, powers.data());
+                for (size_t i = 0; i < multipoleShifts; i++) {
+                    const Shift& shift = shifts[i];
+                    multipole[shift.to] += shift.coefficient * powers[shift.power] * source[shift.from];
+                }
+                radius = max(radius, offset.length() + radii[child]);
+            }
+        }
+        // no body lies further away than the far corner of the node's box
+        const double half = node.width / 2.0;
+        const Vec3T<double> corner{
+            abs(center.x - node.center.x) + half, abs(center.y - node.center.y) + half,
+            abs(center.z - node.center.z) + half
+        };
+        centers[index] = center;
+        radii[index] = min(radius, corner.length());
+    }
+    reverse(leaves.begin(), leaves.end());
+}
+
+void FmmSolver::interact(const FlatOctree& flat, uint32_t target, uint32_t source) {
+    const FlatOctreeNode& targetNode = flat[target];
+    const FlatOctreeNode& sourceNode = flat[source];
+    const double distance = (centers[target] - centers[source]).length();
+    if (radii[target] + radii[source] < theta * distance) {
+        farPairs.emplace_back(target, source);
+        return;
+    }
+    if (targetNode.isLeaf() && sourceNode.isLeaf()) {
+        nearPairs.emplace_back(target, source);
+        return;
+    }
+    // split the larger of the two nodes, unless it is a leaf
+    if (sourceNode.isLeaf() || (!targetNode.isLeaf() && radii[target] >= radii[source])) {
+        const uint32_t childEnd = targetNode.firstChild + popcount(targetNode.childMask);
+        for (uint32_t child = targetNode.firstChild; child < childEnd; child++) {
+            interact(flat, child, source);
+        }
+    } else {
+        const uint32_t childEnd = sourceNode.firstChild + popcount(sourceNode.childMask);
+        for (uint32_t child = sourceNode.firstChild; child < childEnd; child++) {
+            interact(flat, target, child);
+        }
+    }
+}
+
+void FmmSolver::groupPairs(
+    const vector<pair<uint32_t, uint32_t>>& pairs, size_t nodeCount, vector<uint32_t>& start,
+    vector<uint32_t>& sources
+) const {
+    // counting sort by target, which keeps the traversal order of sources
+    start.assign(nodeCount + 1, 0);
+    for (const auto& [target, source] : pairs) {
+        start[target + 1]++;
+    }
+    for (size_t i = 0; i < nodeCount; i++) {
+        start[i + 1] += start[i];
+    }
+    sources.resize(pairs.size());
+    vector<uint32_t> next(start.begin(), start.end() - 1);
+    for (const auto& [target, source] : pairs) {
+        sources[next[target]++] = source;
+    }
+}
+
+void FmmSolver::translate(uint32_t node, vector<double>& derivatives) {
+    double* local = &locals[node * localTerms];
+    for (uint32_t i = farStart[node]; i < farStart[node + 1]; i++) {
+        const uint32_t source = farSources[i];
+        const double* multipole = &multipoles[source * multipoleTerms];
+        inverseDistanceDerivatives(centers[node] - centers[source], order + 1, derivatives.data());
+        for (const Transfer& transfer : transfers) {
+            local[transfer.to] += transfer.coefficient * derivatives[transfer.derivative] * multipole[transfer.from];
+        }
+    }
+}
+
+void FmmSolver::downwardPass(const FlatOctree& flat) {
+    vector<double> powers(localTerms);
+    // parents always come before their children
+    for (uint32_t index = 0; index < flat.size(); index++) {
+        const FlatOctreeNode& node = flat[index];
+        if (node.isLeaf())
+            continue;
+        const double* local = &locals[index * localTerms];
+        const uint32_t childEnd = node.firstChild + popcount(node.childMask);
+        for (uint32_t child = node.firstChild; child < childEnd; child++) {
+            double* target = &locals[child * localTerms];
+            monomials(centers[child] - centers[index], order + 1, powers.data());
+            // shifting a local expansion runs the binomial expansion backwards
+            for (const Shift& shift : shifts) {
+                target[shift.from] += shift.coefficient * powers[shift.power] * local[shift.to];
+            }
+        }
+    }
+}
+
+void FmmSolver::evaluateLeaf(
+    const FlatOctree& flat, uint32_t leaf, vector<double>& powers, vector<Vec3>& accelerations
+) const {
+    const FlatOctreeNode& node = flat[leaf];
+    const double* local = &locals[leaf * localTerms];
+    for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+        const Vec3 position{xs[i], ys[i], zs[i]};
+        // the potential is sum_k L_k e^k, so its gradient is
+        // sum_k k_i L_k e^(k - e_i) along axis i
+        monomials(position.to<double>() - centers[leaf], order, powers.data());
+        Vec3T<double> gradient{0, 0, 0};
+        for (size_t term = 1; term < localTerms; term++) {
+            const MultiIndex& k = indices[term];
+            if (k.x > 0)
+                gradient.x += k.x * local[term] * powers[lowered[3 * term]];
+            if (k.y > 0)
+                gradient.y += k.y * local[term] * powers[lowered[3 * term + 1]];
+            if (k.z > 0)
+                gradient.z += k.z * local[term] * powers[lowered[3 * term + 2]];
+        }
+        Vec3 acceleration = (gradient * GRAVITATIONAL_CONSTANT).to<Real>();
+        for (uint32_t j = nearStart[leaf]; j < nearStart[leaf + 1]; j++) {
+            const FlatOctreeNode& source = flat[nearSources[j]];
+            const uint32_t first = source.firstBody;
+            acceleration +=
+                accelerationGravity(&xs[first], &ys[first], &zs[first], &masses[first], source.bodyCount, position);
+        }
+        accelerations[flat.bodyAt(i)] = acceleration;
+    }
+}
+
+void FmmSolver::evaluate(const Octree& tree, ThreadPool* pool, vector<Vec3>& accelerations) {
+    if (tree.getLayout() != OctreeLayout::FLAT)
+        throw runtime_error("Error: The FMM solver requires the flat tree layout.");
+    const FlatOctree& flat = tree.flat;
+    accelerations.assign(tree.count(), Vec3{0, 0, 0});
+    if (flat.empty())
+        return;
+    const size_t nodeCount = flat.size();
+    gather(tree);
+    upwardPass(flat);
+
+    farPairs.clear();
+    nearPairs.clear();
+    interact(flat, 0, 0);
+    groupPairs(farPairs, nodeCount, farStart, farSources);
+    groupPairs(nearPairs, nodeCount, nearStart, nearSources);
+
+    // Every node only writes its own expansion and every leaf only the
+    // accelerations of its own bodies, so results do not depend on how work
+    // is split between threads.
+    locals.assign(nodeCount * localTerms, 0);
+    forEach(pool, nodeCount, [&](size_t begin, size_t end) {
+        vector<double> derivatives(localTerms);
+        for (size_t node = begin; node < end; node++) {
+            translate(uint32_t(node), derivatives);
+        }
+    });
+    downwardPass(flat);
+    forEach(pool, leaves.size(), [&](size_t begin, size_t end) {
+        vector<double> powers(localTerms);
+        for (size_t i = begin; i < end; i++) {
+            evaluateLeaf(flat, leaves[i], powers, accelerations);
+        }
+    });
+}
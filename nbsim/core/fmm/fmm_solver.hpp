@@ -0,0 +1,140 @@
+#pragma once
+#ifndef FMM_SOLVER_H
+#define FMM_SOLVER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "nbsim/core/fmm/expansion.hpp"
+#include "nbsim/core/octree/octree.hpp"
+#include "nbsim/core/parallel/thread_pool.hpp"
+#include "nbsim/core/vec3/vec3.hpp"
+
+/**
+ * Computes gravitational accelerations with the fast multipole method, over
+ * the flat layout of an Octree.
+ *
+ * Every node carries a multipole expansion of its bodies and a local expansion
+ * of the field of distant bodies, both Cartesian Taylor expansions about the
+ * node's center of mass. A dual tree traversal pairs up nodes: well separated
+ * pairs are handled by a single multipole to local translation, and pairs of
+ * leaves that are too close are summed directly. Local expansions are then
+ * pushed down to the leaves and evaluated at every body. The number of
+ * interactions grows linearly with the number of bodies.
+ *
+ * Two nodes are well separated if the sum of their radii is less than theta
+ * times the distance between their centers. Error falls as theta^(p + 1) for
+ * expansion order p. This theta is not the opening angle of Barnes-Hut walks:
+ * it must stay below 1 for expansions to converge, and at the default order
+ * the same value is far more accurate and costly than in a walk.
+ */
+class FmmSolver {
+  private:
+    // Number of nodes handed to a thread at a time
+    static constexpr size_t GRAIN = 16;
+    // Term of a translation between expansions about different centers:
+    // target[to] += coefficient * offset^power * source[from]
+    struct Shift {
+        uint32_t to;        // term of the target expansion
+        uint32_t from;      // term of the source expansion
+        uint32_t power;     // monomial of the offset between the centers
+        double coefficient; // product of binomial coefficients
+    };
+    // Term of a multipole to local translation:
+    // local[to] += coefficient * derivative[derivative] * multipole[from]
+    struct Transfer {
+        uint32_t to;         // term of the local expansion
+        uint32_t from;       // term of the multipole expansion
+        uint32_t derivative; // term of the derivatives of 1/r
+        double coefficient;  // signed product of binomial coefficients
+    };
+    // Expansion order of multipoles. Local expansions keep one more order, so
+    // that their gradient has order p.
+    int order;
+    // Opening parameter of the dual tree traversal
+    double theta;
+    // Number of terms in a multipole and a local expansion
+    size_t multipoleTerms, localTerms;
+    // Translations along the tree. Sorted by the higher order term, so that
+    // the first multipoleShifts entries are exactly those of multipoles.
+    std::vector<Shift> shifts;
+    size_t multipoleShifts;
+    // Multipole to local translation
+    std::vector<Transfer> transfers;
+    // For every local term and axis, the term with that exponent lowered by
+    // one, or -1 if the exponent is zero. Used to take gradients.
+    std::vector<int32_t> lowered;
+    // Exponents of every local term
+    std::vector<MultiIndex> indices;
+    // Positions and masses of the bodies, in the tree's body order, so that
+    // the bodies of every node are contiguous
+    std::vector<Real> xs, ys, zs, masses;
+    // Expansions of every node, termCount values per node
+    std::vector<double> multipoles, locals;
+    // Expansion center and radius of every node. The radius bounds the
+    // distance from the center to any body of the node.
+    std::vector<Vec3T<double>> centers;
+    std::vector<double> radii;
+    // Leaves of the tree
+    std::vector<uint32_t> leaves;
+    // Node pairs found by the traversal, as (target, source). Far pairs are
+    // translated, near pairs summed directly.
+    std::vector<std::pair<uint32_t, uint32_t>> farPairs, nearPairs;
+    // Sources of each target node, grouped by target. The sources of node i
+    // are at [farStart[i], farStart[i + 1]) and likewise for near sources.
+    std::vector<uint32_t> farStart, farSources, nearStart, nearSources;
+    // Rebuilds the translation tables for the current order
+    void prepare();
+    // Copies positions and masses of all bodies into tree order
+    void gather(const Octree& tree);
+    // Computes expansion centers, radii and multipoles of all nodes
+    void upwardPass(const FlatOctree& flat);
+    // Pairs up the subtrees of target and source
+    void interact(const FlatOctree& flat, uint32_t target, uint32_t source);
+    // Groups pairs by target into start and sources
+    void groupPairs(
+        const std::vector<std::pair<uint32_t, uint32_t>>& pairs, size_t nodeCount, std::vector<uint32_t>& start,
+        std::vector<uint32_t>& sources
+    ) const;
+    // Translates the multipoles of all far sources of node into its local
+    // expansion
+    void translate(uint32_t node, std::vector<double>& derivatives);
+    // Shifts the local expansion of every node into its children
+    void downwardPass(const FlatOctree& flat);
+    // Evaluates the local expansion and near sources of leaf at its bodies
+    void evaluateLeaf(
+        const FlatOctree& flat, uint32_t leaf, std::vector<double>& powers, std::vector<Vec3>& accelerations
+    ) const;
+    // Calls body(begin, end) over [0, count), on pool if given
+    template <typename F> static void forEach(ThreadPool* pool, size_t count, F&& body) {
+        if (pool)
+            pool->parallelFor(count, GRAIN, body);
+        else
+            body(0, count);
+    }
+
+  public:
+    // Highest supported expansion order
+    static constexpr int MAX_ORDER = 10;
+    // Default opening parameter, which at order 4 keeps 99% of relative
+    // errors of random clusters near 2e-3
+    static constexpr double DEFAULT_THETA = 0.7;
+    // Creates a solver with the given expansion order and opening parameter.
+    // Throws std::runtime_error if the order is not in [0, MAX_ORDER].
+    FmmSolver(int order = 4, double theta = DEFAULT_THETA);
+    // Sets the expansion order. Higher orders are more accurate but make every
+    // translation more expensive. Throws std::runtime_error if the order is not
+    // in [0, MAX_ORDER].
+    void setOrder(int newOrder);
+    // Returns the expansion order
+    int getOrder() const;
+    // Sets the opening parameter
+    void setTheta(double newTheta);
+    // Computes the acceleration of every body of tree, which must use the flat
+    // layout and be up to date, into accelerations, indexed like the body
+    // buffer of tree. If a thread pool is given, work is split across it;
+    // results do not depend on the number of threads.
+    void evaluate(const Octree& tree, ThreadPool* pool, std::vector<Vec3>& accelerations);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "nbsim/core/fmm/fmm_solver.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include "nbsim/core/testing/random_bodies.hpp"
+
+using namespace std;
+
+class TestFmmSolver : public ::testing::Test {
+  protected:
+    TestFmmSolver() = default;
+
+    // Returns the error of every acceleration relative to the magnitude of
+    // the exact acceleration
+    static vector<double> errors(const Octree& tree, const vector<Vec3>& accelerations, const vector<Vec3>& expected) {
+        vector<double> result;
+        for (size_t i = 0; i < accelerations.size(); i++) {
+            const size_t id = tree.getId(i);
+            result.push_back((accelerations[i] - expected[id]).length() / expected[id].length());
+        }
+        return result;
+    }
+
+    static double mean(const vector<double>& values) {
+        double sum = 0;
+        for (double value : values) {
+            sum += value;
+        }
+        return sum / double(values.size());
+    }
+};
+
+TEST_F(TestFmmSolver, MatchesDirectSummation) {
+    vector<Body> bodies = randomBodies(2000, 3);
+    vector<Vec3> expected = directAccelerations(bodies);
+    Octree tree(bodies);
+    tree.setLayout(OctreeLayout::FLAT);
+    tree.setLeafSize(8);
+    FmmSolver solver(4, 0.5);
+    vector<Vec3> accelerations;
+    solver.evaluate(tree, nullptr, accelerations);
+    vector<double> error = errors(tree, accelerations, expected);
+    EXPECT_LT(mean(error), 1e-3);
+    EXPECT_LT(*max_element(error.begin(), error.end()), 5e-2);
+}
+
+TEST_F(TestFmmSolver, ErrorFallsWithOrder) {
+    vector<Body> bodies = randomBodies(1000, 5);
+    vector<Vec3> expected = directAccelerations(bodies);
+    Octree tree(bodies);
+    tree.setLayout(OctreeLayout::FLAT);
+    FmmSolver solver(0, 0.4);
+    vector<Vec3> accelerations;
+    solver.evaluate(tree, nullptr, accelerations);
+    double previous = mean(errors(tree, accelerations, expected));
+    for (int order : {2, 4, 6}) {
+        solver.setOrder(order);
+        solver.evaluate(tree, nullptr, accelerations);
+        double error = mean(errors(tree, accelerations, expected));
+        EXPECT_LT(error, previous);
+        previous = error;
+    }
+    EXPECT_LT(previous, 1e-4);
+}
+
+TEST_F(TestFmmSolver, ResultsDoNotDependOnThreadCount) {
+    vector<Body> bodies = randomBodies(5000, 7);
+    Octree tree(bodies);
+    tree.setLayout(OctreeLayout::FLAT);
+    FmmSolver solver;
+    vector<Vec3> serial, parallel;
+    solver.evaluate(tree, nullptr, serial);
+    ThreadPool pool(4);
+    solver.evaluate(tree, &pool, parallel);
+    for (size_t i = 0; i < serial.size(); i++) {
+        EXPECT_EQ(serial[i], parallel[i]);
+    }
+}
+
+TEST_F(TestFmmSolver, RejectsInvalidSetup) {
+    EXPECT_THROW(FmmSolver(-1), std::runtime_error);
+    EXPECT_THROW(FmmSolver(FmmSolver::MAX_ORDER + 1), std::runtime_error);
+    vector<Body> bodies = randomBodies(10, 1);
+    Octree tree(bodies);
+    FmmSolver solver;
+    vector<Vec3> accelerations;
+    EXPECT_THROW(solver.evaluate(tree, nullptr, accelerations), std::runtime_error);
+}
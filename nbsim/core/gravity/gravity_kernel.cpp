@@ -0,0 +1,666 @@
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define NBSIM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Signature shared by all kernel implementations
+using KernelFunction =
+    Vec3 (*)(const FieldReal*, const FieldReal*, const FieldReal*, const FieldReal*, size_t, const Vec3&);
+using MutualKernelFunction = Vec3 (*)(const MutualBodies&, const Vec3&, Real);
+#ifdef NBSIM_MIXED
+// Signature of the kernels over sources in the precision of bodies
+using BodyKernelFunction = Vec3 (*)(const Real*, const Real*, const Real*, const Real*, size_t, const Vec3&);
+#endif
+
+// Portable kernel, used on any CPU and for the remainders of vector kernels.
+// Offsets are computed in the precision of the sources and summed in that of
+// the result. Squares of astronomical distances overflow single precision, so
+// the distance and the terms are computed in double precision.
+template <typename T>
+static Vec3 gravityScalar(const T* x, const T* y, const T* z, const T* mass, size_t count, const Vec3& target) {
+    const Vec3T<T> at = target.to<T>();
+    Real ax = 0, ay = 0, az = 0;
+    for (size_t i = 0; i < count; i++) {
+        double dx = at.x - x[i];
+        double dy = at.y - y[i];
+        double dz = at.z - z[i];
+        double r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 == 0)
+            continue;
+        double inv = 1 / sqrt(r2);
+        double scale = mass[i] * inv * inv * inv;
+        ax += Real(dx * scale);
+        ay += Real(dy * scale);
+        az += Real(dz * scale);
+    }
+    return Vec3{ax, ay, az} * -GRAVITATIONAL_CONSTANT;
+}
+
+// Portable mutual kernel, used on any CPU and for the remainders of vector
+// kernels. Computes in double precision like gravityScalar.
+static Vec3 mutualScalar(const MutualBodies& bodies, const Vec3& target, Real targetMass) {
+    const double pull = GRAVITATIONAL_CONSTANT * targetMass;
+    Real ax = 0, ay = 0, az = 0;
+    for (size_t i = 0; i < bodies.count; i++) {
+        double dx = target.x - bodies.x[i];
+        double dy = target.y - bodies.y[i];
+        double dz = target.z - bodies.z[i];
+        double r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 == 0)
+            continue;
+        double inv = 1 / sqrt(r2);
+        double scale = bodies.mass[i] * inv * inv * inv;
+        double reaction = pull * inv * inv * inv;
+        ax += Real(dx * scale);
+        ay += Real(dy * scale);
+        az += Real(dz * scale);
+        bodies.ax[i] += Real(dx * reaction);
+        bodies.ay[i] += Real(dy * reaction);
+        bodies.az[i] += Real(dz * reaction);
+    }
+    return Vec3{ax, ay, az} * -GRAVITATIONAL_CONSTANT;
+}
+
+#ifdef NBSIM_X86_KERNELS
+
+#ifdef NBSIM_FLOAT_FIELD
+
+// Eight single precision lanes, summed in the precision of Real
+struct Avx2Sum {
+#ifdef NBSIM_FLOAT
+    __m256 lanes;
+#else
+    __m256d low;  // lanes 0 to 3
+    __m256d high; // lanes 4 to 7
+#endif
+};
+
+// Returns a sum of zero
+__attribute__((target("avx2,fma"))) static Avx2Sum avx2Zero() {
+#ifdef NBSIM_FLOAT
+    return Avx2Sum{_mm256_setzero_ps()};
+#else
+    return Avx2Sum{_mm256_setzero_pd(), _mm256_setzero_pd()};
+#endif
+}
+
+// Adds terms to sum lane by lane
+__attribute__((target("avx2,fma"))) static void avx2Add(Avx2Sum& sum, __m256 terms) {
+#ifdef NBSIM_FLOAT
+    sum.lanes = _mm256_add_ps(sum.lanes, terms);
+#else
+    sum.low = _mm256_add_pd(sum.low, _mm256_cvtps_pd(_mm256_castps256_ps128(terms)));
+    sum.high = _mm256_add_pd(sum.high, _mm256_cvtps_pd(_mm256_extractf128_ps(terms, 1)));
+#endif
+}
+
+// Returns the total of all lanes of sum
+__attribute__((target("avx2,fma"))) static Real avx2Total(const Avx2Sum& sum) {
+#ifdef NBSIM_FLOAT
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, sum.lanes);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+#else
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(sum.low, sum.high));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+}
+
+// Returns the reciprocal length of the offsets dx, dy and dz, or zero where
+// the largest of them is zero, subnormal or at least 2^127. The square of an
+// astronomical distance overflows single precision, so the offsets are first
+// scaled by the power of two that brings the largest of them into [1, 2). The
+// estimate is refined to single precision with a Newton-Raphson step.
+__attribute__((target("avx2,fma"))) static __m256 avx2InverseDistance(__m256 dx, __m256 dy, __m256 dz) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 largest = _mm256_max_ps(
+        _mm256_andnot_ps(sign, dx), _mm256_max_ps(_mm256_andnot_ps(sign, dy), _mm256_andnot_ps(sign, dz))
+    );
+    // scaling by the power of two and back is exact while both it and its
+    // reciprocal are normal numbers
+    const __m256 valid = _mm256_and_ps(
+        _mm256_cmp_ps(largest, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ),
+        _mm256_cmp_ps(largest, _mm256_set1_ps(0x1p127f), _CMP_LT_OQ)
+    );
+    // keeping only the exponent bits gives the power of two, and subtracting
+    // them from those of 2^127 gives its reciprocal
+    const __m256i exponent = _mm256_and_si256(_mm256_castps_si256(largest), _mm256_set1_epi32(0x7f800000));
+    const __m256 down = _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x7f000000), exponent));
+    dx = _mm256_mul_ps(dx, down);
+    dy = _mm256_mul_ps(dy, down);
+    dz = _mm256_mul_ps(dz, down);
+    // other lanes are refined from a dummy of one and dropped at the end, so
+    // that no infinity turns into NaN on the way
+    __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+    r2 = _mm256_blendv_ps(one, r2, valid);
+    __m256 inv = _mm256_rsqrt_ps(r2);
+    inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), threeHalves));
+    return _mm256_and_ps(_mm256_mul_ps(inv, down), valid);
+}
+
+// Eight sources per iteration in single precision
+__attribute__((target("avx2,fma"))) static Vec3 gravityAvx2(
+    const float* x, const float* y, const float* z, const float* mass, size_t count, const Vec3& target
+) {
+    const __m256 tx = _mm256_set1_ps(float(target.x));
+    const __m256 ty = _mm256_set1_ps(float(target.y));
+    const __m256 tz = _mm256_set1_ps(float(target.z));
+    Avx2Sum ax = avx2Zero(), ay = avx2Zero(), az = avx2Zero();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 dx = _mm256_sub_ps(tx, _mm256_loadu_ps(x + i));
+        __m256 dy = _mm256_sub_ps(ty, _mm256_loadu_ps(y + i));
+        __m256 dz = _mm256_sub_ps(tz, _mm256_loadu_ps(z + i));
+        // zero for sources on top of the target, which drops them
+        __m256 inv = avx2InverseDistance(dx, dy, dz);
+        // m / r^3 underflows single precision at astronomical distances, so
+        // m / r^2 is applied to the unit vector instead
+        __m256 scale = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(mass + i), inv), inv);
+        avx2Add(ax, _mm256_mul_ps(_mm256_mul_ps(dx, inv), scale));
+        avx2Add(ay, _mm256_mul_ps(_mm256_mul_ps(dy, inv), scale));
+        avx2Add(az, _mm256_mul_ps(_mm256_mul_ps(dz, inv), scale));
+    }
+    Vec3 tail = gravityScalar(x + i, y + i, z + i, mass + i, count - i, target);
+    Vec3 result{avx2Total(ax), avx2Total(ay), avx2Total(az)};
+    return result * -GRAVITATIONAL_CONSTANT + tail;
+}
+
+#ifdef NBSIM_FLOAT
+
+// Adds the eight terms to out[0] to out[7]
+__attribute__((target("avx2,fma"))) static void avx2AddTo(Real* out, __m256 terms) {
+    _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out), terms));
+}
+
+// Eight bodies per iteration in single precision
+__attribute__((target("avx2,fma"))) static Vec3 mutualAvx2(
+    const MutualBodies& bodies, const Vec3& target, Real targetMass
+) {
+    const __m256 tx = _mm256_set1_ps(float(target.x));
+    const __m256 ty = _mm256_set1_ps(float(target.y));
+    const __m256 tz = _mm256_set1_ps(float(target.z));
+    const __m256 pull = _mm256_set1_ps(float(GRAVITATIONAL_CONSTANT * targetMass));
+    Avx2Sum ax = avx2Zero(), ay = avx2Zero(), az = avx2Zero();
+    size_t i = 0;
+    for (; i + 8 <= bodies.count; i += 8) {
+        __m256 dx = _mm256_sub_ps(tx, _mm256_loadu_ps(bodies.x + i));
+        __m256 dy = _mm256_sub_ps(ty, _mm256_loadu_ps(bodies.y + i));
+        __m256 dz = _mm256_sub_ps(tz, _mm256_loadu_ps(bodies.z + i));
+        __m256 inv = avx2InverseDistance(dx, dy, dz);
+        // unit vector times m / r^2, like in gravityAvx2
+        __m256 ux = _mm256_mul_ps(dx, inv);
+        __m256 uy = _mm256_mul_ps(dy, inv);
+        __m256 uz = _mm256_mul_ps(dz, inv);
+        __m256 scale = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(bodies.mass + i), inv), inv);
+        __m256 reaction = _mm256_mul_ps(_mm256_mul_ps(pull, inv), inv);
+        avx2Add(ax, _mm256_mul_ps(ux, scale));
+        avx2Add(ay, _mm256_mul_ps(uy, scale));
+        avx2Add(az, _mm256_mul_ps(uz, scale));
+        avx2AddTo(bodies.ax + i, _mm256_mul_ps(ux, reaction));
+        avx2AddTo(bodies.ay + i, _mm256_mul_ps(uy, reaction));
+        avx2AddTo(bodies.az + i, _mm256_mul_ps(uz, reaction));
+    }
+    Vec3 tail = mutualScalar(bodies.from(i), target, targetMass);
+    Vec3 result{avx2Total(ax), avx2Total(ay), avx2Total(az)};
+    return result * -GRAVITATIONAL_CONSTANT + tail;
+}
+
+#endif
+
+// Sixteen single precision lanes, summed in the precision of Real
+struct Avx512Sum {
+#ifdef NBSIM_FLOAT
+    __m512 lanes;
+#else
+    __m512d low;  // lanes 0 to 7
+    __m512d high; // lanes 8 to 15
+#endif
+};
+
+// Returns a sum of zero
+__attribute__((target("avx512f"))) static Avx512Sum avx512Zero() {
+#ifdef NBSIM_FLOAT
+    return Avx512Sum{_mm512_setzero_ps()};
+#else
+    return Avx512Sum{_mm512_setzero_pd(), _mm512_setzero_pd()};
+#endif
+}
+
+#ifndef NBSIM_FLOAT
+// Returns lanes 8 to 15 of v
+__attribute__((target("avx512f"))) static __m256 avx512Upper(__m512 v) {
+    return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+}
+#endif
+
+// Adds terms to sum lane by lane
+__attribute__((target("avx512f"))) static void avx512Add(Avx512Sum& sum, __m512 terms) {
+#ifdef NBSIM_FLOAT
+    sum.lanes = _mm512_add_ps(sum.lanes, terms);
+#else
+    sum.low = _mm512_add_pd(sum.low, _mm512_cvtps_pd(_mm512_castps512_ps256(terms)));
+    sum.high = _mm512_add_pd(sum.high, _mm512_cvtps_pd(avx512Upper(terms)));
+#endif
+}
+
+// Returns the total of all lanes of sum
+__attribute__((target("avx512f"))) static Real avx512Total(const Avx512Sum& sum) {
+#ifdef NBSIM_FLOAT
+    return _mm512_reduce_add_ps(sum.lanes);
+#else
+    return _mm512_reduce_add_pd(_mm512_add_pd(sum.low, sum.high));
+#endif
+}
+
+// Returns the reciprocal length of the offsets dx, dy and dz in the given
+// lanes, or zero where the lane is unused or the largest offset is zero,
+// subnormal or not finite. The offsets are scaled like in avx2InverseDistance,
+// and the 14 bit estimate is refined to single precision with a
+// Newton-Raphson step.
+__attribute__((target("avx512f"))) static __m512
+avx512InverseDistance(__mmask16 lanes, __m512 dx, __m512 dy, __m512 dz) {
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    const __m512 largest = _mm512_max_ps(_mm512_abs_ps(dx), _mm512_max_ps(_mm512_abs_ps(dy), _mm512_abs_ps(dz)));
+    const __mmask16 valid = _mm512_mask_cmp_ps_mask(
+        _mm512_mask_cmp_ps_mask(lanes, largest, _mm512_set1_ps(FLT_MIN), _CMP_GE_OQ), largest,
+        _mm512_set1_ps(INFINITY), _CMP_LT_OQ
+    );
+    // the negated exponent of the largest offset, which scales it into [1, 2)
+    const __m512 down = _mm512_sub_ps(_mm512_setzero_ps(), _mm512_getexp_ps(largest));
+    dx = _mm512_scalef_ps(dx, down);
+    dy = _mm512_scalef_ps(dy, down);
+    dz = _mm512_scalef_ps(dz, down);
+    // other lanes are refined from a dummy of one and dropped at the end, so
+    // that no infinity turns into NaN on the way
+    __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+    r2 = _mm512_mask_mov_ps(one, valid, r2);
+    __m512 inv = _mm512_rsqrt14_ps(r2);
+    inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv, inv), threeHalves));
+    return _mm512_maskz_scalef_ps(valid, inv, down);
+}
+
+// Returns the lanes of the vector of sixteen floats starting at index i that
+// lie below count
+static __mmask16 avx512Lanes(size_t i, size_t count) {
+    return (count - i >= 16) ? __mmask16(0xffff) : __mmask16((1u << (count - i)) - 1);
+}
+
+// Sixteen sources per iteration in single precision, with the remainder
+// handled with masked loads
+__attribute__((target("avx512f"))) static Vec3 gravityAvx512(
+    const float* x, const float* y, const float* z, const float* mass, size_t count, const Vec3& target
+) {
+    const __m512 tx = _mm512_set1_ps(float(target.x));
+    const __m512 ty = _mm512_set1_ps(float(target.y));
+    const __m512 tz = _mm512_set1_ps(float(target.z));
+    Avx512Sum ax = avx512Zero(), ay = avx512Zero(), az = avx512Zero();
+    for (size_t i = 0; i < count; i += 16) {
+        __mmask16 lanes = avx512Lanes(i, count);
+        __m512 dx = _mm512_sub_ps(tx, _mm512_maskz_loadu_ps(lanes, x + i));
+        __m512 dy = _mm512_sub_ps(ty, _mm512_maskz_loadu_ps(lanes, y + i));
+        __m512 dz = _mm512_sub_ps(tz, _mm512_maskz_loadu_ps(lanes, z + i));
+        __m512 inv = avx512InverseDistance(lanes, dx, dy, dz);
+        __m512 mass16 = _mm512_maskz_loadu_ps(lanes, mass + i);
+        // unit vector times m / r^2, like in gravityAvx2
+        __m512 scale = _mm512_mul_ps(_mm512_mul_ps(mass16, inv), inv);
+        avx512Add(ax, _mm512_mul_ps(_mm512_mul_ps(dx, inv), scale));
+        avx512Add(ay, _mm512_mul_ps(_mm512_mul_ps(dy, inv), scale));
+        avx512Add(az, _mm512_mul_ps(_mm512_mul_ps(dz, inv), scale));
+    }
+    Vec3 result{avx512Total(ax), avx512Total(ay), avx512Total(az)};
+    return result * -GRAVITATIONAL_CONSTANT;
+}
+
+#ifdef NBSIM_FLOAT
+
+// Adds the terms of the given lanes to the same entries of out
+__attribute__((target("avx512f"))) static void avx512AddTo(Real* out, __mmask16 lanes, __m512 terms) {
+    _mm512_mask_storeu_ps(out, lanes, _mm512_add_ps(_mm512_maskz_loadu_ps(lanes, out), terms));
+}
+
+// Sixteen bodies per iteration in single precision
+__attribute__((target("avx512f"))) static Vec3 mutualAvx512(
+    const MutualBodies& bodies, const Vec3& target, Real targetMass
+) {
+    const __m512 tx = _mm512_set1_ps(float(target.x));
+    const __m512 ty = _mm512_set1_ps(float(target.y));
+    const __m512 tz = _mm512_set1_ps(float(target.z));
+    const __m512 pull = _mm512_set1_ps(float(GRAVITATIONAL_CONSTANT * targetMass));
+    Avx512Sum ax = avx512Zero(), ay = avx512Zero(), az = avx512Zero();
+    const size_t count = bodies.count;
+    for (size_t i = 0; i < count; i += 16) {
+        __mmask16 lanes = avx512Lanes(i, count);
+        __m512 dx = _mm512_sub_ps(tx, _mm512_maskz_loadu_ps(lanes, bodies.x + i));
+        __m512 dy = _mm512_sub_ps(ty, _mm512_maskz_loadu_ps(lanes, bodies.y + i));
+        __m512 dz = _mm512_sub_ps(tz, _mm512_maskz_loadu_ps(lanes, bodies.z + i));
+        __m512 inv = avx512InverseDistance(lanes, dx, dy, dz);
+        __m512 mass16 = _mm512_maskz_loadu_ps(lanes, bodies.mass + i);
+        __m512 ux = _mm512_mul_ps(dx, inv);
+        __m512 uy = _mm512_mul_ps(dy, inv);
+        __m512 uz = _mm512_mul_ps(dz, inv);
+        __m512 scale = _mm512_mul_ps(_mm512_mul_ps(mass16, inv), inv);
+        __m512 reaction = _mm512_mul_ps(_mm512_mul_ps(pull, inv), inv);
+        avx512Add(ax, _mm512_mul_ps(ux, scale));
+        avx512Add(ay, _mm512_mul_ps(uy, scale));
+        avx512Add(az, _mm512_mul_ps(uz, scale));
+        avx512AddTo(bodies.ax + i, lanes, _mm512_mul_ps(ux, reaction));
+        avx512AddTo(bodies.ay + i, lanes, _mm512_mul_ps(uy, reaction));
+        avx512AddTo(bodies.az + i, lanes, _mm512_mul_ps(uz, reaction));
+    }
+    Vec3 result{avx512Total(ax), avx512Total(ay), avx512Total(az)};
+    return result * -GRAVITATIONAL_CONSTANT;
+}
+
+#endif
+
+#endif
+
+#ifndef NBSIM_FLOAT
+
+// Double precision kernels, which also evaluate bodies as sources under
+// NBSIM_MIXED.
+
+// Four sources per iteration. AVX2 has no double precision reciprocal square
+// root estimate, so the reciprocal is taken from a full precision square root.
+__attribute__((target("avx2,fma"))) static Vec3 gravityAvx2(
+    const double* x, const double* y, const double* z, const double* mass, size_t count, const Vec3& target
+) {
+    const __m256d tx = _mm256_set1_pd(target.x);
+    const __m256d ty = _mm256_set1_pd(target.y);
+    const __m256d tz = _mm256_set1_pd(target.z);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d ax = zero, ay = zero, az = zero;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d dx = _mm256_sub_pd(tx, _mm256_loadu_pd(x + i));
+        __m256d dy = _mm256_sub_pd(ty, _mm256_loadu_pd(y + i));
+        __m256d dz = _mm256_sub_pd(tz, _mm256_loadu_pd(z + i));
+        __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz)));
+        __m256d inv = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+        __m256d scale = _mm256_mul_pd(_mm256_loadu_pd(mass + i), _mm256_mul_pd(inv, _mm256_mul_pd(inv, inv)));
+        // drop sources on top of the target
+        scale = _mm256_and_pd(scale, _mm256_cmp_pd(r2, zero, _CMP_NEQ_OQ));
+        ax = _mm256_fmadd_pd(dx, scale, ax);
+        ay = _mm256_fmadd_pd(dy, scale, ay);
+        az = _mm256_fmadd_pd(dz, scale, az);
+    }
+    alignas(32) double sums[3][4];
+    _mm256_store_pd(sums[0], ax);
+    _mm256_store_pd(sums[1], ay);
+    _mm256_store_pd(sums[2], az);
+    Vec3 tail = gravityScalar(x + i, y + i, z + i, mass + i, count - i, target);
+    Vec3 result{
+        (sums[0][0] + sums[0][1]) + (sums[0][2] + sums[0][3]),
+        (sums[1][0] + sums[1][1]) + (sums[1][2] + sums[1][3]),
+        (sums[2][0] + sums[2][1]) + (sums[2][2] + sums[2][3])
+    };
+    return result * -GRAVITATIONAL_CONSTANT + tail;
+}
+
+// Four bodies per iteration, with the same square root as gravityAvx2
+__attribute__((target("avx2,fma"))) static Vec3 mutualAvx2(
+    const MutualBodies& bodies, const Vec3& target, double targetMass
+) {
+    const __m256d tx = _mm256_set1_pd(target.x);
+    const __m256d ty = _mm256_set1_pd(target.y);
+    const __m256d tz = _mm256_set1_pd(target.z);
+    const __m256d pull = _mm256_set1_pd(GRAVITATIONAL_CONSTANT * targetMass);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d ax = zero, ay = zero, az = zero;
+    size_t i = 0;
+    for (; i + 4 <= bodies.count; i += 4) {
+        __m256d dx = _mm256_sub_pd(tx, _mm256_loadu_pd(bodies.x + i));
+        __m256d dy = _mm256_sub_pd(ty, _mm256_loadu_pd(bodies.y + i));
+        __m256d dz = _mm256_sub_pd(tz, _mm256_loadu_pd(bodies.z + i));
+        __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz)));
+        __m256d inv = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+        __m256d inv3 = _mm256_mul_pd(inv, _mm256_mul_pd(inv, inv));
+        // drop bodies on top of the target
+        inv3 = _mm256_and_pd(inv3, _mm256_cmp_pd(r2, zero, _CMP_NEQ_OQ));
+        __m256d scale = _mm256_mul_pd(_mm256_loadu_pd(bodies.mass + i), inv3);
+        ax = _mm256_fmadd_pd(dx, scale, ax);
+        ay = _mm256_fmadd_pd(dy, scale, ay);
+        az = _mm256_fmadd_pd(dz, scale, az);
+        __m256d reaction = _mm256_mul_pd(pull, inv3);
+        _mm256_storeu_pd(bodies.ax + i, _mm256_fmadd_pd(dx, reaction, _mm256_loadu_pd(bodies.ax + i)));
+        _mm256_storeu_pd(bodies.ay + i, _mm256_fmadd_pd(dy, reaction, _mm256_loadu_pd(bodies.ay + i)));
+        _mm256_storeu_pd(bodies.az + i, _mm256_fmadd_pd(dz, reaction, _mm256_loadu_pd(bodies.az + i)));
+    }
+    alignas(32) double sums[3][4];
+    _mm256_store_pd(sums[0], ax);
+    _mm256_store_pd(sums[1], ay);
+    _mm256_store_pd(sums[2], az);
+    Vec3 tail = mutualScalar(bodies.from(i), target, targetMass);
+    Vec3 result{
+        (sums[0][0] + sums[0][1]) + (sums[0][2] + sums[0][3]),
+        (sums[1][0] + sums[1][1]) + (sums[1][2] + sums[1][3]),
+        (sums[2][0] + sums[2][1]) + (sums[2][2] + sums[2][3])
+    };
+    return result * -GRAVITATIONAL_CONSTANT + tail;
+}
+
+// Eight sources per iteration. The reciprocal square root estimate is refined
+// to full double precision with two Newton-Raphson steps, and the remainder is
+// handled with masked loads.
+__attribute__((target("avx512f"))) static Vec3 gravityAvx512(
+    const double* x, const double* y, const double* z, const double* mass, size_t count, const Vec3& target
+) {
+    const __m512d tx = _mm512_set1_pd(target.x);
+    const __m512d ty = _mm512_set1_pd(target.y);
+    const __m512d tz = _mm512_set1_pd(target.z);
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __m512d threeHalves = _mm512_set1_pd(1.5);
+    const __m512d zero = _mm512_setzero_pd();
+    __m512d ax = zero, ay = zero, az = zero;
+    for (size_t i = 0; i < count; i += 8) {
+        __mmask8 lanes = (count - i >= 8) ? __mmask8(0xff) : __mmask8((1u << (count - i)) - 1);
+        __m512d dx = _mm512_sub_pd(tx, _mm512_maskz_loadu_pd(lanes, x + i));
+        __m512d dy = _mm512_sub_pd(ty, _mm512_maskz_loadu_pd(lanes, y + i));
+        __m512d dz = _mm512_sub_pd(tz, _mm512_maskz_loadu_pd(lanes, z + i));
+        __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dz, dz)));
+        __m512d inv = _mm512_rsqrt14_pd(r2);
+        __m512d halfR2 = _mm512_mul_pd(half, r2);
+        inv = _mm512_mul_pd(inv, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(inv, inv), threeHalves));
+        inv = _mm512_mul_pd(inv, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(inv, inv), threeHalves));
+        // drop unused lanes and sources on top of the target
+        __mmask8 valid = _mm512_mask_cmp_pd_mask(lanes, r2, zero, _CMP_NEQ_OQ);
+        __m512d scale = _mm512_maskz_mul_pd(
+            valid, _mm512_maskz_loadu_pd(lanes, mass + i), _mm512_mul_pd(inv, _mm512_mul_pd(inv, inv))
+        );
+        ax = _mm512_fmadd_pd(dx, scale, ax);
+        ay = _mm512_fmadd_pd(dy, scale, ay);
+        az = _mm512_fmadd_pd(dz, scale, az);
+    }
+    Vec3 result{_mm512_reduce_add_pd(ax), _mm512_reduce_add_pd(ay), _mm512_reduce_add_pd(az)};
+    return result * -GRAVITATIONAL_CONSTANT;
+}
+
+// Eight bodies per iteration, with the same refined estimate as gravityAvx512
+__attribute__((target("avx512f"))) static Vec3 mutualAvx512(
+    const MutualBodies& bodies, const Vec3& target, double targetMass
+) {
+    const __m512d tx = _mm512_set1_pd(target.x);
+    const __m512d ty = _mm512_set1_pd(target.y);
+    const __m512d tz = _mm512_set1_pd(target.z);
+    const __m512d pull = _mm512_set1_pd(GRAVITATIONAL_CONSTANT * targetMass);
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __m512d threeHalves = _mm512_set1_pd(1.5);
+    const __m512d zero = _mm512_setzero_pd();
+    __m512d ax = zero, ay = zero, az = zero;
+    const size_t count = bodies.count;
+    for (size_t i = 0; i < count; i += 8) {
+        __mmask8 lanes = (count - i >= 8) ? __mmask8(0xff) : __mmask8((1u << (count - i)) - 1);
+        __m512d dx = _mm512_sub_pd(tx, _mm512_maskz_loadu_pd(lanes, bodies.x + i));
+        __m512d dy = _mm512_sub_pd(ty, _mm512_maskz_loadu_pd(lanes, bodies.y + i));
+        __m512d dz = _mm512_sub_pd(tz, _mm512_maskz_loadu_pd(lanes, bodies.z + i));
+        __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dz, dz)));
+        __m512d inv = _mm512_rsqrt14_pd(r2);
+        __m512d halfR2 = _mm512_mul_pd(half, r2);
+        inv = _mm512_mul_pd(inv, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(inv, inv), threeHalves));
+        inv = _mm512_mul_pd(inv, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(inv, inv), threeHalves));
+        // drop unused lanes and bodies on top of the target
+        __mmask8 valid = _mm512_mask_cmp_pd_mask(lanes, r2, zero, _CMP_NEQ_OQ);
+        __m512d inv3 = _mm512_maskz_mul_pd(valid, inv, _mm512_mul_pd(inv, inv));
+        __m512d scale = _mm512_mul_pd(_mm512_maskz_loadu_pd(lanes, bodies.mass + i), inv3);
+        ax = _mm512_fmadd_pd(dx, scale, ax);
+        ay = _mm512_fmadd_pd(dy, scale, ay);
+        az = _mm512_fmadd_pd(dz, scale, az);
+        __m512d reaction = _mm512_mul_pd(pull, inv3);
+        _mm512_mask_storeu_pd(
+            bodies.ax + i, lanes, _mm512_fmadd_pd(dx, reaction, _mm512_maskz_loadu_pd(lanes, bodies.ax + i))
+        );
+        _mm512_mask_storeu_pd(
+            bodies.ay + i, lanes, _mm512_fmadd_pd(dy, reaction, _mm512_maskz_loadu_pd(lanes, bodies.ay + i))
+        );
+        _mm512_mask_storeu_pd(
+            bodies.az + i, lanes, _mm512_fmadd_pd(dz, reaction, _mm512_maskz_loadu_pd(lanes, bodies.az + i))
+        );
+    }
+    Vec3 result{_mm512_reduce_add_pd(ax), _mm512_reduce_add_pd(ay), _mm512_reduce_add_pd(az)};
+    return result * -GRAVITATIONAL_CONSTANT;
+}
+
+#endif
+
+#endif
+
+Vec3 accelerationQuadrupole(const Quadrupole& moment, const Vec3& center, const Vec3& target) {
+    // a = G (Q r / r^5 - 5/2 (r . Q r) r / r^7), in double precision like the
+    // moment itself
+    const Vec3T<double> r = (target - center).to<double>();
+    const double r2 = r.x * r.x + r.y * r.y + r.z * r.z;
+    const double inv5 = 1 / (r2 * r2 * sqrt(r2));
+    const Vec3T<double> qr = moment.apply(r);
+    const double rqr = r.x * qr.x + r.y * qr.y + r.z * qr.z;
+    return ((qr * inv5 - r * (2.5 * rqr * inv5 / r2)) * GRAVITATIONAL_CONSTANT).to<Real>();
+}
+
+Vec3 accelerationGravity(const InteractionList& list, const Vec3& target) {
+    Vec3 total =
+        accelerationGravity(list.x.data(), list.y.data(), list.z.data(), list.mass.data(), list.mass.size(), target);
+#ifdef NBSIM_MIXED
+    total += accelerationGravity(
+        list.bodyX.data(), list.bodyY.data(), list.bodyZ.data(), list.bodyMass.data(), list.bodyMass.size(), target
+    );
+#endif
+    for (size_t i = 0; i < list.quadrupoles.size(); i++) {
+        total += accelerationQuadrupole(list.quadrupoles[i], list.quadrupoleCenters[i], target);
+    }
+    return total;
+}
+
+bool kernelSupported(KernelTarget target) {
+    switch (target) {
+    case KernelTarget::SCALAR:
+        return true;
+#ifdef NBSIM_X86_KERNELS
+    case KernelTarget::AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case KernelTarget::AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+// Returns the widest target supported by the CPU
+static KernelTarget detectTarget() {
+    if (kernelSupported(KernelTarget::AVX512))
+        return KernelTarget::AVX512;
+    if (kernelSupported(KernelTarget::AVX2))
+        return KernelTarget::AVX2;
+    return KernelTarget::SCALAR;
+}
+
+// Returns the implementation of a supported target
+static KernelFunction kernelFor(KernelTarget target) {
+#ifdef NBSIM_X86_KERNELS
+    if (target == KernelTarget::AVX512)
+        return gravityAvx512;
+    if (target == KernelTarget::AVX2)
+        return gravityAvx2;
+#endif
+    return gravityScalar<FieldReal>;
+}
+
+#ifdef NBSIM_MIXED
+// Returns the implementation over bodies of a supported target
+static BodyKernelFunction bodyKernelFor(KernelTarget target) {
+#ifdef NBSIM_X86_KERNELS
+    if (target == KernelTarget::AVX512)
+        return gravityAvx512;
+    if (target == KernelTarget::AVX2)
+        return gravityAvx2;
+#endif
+    return gravityScalar<Real>;
+}
+#endif
+
+// Returns the mutual implementation of a supported target
+static MutualKernelFunction mutualKernelFor(KernelTarget target) {
+#ifdef NBSIM_X86_KERNELS
+    if (target == KernelTarget::AVX512)
+        return mutualAvx512;
+    if (target == KernelTarget::AVX2)
+        return mutualAvx2;
+#endif
+    return mutualScalar;
+}
+
+// Target and implementation in use. Changing them while kernels are being
+// evaluated on other threads is not supported.
+static KernelTarget activeTarget = detectTarget();
+static KernelFunction activeKernel = kernelFor(activeTarget);
+static MutualKernelFunction activeMutualKernel = mutualKernelFor(activeTarget);
+#ifdef NBSIM_MIXED
+static BodyKernelFunction activeBodyKernel = bodyKernelFor(activeTarget);
+#endif
+
+Vec3 accelerationGravity(
+    const FieldReal* x, const FieldReal* y, const FieldReal* z, const FieldReal* mass, size_t count,
+    const Vec3& target
+) {
+    return activeKernel(x, y, z, mass, count, target);
+}
+
+#ifdef NBSIM_MIXED
+Vec3 accelerationGravity(
+    const Real* x, const Real* y, const Real* z, const Real* mass, size_t count, const Vec3& target
+) {
+    return activeBodyKernel(x, y, z, mass, count, target);
+}
+#endif
+
+Vec3 mutualGravity(const MutualBodies& bodies, const Vec3& target, Real targetMass) {
+    return activeMutualKernel(bodies, target, targetMass);
+}
+
+KernelTarget kernelTarget() { return activeTarget; }
+
+void setKernelTarget(KernelTarget target) {
+    if (!kernelSupported(target))
+        throw runtime_error("Error: The CPU does not support the requested gravity kernel.");
+    activeTarget = target;
+    activeKernel = kernelFor(target);
+    activeMutualKernel = mutualKernelFor(target);
+#ifdef NBSIM_MIXED
+    activeBodyKernel = bodyKernelFor(target);
+#endif
+}
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef GRAVITY_KERNEL_H
+#define GRAVITY_KERNEL_H
+
+#include <cstddef>
+
+#include "nbsim/core/gravity/interaction_list.hpp"
+#include "nbsim/core/gravity/quadrupole.hpp"
+#include "nbsim/core/vec3/vec3.hpp"
+
+// Gravitational constant used throughout the simulation
+constexpr double GRAVITATIONAL_CONSTANT = 6.678E-11;
+
+// Instruction sets the gravity kernel can be evaluated with
+enum class KernelTarget : char { SCALAR, AVX2, AVX512 };
+
+// Returns the acceleration that count point masses exert on a body at target.
+// Sources are given as separate component arrays. Sources at exactly the
+// position of the target are skipped, so a body may appear in its own source
+// list.
+Vec3 accelerationGravity(
+    const FieldReal* x, const FieldReal* y, const FieldReal* z, const FieldReal* mass, size_t count,
+    const Vec3& target
+);
+
+#ifdef NBSIM_MIXED
+// Same for sources in the precision of bodies, for bodies that may lie close
+// to the target. Their offsets from the target are formed in double precision.
+Vec3 accelerationGravity(
+    const Real* x, const Real* y, const Real* z, const Real* mass, size_t count, const Vec3& target
+);
+#endif
+
+/**
+ * A range of bodies given as separate component arrays, whose accelerations
+ * are accumulated in place by mutualGravity
+ */
+struct MutualBodies {
+    const Real* x;    // x components of the positions
+    const Real* y;    // y components of the positions
+    const Real* z;    // z components of the positions
+    const Real* mass; // masses
+    Real* ax;         // x components of the accelerations
+    Real* ay;         // y components of the accelerations
+    Real* az;         // z components of the accelerations
+    size_t count;     // number of bodies
+
+    // Returns the bodies from the given index on
+    MutualBodies from(size_t index) const {
+        return MutualBodies{
+            x + index, y + index, z + index, mass + index, ax + index, ay + index, az + index, count - index
+        };
+    }
+};
+
+// Returns the acceleration that bodies exert on a body of the given mass at
+// target, and adds the opposite pull of that body to the acceleration of each
+// of bodies, so that every pair is evaluated once. Bodies at exactly the
+// position of the target are skipped.
+Vec3 mutualGravity(const MutualBodies& bodies, const Vec3& target, Real targetMass);
+
+// Returns the acceleration the quadrupole moment of a group of bodies centered
+// at center exerts on a body at target, on top of the group's mass
+Vec3 accelerationQuadrupole(const Quadrupole& moment, const Vec3& center, const Vec3& target);
+
+// Returns the acceleration all sources in list exert on a body at target,
+// including their quadrupole moments
+Vec3 accelerationGravity(const InteractionList& list, const Vec3& target);
+
+// Returns true if the CPU running the program supports the given target
+bool kernelSupported(KernelTarget target);
+
+// Returns the target the kernel is currently evaluated with. Unless set
+// explicitly, this is the widest target the CPU supports.
+KernelTarget kernelTarget();
+
+// Forces the kernel to be evaluated with the given target, for example to
+// compare runs across machines. Throws std::runtime_error if the CPU does not
+// support the target.
+void setKernelTarget(KernelTarget target);
+
+#endif
@@ -0,0 +1,209 @@
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+class TestGravityKernel : public ::testing::Test {
+  protected:
+    TestGravityKernel() : initial{kernelTarget()} {}
+    ~TestGravityKernel() { setKernelTarget(initial); }
+    KernelTarget initial;
+    // Relative error allowed against the reference, which depends on the
+    // precision of the kernel's terms
+    static constexpr double TOLERANCE = is_same_v<FieldReal, float> ? 1e-5 : 1e-12;
+
+    // Straightforward evaluation of Newtonian gravity in double precision to
+    // compare against
+    static Vec3 reference(const InteractionList& list, const Vec3& target) {
+        Vec3T<double> total{0, 0, 0};
+        for (size_t i = 0; i < list.size(); i++) {
+            Vec3T<double> r = target.to<double>() - Vec3T<double>{list.x[i], list.y[i], list.z[i]};
+            if (r.length() == 0)
+                continue;
+            total += r * (-GRAVITATIONAL_CONSTANT * list.mass[i] / pow(r.length(), 3));
+        }
+        return total.to<Real>();
+    }
+
+    // Returns count random sources within extent of the origin on each axis
+    static InteractionList randomList(size_t count, unsigned seed, Real extent = 1e12) {
+        mt19937 twister(seed);
+        uniform_real_distribution<Real> positionGen(-extent, extent);
+        uniform_real_distribution<Real> massGen(1e20, 1e28);
+        InteractionList list;
+        for (size_t i = 0; i < count; i++) {
+            list.push(massGen(twister), Vec3{positionGen(twister), positionGen(twister), positionGen(twister)});
+        }
+        return list;
+    }
+
+    // Sources of a list in the precision of bodies, as taken by the mutual
+    // kernel
+    struct Bodies {
+        vector<Real> x, y, z, mass;
+        explicit Bodies(const InteractionList& list)
+            : x(list.x.begin(), list.x.end()),
+              y(list.y.begin(), list.y.end()),
+              z(list.z.begin(), list.z.end()),
+              mass(list.mass.begin(), list.mass.end()) {}
+    };
+
+    static void expectClose(const Vec3& actual, const Vec3& expected) {
+        // in double precision, which squares of tiny accelerations underflow
+        // in single precision
+        double scale = expected.to<double>().length();
+        EXPECT_NEAR(actual.x, expected.x, TOLERANCE * scale);
+        EXPECT_NEAR(actual.y, expected.y, TOLERANCE * scale);
+        EXPECT_NEAR(actual.z, expected.z, TOLERANCE * scale);
+    }
+};
+
+TEST_F(TestGravityKernel, ScalarIsAlwaysSupported) { EXPECT_TRUE(kernelSupported(KernelTarget::SCALAR)); }
+
+TEST_F(TestGravityKernel, SingleSourcePullsTowardsIt) {
+    InteractionList list;
+    list.push(1e10, Vec3{0, 0, 0});
+    Vec3 acceleration = accelerationGravity(list, Vec3{2, 0, 0});
+    EXPECT_NEAR(acceleration.x, -GRAVITATIONAL_CONSTANT * 1e10 / 4, TOLERANCE);
+    EXPECT_EQ(acceleration.y, 0);
+    EXPECT_EQ(acceleration.z, 0);
+}
+
+TEST_F(TestGravityKernel, AllTargetsMatchReference) {
+    for (KernelTarget target : {KernelTarget::SCALAR, KernelTarget::AVX2, KernelTarget::AVX512}) {
+        if (!kernelSupported(target))
+            continue;
+        setKernelTarget(target);
+        // cover every remainder length of the vector kernels
+        for (size_t count = 0; count < 40; count++) {
+            InteractionList list = randomList(count, unsigned(count));
+            Vec3 position{1e11, -3e11, 2e10};
+            expectClose(accelerationGravity(list, position), reference(list, position));
+        }
+    }
+}
+
+TEST_F(TestGravityKernel, SourcesAtTargetAreSkipped) {
+    for (KernelTarget target : {KernelTarget::SCALAR, KernelTarget::AVX2, KernelTarget::AVX512}) {
+        if (!kernelSupported(target))
+            continue;
+        setKernelTarget(target);
+        InteractionList list = randomList(13, 3);
+        Vec3 position{list.x[5], list.y[5], list.z[5]};
+        Vec3 acceleration = accelerationGravity(list, position);
+        EXPECT_TRUE(isfinite(acceleration.x) && isfinite(acceleration.y) && isfinite(acceleration.z));
+        expectClose(acceleration, reference(list, position));
+    }
+}
+
+TEST_F(TestGravityKernel, MutualKernelAppliesBothSidesOfEveryPair) {
+    for (KernelTarget target : {KernelTarget::SCALAR, KernelTarget::AVX2, KernelTarget::AVX512}) {
+        if (!kernelSupported(target))
+            continue;
+        setKernelTarget(target);
+        for (size_t count = 0; count < 40; count++) {
+            InteractionList list = randomList(count, unsigned(count));
+            Bodies copy(list);
+            vector<Real> ax(count, 0), ay(count, 0), az(count, 0);
+            MutualBodies bodies{
+                copy.x.data(), copy.y.data(), copy.z.data(), copy.mass.data(), ax.data(), ay.data(), az.data(), count
+            };
+            Vec3 position{1e11, -3e11, 2e10};
+            const double mass = 4e27;
+            expectClose(mutualGravity(bodies, position, mass), reference(list, position));
+            InteractionList single;
+            single.push(mass, position);
+            for (size_t i = 0; i < count; i++) {
+                expectClose(Vec3{ax[i], ay[i], az[i]}, reference(single, Vec3{list.x[i], list.y[i], list.z[i]}));
+            }
+            // a second call adds to the accelerations
+            mutualGravity(bodies, position, mass);
+            for (size_t i = 0; i < count; i++) {
+                expectClose(Vec3{ax[i], ay[i], az[i]}, reference(single, Vec3{list.x[i], list.y[i], list.z[i]}) * 2);
+            }
+        }
+    }
+}
+
+TEST_F(TestGravityKernel, AllTargetsHandleAstronomicalDistances) {
+    // squares of these distances overflow single precision
+    for (KernelTarget target : {KernelTarget::SCALAR, KernelTarget::AVX2, KernelTarget::AVX512}) {
+        if (!kernelSupported(target))
+            continue;
+        setKernelTarget(target);
+        for (size_t count = 1; count < 40; count++) {
+            InteractionList list = randomList(count, unsigned(count), 1e20);
+            Vec3 position{1e20, -3e20, 2e19};
+            expectClose(accelerationGravity(list, position), reference(list, position));
+            Bodies copy(list);
+            vector<Real> ax(count, 0), ay(count, 0), az(count, 0);
+            MutualBodies bodies{
+                copy.x.data(), copy.y.data(), copy.z.data(), copy.mass.data(), ax.data(), ay.data(), az.data(), count
+            };
+            const double mass = 4e27;
+            expectClose(mutualGravity(bodies, position, mass), reference(list, position));
+            InteractionList single;
+            single.push(mass, position);
+            for (size_t i = 0; i < count; i++) {
+                expectClose(Vec3{ax[i], ay[i], az[i]}, reference(single, Vec3{list.x[i], list.y[i], list.z[i]}));
+            }
+        }
+    }
+}
+
+#ifndef NBSIM_FLOAT
+TEST_F(TestGravityKernel, CloseBodiesFarFromOriginKeepTheirOffset) {
+    // single precision resolves about 1e5 m this far from the origin, which
+    // must not apply to bodies with double precision positions
+    const Vec3 position{1e12, -1e12, 1e12};
+    const Vec3 offset{300, -400, 1200};
+    const Vec3 other = position + offset;
+    const double mass = 4e27;
+    // pulled towards the other body, 1300 m away
+    const Vec3 expected = offset * (GRAVITATIONAL_CONSTANT * mass / pow(1300.0, 3));
+    for (KernelTarget target : {KernelTarget::SCALAR, KernelTarget::AVX2, KernelTarget::AVX512}) {
+        if (!kernelSupported(target))
+            continue;
+        setKernelTarget(target);
+        InteractionList list;
+        list.pushBody(mass, other);
+        expectClose(accelerationGravity(list, position), expected);
+        const Real x = other.x, y = other.y, z = other.z, m = mass;
+        expectClose(accelerationGravity(&x, &y, &z, &m, 1, position), expected);
+        Real ax = 0, ay = 0, az = 0;
+        MutualBodies bodies{&x, &y, &z, &m, &ax, &ay, &az, 1};
+        expectClose(mutualGravity(bodies, position, mass), expected);
+        expectClose(Vec3{ax, ay, az}, expected * -1);
+    }
+}
+#endif
+
+TEST_F(TestGravityKernel, QuadrupoleImprovesFarFieldOfCluster) {
+    InteractionList cluster = randomList(50, 13);
+    double mass = 0;
+    Vec3T<double> weighted{0, 0, 0};
+    for (size_t i = 0; i < cluster.size(); i++) {
+        mass += cluster.mass[i];
+        weighted += Vec3T<double>{cluster.x[i], cluster.y[i], cluster.z[i]} * cluster.mass[i];
+    }
+    Vec3 center = (weighted * (1 / mass)).to<Real>();
+    Quadrupole moment{};
+    for (size_t i = 0; i < cluster.size(); i++) {
+        moment.addPoint(cluster.mass[i], (Vec3{cluster.x[i], cluster.y[i], cluster.z[i]} - center).to<double>());
+    }
+    InteractionList monopole;
+    monopole.push(Real(mass), center);
+    InteractionList quadrupole = monopole;
+    quadrupole.pushQuadrupole(center, moment);
+
+    Vec3 target{8e12, -5e12, 3e12};
+    Vec3 expected = reference(cluster, target);
+    double monopoleError = (accelerationGravity(monopole, target) - expected).length();
+    double quadrupoleError = (accelerationGravity(quadrupole, target) - expected).length();
+    EXPECT_LT(quadrupoleError, monopoleError / 2);
+    EXPECT_LT(quadrupoleError, 1e-3 * expected.length());
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef INTERACTION_LIST_H
+#define INTERACTION_LIST_H
+
+#include <vector>
+
+#include "nbsim/core/gravity/quadrupole.hpp"
+#include "nbsim/core/vec3/vec3.hpp"
+
+/**
+ * A batch of point masses acting on a target, stored as separate arrays per
+ * component so gravity kernels can load several sources at once. Sources may
+ * carry a quadrupole moment on top of their mass, which is stored separately.
+ */
+struct InteractionList {
+    std::vector<FieldReal> x;    // x component of source positions
+    std::vector<FieldReal> y;    // y component of source positions
+    std::vector<FieldReal> z;    // z component of source positions
+    std::vector<FieldReal> mass; // source masses
+#ifdef NBSIM_MIXED
+    // Individual bodies, kept in the precision of bodies. A body may lie
+    // closer to the target than single precision resolves at their distance
+    // from the origin.
+    std::vector<Real> bodyX;
+    std::vector<Real> bodyY;
+    std::vector<Real> bodyZ;
+    std::vector<Real> bodyMass;
+#endif
+    // Centers of mass and moments of sources with a quadrupole moment
+    std::vector<Vec3> quadrupoleCenters;
+    std::vector<Quadrupole> quadrupoles;
+
+    // Appends a point mass standing in for a group of bodies, like a tree
+    // node, to the list
+    void push(Real sourceMass, const Vec3& position) {
+        x.push_back(FieldReal(position.x));
+        y.push_back(FieldReal(position.y));
+        z.push_back(FieldReal(position.z));
+        mass.push_back(FieldReal(sourceMass));
+    }
+    // Appends a single body to the list
+    void pushBody(Real sourceMass, const Vec3& position) {
+#ifdef NBSIM_MIXED
+        bodyX.push_back(position.x);
+        bodyY.push_back(position.y);
+        bodyZ.push_back(position.z);
+        bodyMass.push_back(sourceMass);
+#else
+        push(sourceMass, position);
+#endif
+    }
+    // Appends the quadrupole moment of a source centered at position. Its
+    // mass must be pushed separately.
+    void pushQuadrupole(const Vec3& position, const Quadrupole& moment) {
+        quadrupoleCenters.push_back(position);
+        quadrupoles.push_back(moment);
+    }
+    // Removes all sources, keeping allocated memory
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        mass.clear();
+#ifdef NBSIM_MIXED
+        bodyX.clear();
+        bodyY.clear();
+        bodyZ.clear();
+        bodyMass.clear();
+#endif
+        quadrupoleCenters.clear();
+        quadrupoles.clear();
+    }
+    // Returns number of sources in the list
+    size_t size() const {
+#ifdef NBSIM_MIXED
+        return mass.size() + bodyMass.size();
+#else
+        return mass.size();
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef QUADRUPOLE_H
+#define QUADRUPOLE_H
+
+#include "nbsim/core/vec3/vec3.hpp"
+
+/**
+ * Traceless quadrupole moment of a group of point masses about their center of
+ * mass, Q_ij = sum m (3 d_i d_j - |d|^2 delta_ij) over offsets d from the
+ * center. The tensor is symmetric, so only six components are stored.
+ *
+ * Components are kept in double precision whatever the build, as mass times
+ * squared distance overflows single precision for astronomical systems.
+ */
+struct Quadrupole {
+    double xx; // xx component
+    double xy; // xy and yx components
+    double xz; // xz and zx components
+    double yy; // yy component
+    double yz; // yz and zy components
+    double zz; // zz component
+
+    // Adds the moment of a point mass at the given offset from the center
+    void addPoint(double mass, const Vec3T<double>& offset) {
+        const double d2 = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+        xx += mass * (3 * offset.x * offset.x - d2);
+        xy += mass * 3 * offset.x * offset.y;
+        xz += mass * 3 * offset.x * offset.z;
+        yy += mass * (3 * offset.y * offset.y - d2);
+        yz += mass * 3 * offset.y * offset.z;
+        zz += mass * (3 * offset.z * offset.z - d2);
+    }
+    // Adds another moment about the same center
+    void add(const Quadrupole& other) {
+        xx += other.xx;
+        xy += other.xy;
+        xz += other.xz;
+        yy += other.yy;
+        yz += other.yz;
+        zz += other.zz;
+    }
+    // Returns the product of the tensor with r
+    Vec3T<double> apply(const Vec3T<double>& r) const {
+        return Vec3T<double>{
+            xx * r.x + xy * r.y + xz * r.z, xy * r.x + yy * r.y + yz * r.z, xz * r.x + yz * r.y + zz * r.z
+        };
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "nbsim/core/input/body_parser.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+BodyParser::BodyParser(string_view text) : begin{text.data()}, cursor{text.data()}, end{text.data() + text.size()} {}
+
+void BodyParser::fail(const string& expected) const {
+    throw runtime_error("Error: Expected " + expected + " at byte " + to_string(cursor - begin) + " of input.");
+}
+
+void BodyParser::skipWhitespace() {
+    while (cursor != end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t'))
+        cursor++;
+}
+
+bool BodyParser::consume(char c) {
+    skipWhitespace();
+    if (cursor != end && *cursor == c) {
+        cursor++;
+        return true;
+    }
+    return false;
+}
+
+void BodyParser::expect(char c) {
+    if (!consume(c))
+        fail(string("'") + c + "'");
+}
+
+string_view BodyParser::parseString() {
+    expect('"');
+    const char* start = cursor;
+    while (cursor != end && *cursor != '"') {
+        // keys and values of interest never need escapes, but skipped strings
+        // may contain them
+        if (*cursor == '\\' && cursor + 1 != end)
+            cursor++;
+        cursor++;
+    }
+    if (cursor == end)
+        fail("'\"'");
+    return string_view(start, size_t(cursor++ - start));
+}
+
+double BodyParser::parseNumber() {
+    skipWhitespace();
+    double value = 0;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto [next, error] = from_chars(cursor, end, value);
+    if (error != errc())
+        fail("a number");
+    cursor = next;
+#else
+    // some standard libraries, like Apple's libc++, lack from_chars for
+    // floating point. strtod needs a terminated string, which the text is not,
+    // so the characters a number may consist of are copied out first.
+    const char* start = cursor;
+    while (cursor != end && ((*cursor >= '0' && *cursor <= '9') || *cursor == '-' || *cursor == '+' ||
+                             *cursor == '.' || *cursor == 'e' || *cursor == 'E'))
+        cursor++;
+    const string number(start, cursor);
+    char* next = nullptr;
+    errno = 0;
+    value = strtod(number.c_str(), &next);
+    // like from_chars, accepts no plus sign and no out of range values
+    if (next == number.c_str() || number[0] == '+' || errno == ERANGE) {
+        cursor = start;
+        fail("a number");
+    }
+    cursor = start + (next - number.c_str());
+#endif
+    return value;
+}
+
+Vec3 BodyParser::parseVec3() {
+    Vec3 vector{0, 0, 0};
+    expect('{');
+    if (consume('}'))
+        return vector;
+    do {
+        string_view key = parseString();
+        expect(':');
+        if (key == "x")
+            vector.x = parseNumber();
+        else if (key == "y")
+            vector.y = parseNumber();
+        else if (key == "z")
+            vector.z = parseNumber();
+        else
+            skipValue();
+    } while (consume(','));
+    expect('}');
+    return vector;
+}
+
+Body BodyParser::parseBody() {
+    Body body;
+    bool hasMass = false;
+    bool hasPosition = false;
+    expect('{');
+    const char* start = cursor;
+    if (!consume('}')) {
+        do {
+            string_view key = parseString();
+            expect(':');
+            if (key == "mass") {
+                body.mass = parseNumber();
+                hasMass = true;
+            } else if (key == "position") {
+                body.position = parseVec3();
+                hasPosition = true;
+            } else if (key == "velocity") {
+                body.velocity = parseVec3();
+            } else if (key == "acceleration") {
+                body.acceleration = parseVec3();
+            } else {
+                skipValue();
+            }
+        } while (consume(','));
+        expect('}');
+    }
+    if (!hasMass || !hasPosition) {
+        cursor = start;
+        fail("a body with a mass and a position");
+    }
+    return body;
+}
+
+void BodyParser::skipValue() {
+    skipWhitespace();
+    if (cursor == end)
+        fail("a value");
+    switch (*cursor) {
+    case '"':
+        parseString();
+        return;
+    case '{':
+    case '[': {
+        const char close = (*cursor == '{') ? '}' : ']';
+        cursor++;
+        if (consume(close))
+            return;
+        do {
+            if (close == '}') {
+                parseString();
+                expect(':');
+            }
+            skipValue();
+        } while (consume(','));
+        expect(close);
+        return;
+    }
+    default:
+        // numbers and literals run up to the next delimiter
+        while (cursor != end && *cursor != ',' && *cursor != '}' && *cursor != ']' && *cursor != ' ' &&
+               *cursor != '\n' && *cursor != '\r' && *cursor != '\t')
+            cursor++;
+    }
+}
+
+void BodyParser::parse(vector<Body>& bodies) {
+    // a body takes at least this many bytes in practice, which avoids most
+    // reallocations without a counting pass
+    bodies.reserve(bodies.size() + size_t(end - cursor) / 256);
+    parse([&bodies](const Body& body) { bodies.push_back(body); });
+}
+
+void BodyParser::parse(const function<void(const Body&)>& add) {
+    expect('{');
+    bool found = false;
+    if (!consume('}')) {
+        do {
+            string_view key = parseString();
+            expect(':');
+            if (key != "bodies") {
+                skipValue();
+                continue;
+            }
+            found = true;
+            expect('[');
+            if (consume(']'))
+                continue;
+            do {
+                add(parseBody());
+            } while (consume(','));
+            expect(']');
+        } while (consume(','));
+        expect('}');
+    }
+    if (!found) {
+        cursor = begin;
+        fail("a \"bodies\" array");
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef BODY_PARSER_H
+#define BODY_PARSER_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nbsim/core/octree/body.hpp"
+#include "nbsim/core/vec3/vec3.hpp"
+
+/**
+ * Parses bodies from a JSON document of the form
+ *
+ *   {"bodies": [{"mass": m, "position": {"x": x, "y": y, "z": z},
+ *                "velocity": {...}, "acceleration": {...}}, ...]}
+ *
+ * in a single pass over the text, without copying it. Numbers are parsed at
+ * full double precision. Keys may come in any order, unknown keys are skipped,
+ * and missing vectors default to zero, but every body needs a mass and a
+ * position.
+ */
+class BodyParser {
+  private:
+    const char* begin;  // start of the text, used to report offsets
+    const char* cursor; // next character to read
+    const char* end;    // end of the text
+    // Throws std::runtime_error describing what was expected at the cursor
+    [[noreturn]] void fail(const std::string& expected) const;
+    // Skips any whitespace at the cursor
+    void skipWhitespace();
+    // Skips whitespace, then consumes c if it is next. Returns if it was.
+    bool consume(char c);
+    // Skips whitespace, then consumes c or fails
+    void expect(char c);
+    // Parses a string without escape sequences, returning its contents
+    std::string_view parseString();
+    // Parses a number
+    double parseNumber();
+    // Parses an object of x, y and z numbers
+    Vec3 parseVec3();
+    // Parses a single body object
+    Body parseBody();
+    // Skips any JSON value
+    void skipValue();
+
+  public:
+    // Creates a parser over text, which must outlive the parser
+    explicit BodyParser(std::string_view text);
+    // Parses all bodies and appends them to bodies. Throws
+    // std::runtime_error, giving the byte offset, if the text is malformed.
+    void parse(std::vector<Body>& bodies);
+    // Parses all bodies, passing each to add as soon as it is parsed, so that
+    // they can go straight into their final storage. Throws like the overload
+    // above, after passing on the bodies before the error.
+    void parse(const std::function<void(const Body&)>& add);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "nbsim/core/input/body_parser.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+
+class TestBodyParser : public ::testing::Test {
+  protected:
+    TestBodyParser() = default;
+    vector<Body> parse(const string& text) {
+        vector<Body> bodies;
+        BodyParser(text).parse(bodies);
+        return bodies;
+    }
+};
+
+TEST_F(TestBodyParser, ParsesBodiesAtFullPrecision) {
+    vector<Body> bodies = parse(R"({"bodies": [
+        {"mass": 1.343642527687588e+27,
+         "position": {"x": 694867473874465.2, "y": -5.5e-3, "z": 0},
+         "velocity": {"x": 24771.754354597047, "y": 1, "z": 2},
+         "acceleration": {"x": 0, "y": 0, "z": 3}},
+        {"mass": 2, "position": {"x": 1, "y": 2, "z": 3},
+         "velocity": {"x": 4, "y": 5, "z": 6}, "acceleration": {"x": 7, "y": 8, "z": 9}}
+    ]})");
+    ASSERT_EQ(bodies.size(), 2);
+    EXPECT_EQ(bodies[0].mass, Real(1.343642527687588e+27));
+    EXPECT_EQ(bodies[0].position, (Vec3{694867473874465.2, -5.5e-3, 0}));
+    EXPECT_EQ(bodies[0].velocity, (Vec3{24771.754354597047, 1, 2}));
+    EXPECT_EQ(bodies[0].acceleration, (Vec3{0, 0, 3}));
+    EXPECT_EQ(bodies[1].mass, 2);
+    EXPECT_EQ(bodies[1].acceleration, (Vec3{7, 8, 9}));
+}
+
+TEST_F(TestBodyParser, AcceptsAnyKeyOrderAndSkipsUnknownKeys) {
+    vector<Body> bodies = parse(R"({"name": "test", "bodies": [{"velocity": {"z": 3, "x": 1},
+        "tags": ["a", {"b": [1, 2]}, null, true], "position": {"y": 2, "x": 1, "z": 3, "w": 4},
+        "label": "say \"hi\"", "mass": 5}], "extra": {}})");
+    ASSERT_EQ(bodies.size(), 1);
+    EXPECT_EQ(bodies[0].mass, 5);
+    EXPECT_EQ(bodies[0].position, (Vec3{1, 2, 3}));
+    EXPECT_EQ(bodies[0].velocity, (Vec3{1, 0, 3}));
+    EXPECT_EQ(bodies[0].acceleration, (Vec3{0, 0, 0}));
+}
+
+TEST_F(TestBodyParser, PassesEachBodyOnInOrder) {
+    vector<Real> masses;
+    BodyParser(R"({"bodies": [{"mass": 3, "position": {}}, {"mass": 1, "position": {}}]})")
+        .parse([&masses](const Body& body) { masses.push_back(body.mass); });
+    EXPECT_EQ(masses, (vector<Real>{3, 1}));
+}
+
+TEST_F(TestBodyParser, AcceptsEmptyBodyList) {
+    EXPECT_TRUE(parse(R"({"bodies": []})").empty());
+}
+
+TEST_F(TestBodyParser, RejectsMalformedInput) {
+    EXPECT_THROW(parse(""), std::runtime_error);
+    EXPECT_THROW(parse(R"({"planets": []})"), std::runtime_error);
+    EXPECT_THROW(parse(R"({"bodies": [{"mass": 1}]})"), std::runtime_error);
+    EXPECT_THROW(parse(R"({"bodies": [{"mass": x, "position": {}}]})"), std::runtime_error);
+    EXPECT_THROW(parse(R"({"bodies": [{"mass": 1, "position": {"x": 1})"), std::runtime_error);
+    try {
+        parse(R"({"bodies": [{"mass" 1}]})");
+        FAIL();
+    } catch (std::runtime_error& e) {
+        EXPECT_NE(string(e.what()).find("byte 20"), string::npos) << e.what();
+    }
+}
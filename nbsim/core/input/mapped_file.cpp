@@ -0,0 +1,43 @@
+#include "nbsim/core/input/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) : data{nullptr}, length{0} {
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw runtime_error("Error: Could not open " + path + ".");
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        throw runtime_error("Error: Could not read the size of " + path + ".");
+    }
+    length = size_t(status.st_size);
+    // mapping zero bytes fails, and there is nothing to read anyway
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            close(descriptor);
+            throw runtime_error("Error: Could not map " + path + " into memory.");
+        }
+        // the file is read front to back exactly once
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+    if (data)
+        munmap(const_cast<char*>(data), length);
+}
+
+string_view MappedFile::contents() const { return string_view(data, length); }
+
+size_t MappedFile::size() const { return length; }
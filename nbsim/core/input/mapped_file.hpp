@@ -0,0 +1,32 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * A file mapped read-only into memory. The contents are paged in by the
+ * operating system as they are first touched, so reading a large file costs
+ * no copies through stream buffers.
+ */
+class MappedFile {
+  private:
+    const char* data; // start of the mapping, null for empty files
+    size_t length;    // size of the file in bytes
+
+  public:
+    // Maps the file at path. Throws std::runtime_error if it cannot be opened
+    // or mapped.
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    // Returns the contents of the file
+    std::string_view contents() const;
+    // Returns the size of the file in bytes
+    size_t size() const;
+};
+
+#endif
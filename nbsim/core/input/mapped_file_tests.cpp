@@ -0,0 +1,42 @@
+#include "nbsim/core/input/mapped_file.hpp"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+class TestMappedFile : public ::testing::Test {
+  protected:
+    TestMappedFile() = default;
+    // Writes contents to a new temporary file and returns its path
+    string writeTemporary(const string& contents) {
+        string path = testing::TempDir() + "mapped_file_test_" + to_string(counter++);
+        ofstream(path, ios::binary) << contents;
+        paths.push_back(path);
+        return path;
+    }
+    ~TestMappedFile() override {
+        for (const string& path : paths) {
+            remove(path.c_str());
+        }
+    }
+    vector<string> paths;
+    int counter = 0;
+};
+
+TEST_F(TestMappedFile, MapsFileContents) {
+    const string contents = "{\"bodies\": []}\n";
+    MappedFile file(writeTemporary(contents));
+    EXPECT_EQ(file.size(), contents.size());
+    EXPECT_EQ(file.contents(), contents);
+}
+
+TEST_F(TestMappedFile, MapsEmptyFile) {
+    MappedFile file(writeTemporary(""));
+    EXPECT_EQ(file.size(), 0);
+    EXPECT_TRUE(file.contents().empty());
+}
+
+TEST_F(TestMappedFile, ThrowsForMissingFile) {
+    EXPECT_THROW(MappedFile(testing::TempDir() + "does_not_exist.json"), std::runtime_error);
+}
@@ -1,9 +1,11 @@
 #include "nbsim/core/octree/body.hpp"
 
-Body::Body() : Object{}, velocity{Vec3{0, 0, 0}}, acceleration{Vec3{0, 0, 0}} {}
+template <typename T>
+BodyT<T>::BodyT() : ObjectT<T>{}, velocity{Vec3T<T>{0, 0, 0}}, acceleration{Vec3T<T>{0, 0, 0}} {}
 
-Body::Body(double mass, Vec3 position, Vec3 velocity, Vec3 acceleration)
-    : Object(mass, position),
+template <typename T>
+BodyT<T>::BodyT(T mass, Vec3T<T> position, Vec3T<T> velocity, Vec3T<T> acceleration)
+    : ObjectT<T>(mass, position),
       velocity{velocity},
       acceleration{acceleration} {
     // perform bounds checking
@@ -25,4 +27,7 @@ Body::Body(double mass, Vec3 position, Vec3 velocity, Vec3 acceleration)
             "Error: Cannot create body with acceleration component greater than 1e150 meters per second."
         );
     }
-}
\ No newline at end of file
+}
+
+template class BodyT<float>;
+template class BodyT<double>;
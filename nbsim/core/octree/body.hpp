@@ -7,12 +7,15 @@
 /**
  * An Object that experiences motion in the simulation. Is affected by gravity
  */
-class Body : public Object {
+template <typename T> class BodyT : public ObjectT<T> {
   public:
-    Vec3 velocity;
-    Vec3 acceleration;
-    Body();
-    Body(double mass, Vec3 position, Vec3 velocity, Vec3 acceleration);
+    Vec3T<T> velocity;
+    Vec3T<T> acceleration;
+    BodyT();
+    BodyT(T mass, Vec3T<T> position, Vec3T<T> velocity, Vec3T<T> acceleration);
 };
 
+// Body of the precision chosen at build time
+using Body = BodyT<Real>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef BODY_ARRAYS_H
+#define BODY_ARRAYS_H
+
+#include <array>
+#include <vector>
+
+#include "nbsim/core/octree/body.hpp"
+
+/**
+ * Bodies stored as a structure of arrays: every field of every body lives in
+ * its own contiguous array, and a body is identified by its index in all of
+ * them.
+ */
+struct BodyArrays {
+    std::vector<Real> mass; // body masses
+    std::vector<Real> x;    // x component of body positions
+    std::vector<Real> y;    // y component of body positions
+    std::vector<Real> z;    // z component of body positions
+    std::vector<Real> vx;   // x component of body velocities
+    std::vector<Real> vy;   // y component of body velocities
+    std::vector<Real> vz;   // z component of body velocities
+    std::vector<Real> ax;   // x component of body accelerations
+    std::vector<Real> ay;   // y component of body accelerations
+    std::vector<Real> az;   // z component of body accelerations
+
+    // Returns number of bodies stored
+    size_t size() const { return mass.size(); }
+    // Appends a body to the arrays
+    void push(const Body& body) {
+        mass.push_back(body.mass);
+        x.push_back(body.position.x);
+        y.push_back(body.position.y);
+        z.push_back(body.position.z);
+        vx.push_back(body.velocity.x);
+        vy.push_back(body.velocity.y);
+        vz.push_back(body.velocity.z);
+        ax.push_back(body.acceleration.x);
+        ay.push_back(body.acceleration.y);
+        az.push_back(body.acceleration.z);
+    }
+    // Removes all bodies
+    void clear() {
+        for (std::vector<Real>* field : fields()) {
+            field->clear();
+        }
+    }
+    // Returns a copy of the body at the given index
+    Body load(size_t index) const {
+        Body body;
+        body.mass = mass[index];
+        body.position = Vec3{x[index], y[index], z[index]};
+        body.velocity = Vec3{vx[index], vy[index], vz[index]};
+        body.acceleration = Vec3{ax[index], ay[index], az[index]};
+        return body;
+    }
+    // Overwrites the body at the given index
+    void store(size_t index, const Body& body) {
+        mass[index] = body.mass;
+        x[index] = body.position.x;
+        y[index] = body.position.y;
+        z[index] = body.position.z;
+        vx[index] = body.velocity.x;
+        vy[index] = body.velocity.y;
+        vz[index] = body.velocity.z;
+        ax[index] = body.acceleration.x;
+        ay[index] = body.acceleration.y;
+        az[index] = body.acceleration.z;
+    }
+    // Returns the position of the body at the given index
+    Vec3 position(size_t index) const { return Vec3{x[index], y[index], z[index]}; }
+    // Returns pointers to every field array, to apply the same operation to all
+    // of them
+    std::array<std::vector<Real>*, 10> fields() { return {&mass, &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az}; }
+};
+
+#endif
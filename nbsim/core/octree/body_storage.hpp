@@ -0,0 +1,8 @@
+#pragma once
+#ifndef BODY_STORAGE_H
+#define BODY_STORAGE_H
+// Memory layouts available for the bodies of an Octree. AOS stores one Body
+// object per body, while SOA stores every field of every body in its own
+// contiguous array, so loops touching few fields only stream those fields.
+enum class BodyStorage : char { AOS, SOA };
+#endif
@@ -8,11 +8,11 @@
  * A cuboid bounding box
  */
 struct BoundingBox {
-    double width; // Width from one side to another
-    Vec3 center;  // Center of this bounding box
-    BoundingBox(double width) : width{width}, center{Vec3{0, 0, 0}} {}
-    BoundingBox(double x, double y, double z, double width) : width{width}, center{Vec3{x, y, z}} {}
-    BoundingBox(const Vec3& center, double width) : width{width}, center{center} {}
+    Real width;  // Width from one side to another
+    Vec3 center; // Center of this bounding box
+    BoundingBox(Real width) : width{width}, center{Vec3{0, 0, 0}} {}
+    BoundingBox(Real x, Real y, Real z, Real width) : width{width}, center{Vec3{x, y, z}} {}
+    BoundingBox(const Vec3& center, Real width) : width{width}, center{center} {}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "nbsim/core/octree/flat_octree.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+void FlatOctree::build(const Body* bodies, size_t count, Real width, ThreadPool* pool) {
+    gather(bodies, count);
+    build(count, width, pool);
+}
+
+void FlatOctree::gather(const Body* bodies, size_t count) {
+    for (vector<Real>& field : gathered) {
+        field.resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        gathered[0][i] = bodies[i].position.x;
+        gathered[1][i] = bodies[i].position.y;
+        gathered[2][i] = bodies[i].position.z;
+        gathered[3][i] = bodies[i].mass;
+    }
+    xs = gathered[0].data();
+    ys = gathered[1].data();
+    zs = gathered[2].data();
+    masses = gathered[3].data();
+}
+
+void FlatOctree::build(const BodyArrays& arrays, Real width, ThreadPool* pool) {
+    xs = arrays.x.data();
+    ys = arrays.y.data();
+    zs = arrays.z.data();
+    masses = arrays.mass.data();
+    build(arrays.size(), width, pool);
+}
+
+void FlatOctree::build(size_t count, Real width, ThreadPool* pool) {
+    clear();
+    if (count == 0)
+        return;
+    buildNodes(count, width, pool);
+    link();
+    if (quadrupolesEnabled)
+        computeQuadrupoles();
+}
+
+void FlatOctree::buildNodes(size_t count, Real width, ThreadPool* pool) {
+    order.resize(count);
+    scratch.resize(count);
+    iota(order.begin(), order.end(), 0);
+    FlatOctreeNode root{};
+    root.center = Vec3{0, 0, 0};
+    root.width = width;
+    root.firstBody = 0;
+    root.bodyCount = static_cast<uint32_t>(count);
+    nodes.push_back(root);
+    rootWidth = width;
+
+    // Pick how deep the tree is split serially before the remaining subtrees
+    // are built concurrently. Aim for a few subtrees per thread so that uneven
+    // subtrees still balance out.
+    size_t splitDepth = 0;
+    if (pool && pool->size() > 1 && count >= PARALLEL_THRESHOLD) {
+        while ((size_t(1) << (3 * splitDepth)) < 4 * pool->size()) {
+            splitDepth++;
+        }
+    }
+    if (splitDepth == 0) {
+        buildNode(nodes, 0, 0, MAX_DEPTH, nullptr);
+        return;
+    }
+    vector<uint32_t> tasks;
+    buildNode(nodes, 0, 0, splitDepth, &tasks);
+    const uint32_t topCount = static_cast<uint32_t>(nodes.size());
+
+    // Build each subtree into its own node array. Subtrees cover disjoint
+    // ranges of the order and scratch arrays, so they can share them.
+    vector<vector<FlatOctreeNode>> subtrees(tasks.size());
+    auto buildSubtree = [&](size_t task) {
+        subtrees[task].push_back(nodes[tasks[task]]);
+        buildNode(subtrees[task], 0, splitDepth, MAX_DEPTH, nullptr);
+    };
+    if (pool) {
+        pool->run(tasks.size(), buildSubtree);
+    } else {
+        for (size_t task = 0; task < tasks.size(); task++) {
+            buildSubtree(task);
+        }
+    }
+
+    // Stitch subtrees onto the end of the node array. The subtree root replaces
+    // its placeholder, and every other node moves to offset + index - 1.
+    vector<bool> isTask(topCount, false);
+    for (size_t task = 0; task < tasks.size(); task++) {
+        const uint32_t offset = static_cast<uint32_t>(nodes.size());
+        for (FlatOctreeNode& node : subtrees[task]) {
+            if (!node.isLeaf())
+                node.firstChild = offset + node.firstChild - 1;
+        }
+        nodes[tasks[task]] = subtrees[task][0];
+        nodes.insert(nodes.end(), subtrees[task].begin() + 1, subtrees[task].end());
+        isTask[tasks[task]] = true;
+    }
+
+    // Nodes above the split were created before their subtrees existed, so
+    // aggregate them now. Children always come after their parent, so a reverse
+    // pass sees every child before its parent.
+    for (uint32_t index = topCount; index-- > 0;) {
+        if (!isTask[index] && !nodes[index].isLeaf())
+            aggregate(nodes, index);
+    }
+}
+
+void FlatOctree::aggregate(vector<FlatOctreeNode>& nodes, uint32_t index) const {
+    FlatOctreeNode& node = nodes[index];
+    // summed in double precision, as mass times position overflows single
+    // precision for astronomical systems
+    double mass = 0;
+    Vec3T<double> weighted{0, 0, 0};
+    if (node.isLeaf()) {
+        for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+            const uint32_t body = order[i];
+            mass += masses[body];
+            weighted += Vec3T<double>{xs[body], ys[body], zs[body]} * masses[body];
+        }
+    } else {
+        const uint32_t childEnd = node.firstChild + popcount(node.childMask);
+        for (uint32_t child = node.firstChild; child < childEnd; child++) {
+            mass += nodes[child].mass;
+            weighted += nodes[child].centerOfMass.to<double>() * nodes[child].mass;
+        }
+    }
+    node.mass = Real(mass);
+    node.centerOfMass = (mass != 0) ? (weighted * (1 / mass)).to<Real>() : node.center;
+}
+
+void FlatOctree::buildNode(
+    vector<FlatOctreeNode>& nodes, uint32_t index, size_t depth, size_t stopDepth, vector<uint32_t>* pending
+) {
+    const uint32_t begin = nodes[index].firstBody;
+    const uint32_t end = begin + nodes[index].bodyCount;
+    const Vec3 center = nodes[index].center;
+    const double width = nodes[index].width;
+
+    if (end - begin <= leafSize || depth >= MAX_DEPTH) {
+        aggregate(nodes, index);
+        return;
+    }
+    if (pending && depth >= stopDepth) {
+        // leave this subtree to be built later
+        pending->push_back(index);
+        return;
+    }
+
+    // partition bodies of this node into octants. Octant numbering matches
+    // OctreeNode: bit 2 is set below center in x, bit 1 in y and bit 0 in z.
+    uint32_t counts[8] = {0};
+    for (uint32_t i = begin; i < end; i++) {
+        const uint32_t body = order[i];
+        int oct = ((xs[body] < center.x) << 2) | ((ys[body] < center.y) << 1) | (zs[body] < center.z);
+        counts[oct]++;
+    }
+    uint32_t offsets[8];
+    uint32_t running = begin;
+    for (size_t oct = 0; oct < 8; oct++) {
+        offsets[oct] = running;
+        running += counts[oct];
+    }
+    for (uint32_t i = begin; i < end; i++) {
+        const uint32_t body = order[i];
+        int oct = ((xs[body] < center.x) << 2) | ((ys[body] < center.y) << 1) | (zs[body] < center.z);
+        scratch[offsets[oct]++] = body;
+    }
+    copy(scratch.begin() + begin, scratch.begin() + end, order.begin() + begin);
+
+    // allocate all children contiguously, then recurse into each one
+    const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+    uint8_t childMask = 0;
+    uint32_t firstBody = begin;
+    for (size_t oct = 0; oct < 8; oct++) {
+        if (counts[oct] == 0)
+            continue;
+        childMask |= uint8_t(1 << oct);
+        Real quarter = width / 4;
+        FlatOctreeNode child{};
+        Vec3 offset{(oct & 4) ? -quarter : quarter, (oct & 2) ? -quarter : quarter, (oct & 1) ? -quarter : quarter};
+        child.center = center + offset;
+        child.width = width / 2;
+        child.firstBody = firstBody;
+        child.bodyCount = counts[oct];
+        child.depth = static_cast<uint8_t>(depth + 1);
+        firstBody += counts[oct];
+        nodes.push_back(child);
+    }
+    nodes[index].firstChild = firstChild;
+    nodes[index].childMask = childMask;
+    const uint32_t childEnd = static_cast<uint32_t>(nodes.size());
+    for (uint32_t child = firstChild; child < childEnd; child++) {
+        buildNode(nodes, child, depth + 1, stopDepth, pending);
+    }
+    // while splitting, children may not be built yet
+    if (!pending)
+        aggregate(nodes, index);
+}
+
+void FlatOctree::link() {
+    nodes[0].skip = static_cast<uint32_t>(nodes.size());
+    // parents always come before their children, so every node is linked
+    // before its children need its skip
+    for (FlatOctreeNode& node : nodes) {
+        if (node.isLeaf())
+            continue;
+        // each child continues with its next sibling, the last with whatever
+        // follows the parent
+        const uint32_t childEnd = node.firstChild + popcount(node.childMask);
+        for (uint32_t child = node.firstChild; child + 1 < childEnd; child++) {
+            nodes[child].skip = child + 1;
+        }
+        nodes[childEnd - 1].skip = node.skip;
+    }
+}
+
+size_t FlatOctree::refit(const Body* bodies, size_t count) {
+    if (count != order.size())
+        throw runtime_error("Error: Cannot refit a tree to a different number of bodies.");
+    gather(bodies, count);
+    return refit();
+}
+
+size_t FlatOctree::refit(const BodyArrays& arrays) {
+    if (arrays.size() != order.size())
+        throw runtime_error("Error: Cannot refit a tree to a different number of bodies.");
+    xs = arrays.x.data();
+    ys = arrays.y.data();
+    zs = arrays.z.data();
+    masses = arrays.mass.data();
+    return refit();
+}
+
+size_t FlatOctree::refit() {
+    size_t escaped = 0;
+    // children always come after their parent, so a reverse pass sees every
+    // child before its parent
+    for (uint32_t index = static_cast<uint32_t>(nodes.size()); index-- > 0;) {
+        FlatOctreeNode& node = nodes[index];
+        aggregate(nodes, index);
+        // a node never shrinks below its cell, which is what it was built with
+        double half = ldexp(rootWidth, -node.depth) / 2;
+        const double cellHalf = half;
+        if (node.isLeaf()) {
+            for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+                const uint32_t body = order[i];
+                const Vec3 offset = Vec3{xs[body], ys[body], zs[body]} - node.center;
+                double reach = max(abs(offset.x), max(abs(offset.y), abs(offset.z)));
+                if (reach > cellHalf)
+                    escaped++;
+                half = max(half, reach);
+            }
+        } else {
+            const uint32_t childEnd = node.firstChild + popcount(node.childMask);
+            for (uint32_t child = node.firstChild; child < childEnd; child++) {
+                const Vec3 offset = nodes[child].center - node.center;
+                double reach = max(abs(offset.x), max(abs(offset.y), abs(offset.z))) + nodes[child].width / 2;
+                half = max(half, reach);
+            }
+        }
+        node.width = 2 * half;
+    }
+    if (quadrupolesEnabled)
+        computeQuadrupoles();
+    return escaped;
+}
+
+void FlatOctree::computeQuadrupoles() {
+    quadrupoles.assign(nodes.size(), Quadrupole{});
+    // children always come after their parent, so a reverse pass sees every
+    // child before its parent
+    for (uint32_t index = static_cast<uint32_t>(nodes.size()); index-- > 0;) {
+        const FlatOctreeNode& node = nodes[index];
+        Quadrupole& moment = quadrupoles[index];
+        if (node.isLeaf()) {
+            for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+                const uint32_t body = order[i];
+                moment.addPoint(masses[body], (Vec3{xs[body], ys[body], zs[body]} - node.centerOfMass).to<double>());
+            }
+        } else {
+            // parallel axis theorem: each child adds its own moment plus that
+            // of its mass placed at its center of mass
+            const uint32_t childEnd = node.firstChild + popcount(node.childMask);
+            for (uint32_t child = node.firstChild; child < childEnd; child++) {
+                moment.add(quadrupoles[child]);
+                moment.addPoint(nodes[child].mass, (nodes[child].centerOfMass - node.centerOfMass).to<double>());
+            }
+        }
+    }
+}
+
+void FlatOctree::setQuadrupoles(bool enabled) {
+    quadrupolesEnabled = enabled;
+    if (!enabled)
+        quadrupoles.clear();
+}
+
+bool FlatOctree::hasQuadrupoles() const { return quadrupolesEnabled; }
+
+void FlatOctree::setLeafSize(size_t size) {
+    if (size == 0)
+        throw runtime_error("Error: Leaves must be able to hold at least one body.");
+    leafSize = size;
+}
+
+size_t FlatOctree::getLeafSize() const { return leafSize; }
+
+void FlatOctree::clear() {
+    nodes.clear();
+    order.clear();
+    quadrupoles.clear();
+}
+
+bool FlatOctree::empty() const { return nodes.empty(); }
+
+size_t FlatOctree::size() const { return nodes.size(); }
@@ -0,0 +1,128 @@
+#pragma once
+#ifndef FLAT_OCTREE_H
+#define FLAT_OCTREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "nbsim/core/gravity/quadrupole.hpp"
+#include "nbsim/core/octree/body.hpp"
+#include "nbsim/core/octree/body_arrays.hpp"
+#include "nbsim/core/octree/flat_octree_node.hpp"
+#include "nbsim/core/parallel/thread_pool.hpp"
+
+/**
+ * An octree stored as a single contiguous array of nodes. The tree does not own
+ * any bodies: it is built over an external body buffer and refers to bodies by
+ * their index in that buffer.
+ *
+ * Every node covers a contiguous range of the body order array, so the bodies
+ * below any node can be enumerated without walking its subtree. The root is
+ * always stored at index 0.
+ */
+class FlatOctree {
+  private:
+    // Node storage. Children are always stored after their parent.
+    std::vector<FlatOctreeNode> nodes;
+    // Indices of bodies in the source buffer, grouped so that the bodies of
+    // every node are contiguous.
+    std::vector<uint32_t> order;
+    // Scratch buffer used while partitioning bodies into octants
+    std::vector<uint32_t> scratch;
+    // Maximum number of bodies in a leaf. Nodes holding more are subdivided.
+    size_t leafSize = 1;
+    // Width of the root cell when the tree was built
+    Real rootWidth = 0;
+    // Quadrupole moment of every node about its center of mass, parallel to
+    // nodes. Empty unless quadrupoles are enabled.
+    std::vector<Quadrupole> quadrupoles;
+    // Set if quadrupole moments are computed
+    bool quadrupolesEnabled = false;
+    // Positions and masses of the bodies the tree is being built over. Only
+    // valid during a build.
+    const Real* xs = nullptr;
+    const Real* ys = nullptr;
+    const Real* zs = nullptr;
+    const Real* masses = nullptr;
+    // Positions and masses gathered from Body objects, so that builds over
+    // either storage read the same compact arrays
+    std::vector<Real> gathered[4];
+    // Builds the tree over the bodies currently pointed to by xs, ys, zs and
+    // masses
+    void build(size_t count, Real width, ThreadPool* pool);
+    // Builds the nodes of a tree over count bodies, leaving out derived data
+    void buildNodes(size_t count, Real width, ThreadPool* pool);
+    // Refits the tree to the bodies currently pointed to by xs, ys, zs and
+    // masses, returning the number of bodies outside their leaf's cell
+    size_t refit();
+    // Sets the skip link of every node
+    void link();
+    // Points xs, ys, zs and masses at positions and masses gathered from bodies
+    void gather(const Body* bodies, size_t count);
+    // Computes the quadrupole moments of all nodes from their bodies and
+    // centers of mass
+    void computeQuadrupoles();
+    // Recursively builds the subtree rooted at the node with the given index of
+    // nodes. If pending is given, nodes at stopDepth are not expanded but
+    // appended to pending instead, and internal nodes are not aggregated.
+    void buildNode(
+        std::vector<FlatOctreeNode>& nodes, uint32_t index, size_t depth, size_t stopDepth,
+        std::vector<uint32_t>* pending
+    );
+    // Computes mass and center of mass of a node from its bodies if it is a
+    // leaf, or from its children otherwise
+    void aggregate(std::vector<FlatOctreeNode>& nodes, uint32_t index) const;
+
+  public:
+    // Maximum depth of the tree. Nodes at this depth become leaves regardless
+    // of how many bodies they hold or the leaf size, which bounds the tree for coincident bodies.
+    static constexpr size_t MAX_DEPTH = 64;
+    // Minimum number of bodies for which building subtrees concurrently pays
+    // off
+    static constexpr size_t PARALLEL_THRESHOLD = 4096;
+    // Builds the tree over count bodies, inside a cube of the given width
+    // centered at the origin. Any previous tree is discarded. If a thread pool
+    // is given, subtrees are built concurrently on it. Only the order of
+    // nodes in the node array depends on the number of threads, not their
+    // contents.
+    void build(const Body* bodies, size_t count, Real width, ThreadPool* pool = nullptr);
+    // Builds the tree over all bodies stored in arrays, as above
+    void build(const BodyArrays& arrays, Real width, ThreadPool* pool = nullptr);
+    // Updates the tree after the bodies it was built over moved, without
+    // changing its structure. Masses and centers of mass are recomputed bottom
+    // up, and the width of every node is grown as needed to enclose all of its
+    // bodies and children, so the opening criterion stays conservative. bodies
+    // must be in the same order as in the last build. Returns the number of
+    // bodies that left the cell of their leaf; as it grows, nodes overlap more
+    // and the tree should be rebuilt.
+    size_t refit(const Body* bodies, size_t count);
+    // Refits the tree to the bodies stored in arrays, as above
+    size_t refit(const BodyArrays& arrays);
+    // Sets the maximum number of bodies in a leaf for subsequent builds. Larger
+    // leaves give a shallower tree with fewer nodes, at the cost of more
+    // direct interactions per leaf. Throws std::runtime_error if zero.
+    void setLeafSize(size_t size);
+    // Returns the maximum number of bodies in a leaf
+    size_t getLeafSize() const;
+    // Enables or disables computing quadrupole moments of every node in
+    // subsequent builds and refits
+    void setQuadrupoles(bool enabled);
+    // Returns if nodes carry quadrupole moments
+    bool hasQuadrupoles() const;
+    // Returns the quadrupole moment of the node at the given index. Only
+    // available if quadrupoles are enabled.
+    const Quadrupole& quadrupole(uint32_t index) const { return quadrupoles[index]; }
+    // Discards all nodes
+    void clear();
+    // Returns if the tree has no nodes
+    bool empty() const;
+    // Returns number of nodes in the tree
+    size_t size() const;
+    // Returns read-only access to the node at the given index
+    const FlatOctreeNode& operator[](uint32_t index) const { return nodes[index]; }
+    // Returns the index of the body stored at the given offset of the body
+    // order array
+    uint32_t bodyAt(uint32_t offset) const { return order[offset]; }
+};
+
+#endif
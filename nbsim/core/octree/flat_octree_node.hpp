@@ -0,0 +1,38 @@
+#pragma once
+#ifndef FLAT_OCTREE_NODE_H
+#define FLAT_OCTREE_NODE_H
+
+#include <cstdint>
+
+#include "nbsim/core/vec3/vec3.hpp"
+
+/**
+ * Node in a FlatOctree. Nodes refer to each other through indices into the
+ * owning node array instead of pointers, and carry their aggregate mass and
+ * center of mass inline so a tree walk never leaves the node array.
+ *
+ * Children of a node are stored contiguously, in octant order, starting at
+ * firstChild. Only octants that contain bodies get a child, and childMask
+ * records which octants those are.
+ *
+ * Nodes are also threaded for a stackless depth-first walk: opening a node
+ * moves on to firstChild, and passing over a node, or finishing a leaf, jumps
+ * to skip.
+ */
+struct FlatOctreeNode {
+    Vec3 centerOfMass;   // Center of mass of all bodies below this node
+    Real mass;           // Total mass of all bodies below this node
+    Vec3 center;         // Center of the bounding box of this node
+    Real width;          // Width of the bounding box of this node, grown by refits
+    uint32_t firstChild; // Index of the first child node. Unused for leaves
+    uint32_t skip;       // Index of the node after this subtree in a depth-first walk, or the node count
+    uint32_t firstBody;  // Offset of this node's bodies in the body order array
+    uint32_t bodyCount;  // Number of bodies below this node
+    uint8_t childMask;   // Bit i is set if a child exists in octant i
+    uint8_t depth;       // Depth of this node, zero for the root
+
+    // Returns true if this node has no children
+    bool isLeaf() const { return childMask == 0; }
+};
+
+#endif
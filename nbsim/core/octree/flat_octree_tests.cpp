@@ -0,0 +1,257 @@
+#include "nbsim/core/octree/flat_octree.hpp"
+#include <bit>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+class TestFlatOctree : public ::testing::Test {
+  protected:
+    TestFlatOctree() = default;
+    // Relative error allowed where aggregates are summed in a different
+    // order, which depends on the precision of positions
+    static constexpr double TOLERANCE = is_same_v<Real, float> ? 1e-6 : 1e-9;
+};
+
+TEST_F(TestFlatOctree, EmptyBuildHasNoNodes) {
+    FlatOctree tree;
+    tree.build(nullptr, 0, 1000);
+    EXPECT_TRUE(tree.empty());
+    EXPECT_EQ(tree.size(), 0);
+}
+
+TEST_F(TestFlatOctree, SingleBodyIsRootLeaf) {
+    vector<Body> bodies({Body(10, Vec3{1, 0, 0}, Vec3{0, 0, 0}, Vec3{0, 0, 0})});
+    FlatOctree tree;
+    tree.build(bodies.data(), bodies.size(), 1000);
+    EXPECT_EQ(tree.size(), 1);
+    EXPECT_TRUE(tree[0].isLeaf());
+    EXPECT_EQ(tree[0].mass, 10);
+    EXPECT_EQ(tree[0].centerOfMass, bodies[0].position);
+    EXPECT_EQ(tree.bodyAt(tree[0].firstBody), 0);
+}
+
+TEST_F(TestFlatOctree, RootAggregatesMassAndCenterOfMass) {
+    vector<Body> bodies(
+        {Body(10, Vec3{1, 0, 0}, Vec3{0, 0, 0}, Vec3{0, 0, 0}),
+         Body(30, Vec3{-1, -1, -1}, Vec3{0, 0, 0}, Vec3{0, 0, 0})}
+    );
+    FlatOctree tree;
+    tree.build(bodies.data(), bodies.size(), 1000);
+    EXPECT_DOUBLE_EQ(tree[0].mass, 40);
+    EXPECT_DOUBLE_EQ(tree[0].centerOfMass.x, -0.5);
+    EXPECT_DOUBLE_EQ(tree[0].centerOfMass.y, -0.75);
+    EXPECT_DOUBLE_EQ(tree[0].centerOfMass.z, -0.75);
+}
+
+TEST_F(TestFlatOctree, ChildrenAreStoredInOctantOrder) {
+    vector<Body> bodies(
+        {Body(10, Vec3{1, 0, 0}, Vec3{0, 0, 0}, Vec3{0, 0, 0}),
+         Body(10, Vec3{-1, -1, -1}, Vec3{0, 0, 0}, Vec3{0, 0, 0}),
+         Body(1, Vec3{1, -1, 1}, Vec3{0, 0, 0}, Vec3{0, 0, 0})}
+    );
+    FlatOctree tree;
+    tree.build(bodies.data(), bodies.size(), 1000);
+    const FlatOctreeNode& root = tree[0];
+    // same octants as OctreeNode: first, third and eighth
+    EXPECT_EQ(root.childMask, (1 << 0) | (1 << 2) | (1 << 7));
+    EXPECT_EQ(tree.bodyAt(tree[root.firstChild].firstBody), 0);
+    EXPECT_EQ(tree.bodyAt(tree[root.firstChild + 1].firstBody), 2);
+    EXPECT_EQ(tree.bodyAt(tree[root.firstChild + 2].firstBody), 1);
+}
+
+TEST_F(TestFlatOctree, NodesCoverContiguousBodyRanges) {
+    vector<Body> bodies;
+    for (int i = 0; i < 50; i++) {
+        bodies.push_back(Body(1, Vec3{Real(i % 7) - 3, Real(i % 5) - 2, Real(i) - 25}, Vec3{}, Vec3{}));
+    }
+    FlatOctree tree;
+    tree.build(bodies.data(), bodies.size(), 150);
+    size_t leaves = 0;
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        const FlatOctreeNode& node = tree[i];
+        if (node.isLeaf()) {
+            EXPECT_EQ(node.bodyCount, 1);
+            leaves++;
+            continue;
+        }
+        // children partition the range of their parent
+        uint32_t expected = node.firstBody;
+        for (int c = 0; c < popcount(node.childMask); c++) {
+            const FlatOctreeNode& child = tree[node.firstChild + c];
+            EXPECT_GT(node.firstChild + c, i);
+            EXPECT_EQ(child.firstBody, expected);
+            expected += child.bodyCount;
+        }
+        EXPECT_EQ(expected, node.firstBody + node.bodyCount);
+    }
+    EXPECT_EQ(leaves, bodies.size());
+}
+
+// Checks that the subtrees below two nodes are identical, regardless of where
+// their nodes are stored
+static void expectSameSubtree(const FlatOctree& a, uint32_t i, const FlatOctree& b, uint32_t j) {
+    ASSERT_EQ(a[i].childMask, b[j].childMask);
+    EXPECT_EQ(a[i].mass, b[j].mass);
+    EXPECT_EQ(a[i].centerOfMass, b[j].centerOfMass);
+    EXPECT_EQ(a[i].width, b[j].width);
+    ASSERT_EQ(a[i].bodyCount, b[j].bodyCount);
+    if (a[i].isLeaf()) {
+        for (uint32_t k = 0; k < a[i].bodyCount; k++) {
+            EXPECT_EQ(a.bodyAt(a[i].firstBody + k), b.bodyAt(b[j].firstBody + k));
+        }
+        return;
+    }
+    for (int c = 0; c < popcount(a[i].childMask); c++) {
+        expectSameSubtree(a, a[i].firstChild + c, b, b[j].firstChild + c);
+    }
+}
+
+TEST_F(TestFlatOctree, ParallelBuildMatchesSerialBuild) {
+    mt19937 twister(7);
+    uniform_real_distribution<Real> positionGen(-1e6, 1e6);
+    uniform_real_distribution<Real> massGen(1, 1e10);
+    vector<Body> bodies;
+    for (size_t i = 0; i < 3 * FlatOctree::PARALLEL_THRESHOLD; i++) {
+        Vec3 position{positionGen(twister), positionGen(twister), positionGen(twister)};
+        bodies.push_back(Body(massGen(twister), position, Vec3{}, Vec3{}));
+    }
+    FlatOctree serial;
+    serial.build(bodies.data(), bodies.size(), 3e6);
+    ThreadPool pool(4);
+    FlatOctree parallel;
+    parallel.build(bodies.data(), bodies.size(), 3e6, &pool);
+    EXPECT_EQ(serial.size(), parallel.size());
+    expectSameSubtree(serial, 0, parallel, 0);
+}
+
+TEST_F(TestFlatOctree, LeavesHoldUpToLeafSizeBodies) {
+    mt19937 gen(7);
+    uniform_real_distribution<Real> coord(-100, 100);
+    vector<Body> bodies;
+    for (int i = 0; i < 2000; i++) {
+        bodies.push_back(Body(1, Vec3{coord(gen), coord(gen), coord(gen)}, Vec3{}, Vec3{}));
+    }
+    FlatOctree single;
+    single.build(bodies.data(), bodies.size(), 300);
+    FlatOctree bucketed;
+    EXPECT_THROW(bucketed.setLeafSize(0), std::runtime_error);
+    bucketed.setLeafSize(16);
+    bucketed.build(bodies.data(), bodies.size(), 300);
+    EXPECT_LT(bucketed.size(), single.size() / 4);
+    EXPECT_DOUBLE_EQ(bucketed[0].mass, single[0].mass);
+    size_t bodiesInLeaves = 0;
+    for (uint32_t i = 0; i < bucketed.size(); i++) {
+        if (bucketed[i].isLeaf()) {
+            EXPECT_LE(bucketed[i].bodyCount, 16);
+            bodiesInLeaves += bucketed[i].bodyCount;
+        } else {
+            EXPECT_GT(bucketed[i].bodyCount, 16);
+        }
+    }
+    EXPECT_EQ(bodiesInLeaves, bodies.size());
+}
+
+TEST_F(TestFlatOctree, SkipLinksWalkTreeDepthFirst) {
+    mt19937 twister(11);
+    uniform_real_distribution<Real> positionGen(-1e6, 1e6);
+    vector<Body> bodies;
+    for (size_t i = 0; i < 2 * FlatOctree::PARALLEL_THRESHOLD; i++) {
+        Vec3 position{positionGen(twister), positionGen(twister), positionGen(twister)};
+        bodies.push_back(Body(1, position, Vec3{}, Vec3{}));
+    }
+    ThreadPool pool(4);
+    FlatOctree tree;
+    tree.setLeafSize(4);
+    tree.build(bodies.data(), bodies.size(), 3e6, &pool);
+    const uint32_t end = static_cast<uint32_t>(tree.size());
+    EXPECT_EQ(tree[0].skip, end);
+    // opening every node visits each node once, and leaves in body order
+    vector<int> visits(tree.size(), 0);
+    uint32_t nextBody = 0;
+    for (uint32_t index = 0; index != end;) {
+        ASSERT_LT(index, end);
+        visits[index]++;
+        const FlatOctreeNode& node = tree[index];
+        if (!node.isLeaf()) {
+            index = node.firstChild;
+            continue;
+        }
+        EXPECT_EQ(node.firstBody, nextBody);
+        nextBody += node.bodyCount;
+        index = node.skip;
+    }
+    EXPECT_EQ(nextBody, bodies.size());
+    EXPECT_EQ(vector<int>(tree.size(), 1), visits);
+    // skipping a node passes over exactly the bodies below it
+    for (uint32_t index = 1; index < end; index++) {
+        const FlatOctreeNode& node = tree[index];
+        if (node.skip != end) {
+            EXPECT_EQ(tree[node.skip].firstBody, node.firstBody + node.bodyCount);
+        }
+    }
+}
+
+TEST_F(TestFlatOctree, RefitTracksMovedBodies) {
+    mt19937 gen(11);
+    uniform_real_distribution<Real> coord(-100, 100);
+    uniform_real_distribution<Real> nudge(-1, 1);
+    vector<Body> bodies;
+    for (int i = 0; i < 500; i++) {
+        bodies.push_back(Body(1 + i % 3, Vec3{coord(gen), coord(gen), coord(gen)}, Vec3{}, Vec3{}));
+    }
+    FlatOctree tree;
+    tree.setLeafSize(4);
+    tree.build(bodies.data(), bodies.size(), 300);
+    const size_t nodeCount = tree.size();
+    EXPECT_EQ(tree.refit(bodies.data(), bodies.size()), 0);
+    for (Body& body : bodies) {
+        body.position += Vec3{nudge(gen), nudge(gen), nudge(gen)};
+    }
+    size_t escaped = tree.refit(bodies.data(), bodies.size());
+    EXPECT_GT(escaped, 0);
+    EXPECT_LT(escaped, bodies.size() / 2);
+    EXPECT_EQ(tree.size(), nodeCount);
+    // aggregates match a fresh build, and every node encloses its bodies
+    FlatOctree rebuilt;
+    rebuilt.build(bodies.data(), bodies.size(), 300);
+    EXPECT_DOUBLE_EQ(tree[0].mass, rebuilt[0].mass);
+    EXPECT_NEAR(tree[0].centerOfMass.x, rebuilt[0].centerOfMass.x, TOLERANCE);
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        const FlatOctreeNode& node = tree[i];
+        for (uint32_t j = node.firstBody; j < node.firstBody + node.bodyCount; j++) {
+            const Vec3 offset = bodies[tree.bodyAt(j)].position - node.center;
+            // allow for rounding of the offset to the precision of positions
+            const double half = node.width / 2 * (1 + numeric_limits<Real>::epsilon());
+            EXPECT_LE(max(abs(offset.x), max(abs(offset.y), abs(offset.z))), half);
+        }
+    }
+    EXPECT_THROW(tree.refit(bodies.data(), bodies.size() - 1), std::runtime_error);
+}
+
+TEST_F(TestFlatOctree, QuadrupolesMatchDirectSum) {
+    mt19937 gen(17);
+    uniform_real_distribution<Real> coord(-100, 100);
+    vector<Body> bodies;
+    for (int i = 0; i < 300; i++) {
+        bodies.push_back(Body(1 + i % 5, Vec3{coord(gen), coord(gen), coord(gen)}, Vec3{}, Vec3{}));
+    }
+    FlatOctree tree;
+    tree.setQuadrupoles(true);
+    tree.setLeafSize(4);
+    tree.build(bodies.data(), bodies.size(), 300);
+    EXPECT_TRUE(tree.hasQuadrupoles());
+    Quadrupole expected{};
+    for (const Body& body : bodies) {
+        expected.addPoint(body.mass, (body.position - tree[0].centerOfMass).to<double>());
+    }
+    const Quadrupole& root = tree.quadrupole(0);
+    double scale = abs(expected.xx) + abs(expected.yy) + abs(expected.zz);
+    EXPECT_NEAR(root.xx, expected.xx, TOLERANCE * scale);
+    EXPECT_NEAR(root.xy, expected.xy, TOLERANCE * scale);
+    EXPECT_NEAR(root.yz, expected.yz, TOLERANCE * scale);
+    EXPECT_NEAR(root.xx + root.yy + root.zz, 0, TOLERANCE * scale);
+}
@@ -0,0 +1,65 @@
+#include "nbsim/core/octree/morton.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+// Spreads the lower 21 bits of value so that there are two zero bits between
+// each of them
+static uint64_t spreadBits(uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffff;
+    value = (value | value << 16) & 0x1f0000ff0000ff;
+    value = (value | value << 8) & 0x100f00f00f00f00f;
+    value = (value | value << 4) & 0x10c30c30c30c30c3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+}
+
+// Quantizes a coordinate in [-width / 2, width / 2] to MORTON_BITS bits
+static uint64_t quantize(double coord, double width) {
+    const double cells = double(1 << MORTON_BITS);
+    double scaled = (coord / width + 0.5) * cells;
+    scaled = clamp(scaled, 0.0, cells - 1);
+    return static_cast<uint64_t>(scaled);
+}
+
+uint64_t mortonKey(const Vec3& position, double width) {
+    if (width <= 0)
+        return 0;
+    return (spreadBits(quantize(position.x, width)) << 2) | (spreadBits(quantize(position.y, width)) << 1) |
+           spreadBits(quantize(position.z, width));
+}
+
+void radixSort(
+    vector<uint64_t>& keys, vector<uint32_t>& values, vector<uint64_t>& keyScratch, vector<uint32_t>& valueScratch
+) {
+    const size_t n = keys.size();
+    if (n == 0)
+        return;
+    keyScratch.resize(n);
+    valueScratch.resize(n);
+    // keys only use the lower 3 * MORTON_BITS bits, sorted one byte at a time
+    for (int shift = 0; shift < 3 * MORTON_BITS; shift += 8) {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < n; i++) {
+            counts[(keys[i] >> shift) & 0xff]++;
+        }
+        // all keys share this digit, so the pass would not move anything
+        if (counts[(keys[0] >> shift) & 0xff] == n)
+            continue;
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t dest = counts[(keys[i] >> shift) & 0xff]++;
+            keyScratch[dest] = keys[i];
+            valueScratch[dest] = values[i];
+        }
+        swap(keys, keyScratch);
+        swap(values, valueScratch);
+    }
+}
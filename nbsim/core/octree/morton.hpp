@@ -0,0 +1,26 @@
+#pragma once
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <cstdint>
+#include <vector>
+
+#include "nbsim/core/vec3/vec3.hpp"
+
+// Number of bits used per axis in a Morton key
+constexpr int MORTON_BITS = 21;
+
+// Returns the Morton (Z-order) key of a position inside a cube of the given
+// width centered at the origin. Positions outside the cube are clamped to its
+// faces. Sorting by key groups spatially close positions together.
+uint64_t mortonKey(const Vec3& position, double width);
+
+// Sorts keys in ascending order with an LSD radix sort, applying the same
+// permutation to values. The sort is stable. scratch buffers are resized as
+// needed and may be reused between calls to avoid allocations.
+void radixSort(
+    std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& keyScratch,
+    std::vector<uint32_t>& valueScratch
+);
+
+#endif
@@ -0,0 +1,51 @@
+#include "nbsim/core/octree/morton.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+class TestMorton : public ::testing::Test {
+  protected:
+    TestMorton() = default;
+};
+
+TEST_F(TestMorton, CornersMapToExtremeKeys) {
+    EXPECT_EQ(mortonKey(Vec3{-50, -50, -50}, 100), 0);
+    EXPECT_EQ(mortonKey(Vec3{50, 50, 50}, 100), (uint64_t(1) << (3 * MORTON_BITS)) - 1);
+}
+
+TEST_F(TestMorton, OutOfBoundsPositionsAreClamped) {
+    EXPECT_EQ(mortonKey(Vec3{-500, -500, -500}, 100), mortonKey(Vec3{-50, -50, -50}, 100));
+    EXPECT_EQ(mortonKey(Vec3{500, 500, 500}, 100), mortonKey(Vec3{50, 50, 50}, 100));
+}
+
+TEST_F(TestMorton, KeysFollowOctantsAtTopLevel) {
+    // the three most significant bits of the key are the x, y and z halves
+    uint64_t key = mortonKey(Vec3{10, -10, 10}, 100);
+    EXPECT_EQ(key >> (3 * MORTON_BITS - 3), 0b101);
+}
+
+TEST_F(TestMorton, RadixSortMatchesStableSort) {
+    mt19937 twister(42);
+    uniform_int_distribution<uint64_t> keyGen(0, (uint64_t(1) << (3 * MORTON_BITS)) - 1);
+    vector<uint64_t> keys(1000);
+    vector<uint32_t> values(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i] = keyGen(twister) & ~uint64_t(0xff00); // force a few duplicate digits
+        values[i] = uint32_t(i);
+    }
+    vector<pair<uint64_t, uint32_t>> expected;
+    for (size_t i = 0; i < keys.size(); i++) {
+        expected.push_back({keys[i], values[i]});
+    }
+    stable_sort(expected.begin(), expected.end(), [](auto& a, auto& b) { return a.first < b.first; });
+    vector<uint64_t> keyScratch;
+    vector<uint32_t> valueScratch;
+    radixSort(keys, values, keyScratch, valueScratch);
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(keys[i], expected[i].first);
+        EXPECT_EQ(values[i], expected[i].second);
+    }
+}
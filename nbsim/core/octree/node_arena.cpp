@@ -0,0 +1,16 @@
+#include "nbsim/core/octree/node_arena.hpp"
+
+using namespace std;
+
+OctreeNode* NodeArena::createNode(Real width, const Vec3& center) { return nodes.create(width, center, this); }
+
+Object* NodeArena::createObject() { return objects.create(); }
+
+void NodeArena::reset() {
+    nodes.reset();
+    objects.reset();
+}
+
+size_t NodeArena::nodeCount() const { return nodes.size(); }
+
+size_t NodeArena::objectCount() const { return objects.size(); }
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "nbsim/core/octree/object.hpp"
+#include "nbsim/core/octree/octree_node.hpp"
+
+/**
+ * Hands out objects of type T from large blocks of storage. Objects are never
+ * freed individually: reset() makes all storage available again in constant
+ * time without running destructors, so T must not own anything outside the
+ * pool. Blocks are kept between resets, so a pool that has reached its peak
+ * size stops allocating.
+ */
+template <typename T> class BlockPool {
+  private:
+    // Uninitialised storage for a single T
+    struct Slot {
+        alignas(T) std::byte bytes[sizeof(T)];
+    };
+    // Blocks of BLOCK_SIZE slots each
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    // Index of the block currently handed out from
+    size_t block = 0;
+    // Number of slots used in the current block
+    size_t used = 0;
+
+  public:
+    // Number of objects per block
+    static constexpr size_t BLOCK_SIZE = 1024;
+    // Constructs a T in the next free slot, allocating a new block if all
+    // blocks are used
+    template <typename... Args> T* create(Args&&... args) {
+        if (used == BLOCK_SIZE || blocks.empty()) {
+            if (!blocks.empty())
+                block++;
+            used = 0;
+            if (block == blocks.size())
+                blocks.emplace_back(new Slot[BLOCK_SIZE]);
+        }
+        return ::new (blocks[block][used++].bytes) T(std::forward<Args>(args)...);
+    }
+    // Makes all slots available again. Objects handed out before are invalid
+    // afterwards.
+    void reset() {
+        block = 0;
+        used = 0;
+    }
+    // Returns the number of objects handed out since the last reset
+    size_t size() const { return blocks.empty() ? 0 : block * BLOCK_SIZE + used; }
+    // Returns the number of blocks allocated
+    size_t capacity() const { return blocks.size(); }
+};
+
+/**
+ * Storage for the nodes of a pointer octree and the center of mass objects of
+ * its internal nodes. Nodes created through an arena allocate their children
+ * from the same arena, and the whole tree is released at once by reset().
+ */
+class NodeArena {
+  private:
+    // Storage for tree nodes
+    BlockPool<OctreeNode> nodes;
+    // Storage for center of mass objects of internal nodes
+    BlockPool<Object> objects;
+
+  public:
+    // Creates a node of the given region which allocates from this arena
+    OctreeNode* createNode(Real width, const Vec3& center);
+    // Creates an empty object
+    Object* createObject();
+    // Releases every node and object created since the last reset
+    void reset();
+    // Returns the number of nodes created since the last reset
+    size_t nodeCount() const;
+    // Returns the number of objects created since the last reset
+    size_t objectCount() const;
+    NodeArena() = default;
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "nbsim/core/octree/node_arena.hpp"
+#include <gtest/gtest.h>
+
+#include "nbsim/core/octree/octree.hpp"
+
+class TestNodeArena : public ::testing::Test {
+  protected:
+    TestNodeArena() = default;
+};
+
+TEST_F(TestNodeArena, PoolHandsOutDistinctObjectsAcrossBlocks) {
+    BlockPool<Object> pool;
+    std::vector<Object*> objects;
+    for (size_t i = 0; i < 3 * BlockPool<Object>::BLOCK_SIZE; i++) {
+        objects.push_back(pool.create(Real(i), Vec3{Real(i), 0, 0}));
+    }
+    EXPECT_EQ(pool.size(), objects.size());
+    EXPECT_EQ(pool.capacity(), 3);
+    for (size_t i = 0; i < objects.size(); i++) {
+        EXPECT_EQ(objects[i]->mass, Real(i));
+    }
+}
+
+TEST_F(TestNodeArena, ResetReusesBlocks) {
+    BlockPool<Object> pool;
+    Object* first = pool.create();
+    for (size_t i = 0; i < 2 * BlockPool<Object>::BLOCK_SIZE; i++) {
+        pool.create();
+    }
+    size_t capacity = pool.capacity();
+    pool.reset();
+    EXPECT_EQ(pool.size(), 0);
+    EXPECT_EQ(pool.create(), first);
+    EXPECT_EQ(pool.capacity(), capacity);
+}
+
+TEST_F(TestNodeArena, NodesAllocateChildrenFromTheirArena) {
+    NodeArena arena;
+    OctreeNode* root = arena.createNode(1000, Vec3{0, 0, 0});
+    Object obj(10, Vec3{1, 0, 0});
+    Object obj2(10, Vec3{-1, -1, -1});
+    root->insert(&obj);
+    root->insert(&obj2);
+    EXPECT_EQ(root->getArena(), &arena);
+    EXPECT_EQ(root->children[0]->getArena(), &arena);
+    EXPECT_EQ(arena.nodeCount(), 3);
+    EXPECT_EQ(arena.objectCount(), 1);
+    EXPECT_EQ(root->getObject().mass, 20);
+    arena.reset();
+    EXPECT_EQ(arena.nodeCount(), 0);
+}
+
+TEST_F(TestNodeArena, CopiesOfArenaNodesLiveOnTheHeap) {
+    NodeArena arena;
+    OctreeNode* root = arena.createNode(1000, Vec3{0, 0, 0});
+    Object obj(10, Vec3{1, 0, 0});
+    Object obj2(10, Vec3{-1, -1, -1});
+    root->insert(&obj);
+    root->insert(&obj2);
+    OctreeNode copy(*root);
+    arena.reset();
+    EXPECT_EQ(copy.getArena(), nullptr);
+    EXPECT_EQ(copy.children[0]->getArena(), nullptr);
+    EXPECT_EQ(copy.getObject().mass, 20);
+}
+
+TEST_F(TestNodeArena, OctreeRebuildsReuseArena) {
+    std::vector<Body> bodies;
+    for (int i = 0; i < 100; i++) {
+        bodies.push_back(Body(1, Vec3{Real(i % 7), Real(i % 11), Real(i % 13)}, Vec3{}, Vec3{}));
+    }
+    Octree tree(bodies);
+    Octree copy(tree);
+    EXPECT_EQ(copy.root->getArena(), nullptr);
+    for (int i = 0; i < 3; i++) {
+        tree.buildTree();
+        copy.buildTree();
+    }
+    EXPECT_NE(tree.root->getArena(), nullptr);
+    EXPECT_NE(copy.root->getArena(), nullptr);
+    EXPECT_NE(tree.root->getArena(), copy.root->getArena());
+    EXPECT_EQ(tree.root->getObject(), copy.root->getObject());
+}
@@ -1,9 +1,14 @@
 #include "nbsim/core/octree/object.hpp"
 
-Object::Object() : mass{0}, position{Vec3{0, 0, 0}} {}
+template <typename T> ObjectT<T>::ObjectT() : mass{0}, position{Vec3T<T>{0, 0, 0}} {}
 
-Object::Object(double mass, const Vec3& position) : mass{mass}, position{position} {}
+template <typename T> ObjectT<T>::ObjectT(T mass, const Vec3T<T>& position) : mass{mass}, position{position} {}
 
-bool Object::operator==(const Object& other) const { return (other.mass == mass) && (other.position == position); }
+template <typename T> bool ObjectT<T>::operator==(const ObjectT& other) const {
+    return (other.mass == mass) && (other.position == position);
+}
 
-bool Object::operator!=(const Object& other) const { return !(other == *this); }
+template <typename T> bool ObjectT<T>::operator!=(const ObjectT& other) const { return !(other == *this); }
+
+template class ObjectT<float>;
+template class ObjectT<double>;
@@ -7,16 +7,20 @@
 #include "nbsim/core/vec3/vec3.hpp"
 
 /**
- * A simulation object - a body which interacts with others gravitationally
+ * A simulation object - a body which interacts with others gravitationally.
+ * Mass and position are of type T.
  */
-class Object {
+template <typename T> class ObjectT {
   public:
-    double mass;   // Mass of the object
-    Vec3 position; // Position of the object
-    bool operator==(const Object& other) const;
-    bool operator!=(const Object& other) const;
-    Object();
-    Object(double mass, const Vec3& position);
+    T mass;            // Mass of the object
+    Vec3T<T> position; // Position of the object
+    bool operator==(const ObjectT& other) const;
+    bool operator!=(const ObjectT& other) const;
+    ObjectT();
+    ObjectT(T mass, const Vec3T<T>& position);
 };
 
+// Object of the precision chosen at build time
+using Object = ObjectT<Real>;
+
 #endif
\ No newline at end of file
@@ -1,27 +1,68 @@
 #include "nbsim/core/octree/octree.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 #include <stack>
+#include <tuple>
+
+#include "nbsim/core/octree/morton.hpp"
 
 using namespace std;
 
 Octree::~Octree() {
-    delete root;
+    releaseRoot();
     delete[] bodies;
 }
 
-Octree::Octree() : allocSize{8}, size{0}, width{1000}, bodies{new Body[allocSize]}, root{nullptr} {}
+Octree::Octree()
+    : allocSize{8},
+      size{0},
+      width{1000},
+      bodies{new Body[allocSize]},
+      storage{BodyStorage::AOS},
+      layout{OctreeLayout::POINTER},
+      stale{false},
+      mortonOrdering{false},
+      refitThreshold{-1},
+      nodesBuilt{0},
+      pool{nullptr},
+      arena{make_unique<NodeArena>()},
+      root{nullptr} {}
 
-Octree::Octree(double simWidth) : allocSize{8}, size{0}, width{simWidth}, bodies{new Body[allocSize]}, root{nullptr} {}
+Octree::Octree(Real simWidth)
+    : allocSize{8},
+      size{0},
+      width{simWidth},
+      bodies{new Body[allocSize]},
+      storage{BodyStorage::AOS},
+      layout{OctreeLayout::POINTER},
+      stale{false},
+      mortonOrdering{false},
+      refitThreshold{-1},
+      nodesBuilt{0},
+      pool{nullptr},
+      arena{make_unique<NodeArena>()},
+      root{nullptr} {}
 
 Octree::Octree(vector<Body>& inputBodies)
     : allocSize{inputBodies.size()},
       size{0},
       bodies{new Body[allocSize]},
+      storage{BodyStorage::AOS},
+      layout{OctreeLayout::POINTER},
+      stale{false},
+      mortonOrdering{false},
+      refitThreshold{-1},
+      nodesBuilt{0},
+      pool{nullptr},
+      arena{make_unique<NodeArena>()},
       root{nullptr} {
     // find max location of all objects
     size_t index = 0;
     for (Body& body : inputBodies) {
+        ids.push_back(uint32_t(index));
+        slots.push_back(uint32_t(index));
         bodies[index++] = body;
     }
     size = index;
@@ -34,8 +75,25 @@ Octree::Octree(const Octree& other)
       size{other.size},
       width{other.width},
       bodies{new Body[allocSize]},
-      root{nullptr} {
-    root = new OctreeNode(*other.root);
+      arrays{other.arrays},
+      storage{other.storage},
+      layout{other.layout},
+      stale{other.stale},
+      mortonOrdering{other.mortonOrdering},
+      refitThreshold{other.refitThreshold},
+      nodesBuilt{other.nodesBuilt},
+      ids{other.ids},
+      slots{other.slots},
+      pool{other.pool},
+      arena{make_unique<NodeArena>()},
+      root{nullptr},
+      flat{other.flat} {
+    if (other.root)
+        root = new OctreeNode(*other.root);
+    // with SoA storage, bodies live in the arrays and the buffer holds
+    // nothing, nor has it grown with them
+    if (storage != BodyStorage::AOS)
+        return;
     for (Body* ptr = other.bodies; size_t(ptr - other.bodies) < other.size; ++ptr) {
         *(bodies + (ptr - other.bodies)) = *ptr;
     }
@@ -46,7 +104,19 @@ Octree::Octree(Octree&& other)
       size{other.size},
       width{other.width},
       bodies{other.bodies},
-      root{other.root} {
+      arrays{std::move(other.arrays)},
+      storage{other.storage},
+      layout{other.layout},
+      stale{other.stale},
+      mortonOrdering{other.mortonOrdering},
+      refitThreshold{other.refitThreshold},
+      nodesBuilt{other.nodesBuilt},
+      ids{std::move(other.ids)},
+      slots{std::move(other.slots)},
+      pool{other.pool},
+      arena{std::move(other.arena)},
+      root{other.root},
+      flat{std::move(other.flat)} {
     other.root = nullptr;
     other.bodies = nullptr;
 }
@@ -58,14 +128,27 @@ Octree& Octree::operator=(Octree&& other) {
     swap(size, other.size);
     swap(width, other.width);
     swap(bodies, other.bodies);
+    swap(arrays, other.arrays);
+    swap(storage, other.storage);
+    swap(layout, other.layout);
+    swap(stale, other.stale);
+    swap(mortonOrdering, other.mortonOrdering);
+    swap(refitThreshold, other.refitThreshold);
+    swap(nodesBuilt, other.nodesBuilt);
+    swap(ids, other.ids);
+    swap(slots, other.slots);
+    swap(pool, other.pool);
+    swap(arena, other.arena);
+    swap(root, other.root);
+    swap(flat, other.flat);
     return *this;
 }
 
-double Octree::calculateWidth() const {
-    double max_coord = 0.0;
+Real Octree::calculateWidth() const {
+    Real max_coord = 0;
     for (size_t i = 0; i < size; i++) {
-        double max_obj_coord =
-            max(abs(bodies[i].position.x), max(abs(bodies[i].position.y), abs(bodies[i].position.z)));
+        Vec3 position = getPosition(i);
+        Real max_obj_coord = max(abs(position.x), max(abs(position.y), abs(position.z)));
         max_coord = max(max_coord, max_obj_coord);
     }
     return 3 * max_coord;
@@ -73,7 +156,7 @@ double Octree::calculateWidth() const {
 
 void Octree::grow() {
     // double the internal buffer of octree
-    allocSize *= 2;
+    allocSize = max<size_t>(2 * allocSize, 8);
     Body* temp = new Body[allocSize];
     // copy over all objects
     for (Body* ptr = bodies; size_t(ptr - bodies) < size; ptr++) {
@@ -81,11 +164,21 @@ void Octree::grow() {
     }
     delete[] bodies;
     bodies = temp;
-    // as memory locations have changed, rebuild the tree
-    buildTree();
+    // as memory locations have changed, rebuild the tree. The flat tree refers
+    // to bodies by index, so it stays valid, and a stale tree is rebuilt later
+    // anyway.
+    if (layout == OctreeLayout::POINTER && !stale)
+        buildTree();
 }
 
 void Octree::insert(Body& body) {
+    if (layout == OctreeLayout::FLAT) {
+        // the flat tree is rebuilt in bulk the next time it is needed
+        append(body);
+        return;
+    }
+    // appended bodies have to be in the tree before it grows one by one
+    refresh();
     // if object not in current bounds, expand width to fit it.
     if (body.position.x > width / 2 || body.position.x < -1 * width / 2 || body.position.y > width / 2 ||
         body.position.y < -1 * width / 2 || body.position.z > width / 2 || body.position.z < -1 * width / 2) {
@@ -96,33 +189,258 @@ void Octree::insert(Body& body) {
     // if not enough space in array
     if (allocSize == size)
         grow();
+    ids.push_back(uint32_t(size));
+    slots.push_back(uint32_t(size));
     bodies[size++] = body;
     if (!root) {
         Vec3 center = {0, 0, 0};
-        root = new OctreeNode(width, center);
+        root = arena->createNode(width, center);
     }
     root->insert(&bodies[size - 1]);
 }
 
+void Octree::append(const Body& body) {
+    // pointer nodes refer into the body buffer, which may move below
+    if (layout == OctreeLayout::POINTER && root)
+        releaseRoot();
+    stale = true;
+    if (storage == BodyStorage::SOA) {
+        arrays.push(body);
+    } else {
+        if (allocSize == size)
+            grow();
+        bodies[size] = body;
+    }
+    ids.push_back(uint32_t(size));
+    slots.push_back(uint32_t(size));
+    size++;
+}
+
 void Octree::printSummary(ostream& os) {
     os << "=======SUMMARY======="
        << "\n";
     for (size_t i = 0; i < size; i++) {
-        os << "( " << bodies[i].mass << "," << bodies[i].position << ")\n";
+        os << "( " << getMass(i) << "," << getPosition(i) << ")\n";
+    }
+}
+
+void Octree::sortBodies() {
+    keys.resize(size);
+    permutation.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        keys[i] = mortonKey(getPosition(i), width);
+        permutation[i] = uint32_t(i);
+    }
+    radixSort(keys, permutation, keyScratch, permutationScratch);
+    // gather bodies into their sorted positions, carrying insertion indices
+    // along with them
+    if (storage == BodyStorage::SOA) {
+        for (vector<Real>* field : arrays.fields()) {
+            fieldScratch.resize(size);
+            for (size_t i = 0; i < size; i++) {
+                fieldScratch[i] = (*field)[permutation[i]];
+            }
+            swap(*field, fieldScratch);
+        }
+    } else {
+        bodyScratch.assign(bodies, bodies + size);
+        for (size_t i = 0; i < size; i++) {
+            bodies[i] = bodyScratch[permutation[i]];
+        }
+    }
+    for (size_t i = 0; i < size; i++) {
+        permutationScratch[i] = ids[permutation[i]];
+    }
+    swap(ids, permutationScratch);
+    for (size_t i = 0; i < size; i++) {
+        slots[ids[i]] = uint32_t(i);
     }
 }
 
 void Octree::buildTree() {
     width = calculateWidth();
-    delete root;
+    if (mortonOrdering)
+        sortBodies();
+    if (layout == OctreeLayout::FLAT) {
+        if (storage == BodyStorage::SOA)
+            flat.build(arrays, width, pool);
+        else
+            flat.build(bodies, size, width, pool);
+        stale = false;
+        nodesBuilt += flat.size();
+        return;
+    }
+    releaseRoot();
     Vec3 center = {0, 0, 0};
-    root = new OctreeNode(width, center);
+    root = arena->createNode(width, center);
     for (size_t i = 0; i < size; i++) {
         root->insert(&bodies[i]);
     }
+    stale = false;
+    nodesBuilt += arena->nodeCount();
+}
+
+void Octree::updateTree() {
+    if (layout == OctreeLayout::FLAT && refitThreshold >= 0 && !stale && !flat.empty()) {
+        // bodies keep their place in the body buffer, so the tree's body order
+        // stays valid and no Morton sort is needed
+        size_t escaped = (storage == BodyStorage::SOA) ? flat.refit(arrays) : flat.refit(bodies, size);
+        if (double(escaped) <= refitThreshold * double(size))
+            return;
+    }
+    buildTree();
+}
+
+void Octree::setRefitThreshold(double fraction) { refitThreshold = fraction; }
+
+size_t Octree::getNodesBuilt() const { return nodesBuilt; }
+
+// Returns the depth of the deepest node below node, which is at the given
+// depth
+static size_t pointerDepth(const OctreeNode* node, size_t depth) {
+    size_t deepest = depth;
+    for (const OctreeNode* child : node->children) {
+        if (child)
+            deepest = max(deepest, pointerDepth(child, depth + 1));
+    }
+    return deepest;
 }
 
-Octree::OctreeIterator Octree::begin() { return OctreeIterator(&bodies[0]); }
-Octree::OctreeIterator Octree::end() { return OctreeIterator(&bodies[size]); }
+size_t Octree::depth() const {
+    if (layout == OctreeLayout::FLAT) {
+        size_t deepest = 0;
+        for (uint32_t i = 0; i < flat.size(); i++) {
+            deepest = max(deepest, size_t(flat[i].depth));
+        }
+        return deepest;
+    }
+    return root ? pointerDepth(root, 0) : 0;
+}
 
-size_t Octree::count() const { return size; }
\ No newline at end of file
+void Octree::releaseRoot() {
+    if (root && !root->getArena())
+        delete root;
+    root = nullptr;
+    if (arena)
+        arena->reset();
+}
+
+void Octree::refresh() {
+    if (stale)
+        buildTree();
+}
+
+void Octree::setLayout(OctreeLayout newLayout) {
+    if (newLayout == layout)
+        return;
+    if (storage == BodyStorage::SOA)
+        throw runtime_error("Error: SoA body storage requires the flat tree layout.");
+    if (flat.getLeafSize() > 1)
+        throw runtime_error("Error: Leaves holding several bodies require the flat tree layout.");
+    if (flat.hasQuadrupoles())
+        throw runtime_error("Error: Quadrupole moments require the flat tree layout.");
+    layout = newLayout;
+    releaseRoot();
+    flat.clear();
+    stale = false;
+    if (size > 0)
+        buildTree();
+}
+
+OctreeLayout Octree::getLayout() const { return layout; }
+
+void Octree::setMortonOrdering(bool enabled) { mortonOrdering = enabled; }
+
+void Octree::setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+
+void Octree::setStorage(BodyStorage newStorage) {
+    if (newStorage == storage)
+        return;
+    if (newStorage == BodyStorage::SOA) {
+        if (layout != OctreeLayout::FLAT)
+            throw runtime_error("Error: SoA body storage requires the flat tree layout.");
+        arrays.clear();
+        for (size_t i = 0; i < size; i++) {
+            arrays.push(bodies[i]);
+        }
+    } else {
+        if (allocSize < size) {
+            // the buffer holds nothing worth keeping, so replace it outright
+            delete[] bodies;
+            allocSize = size;
+            bodies = new Body[allocSize];
+        }
+        for (size_t i = 0; i < size; i++) {
+            bodies[i] = arrays.load(i);
+        }
+        arrays.clear();
+    }
+    storage = newStorage;
+}
+
+BodyStorage Octree::getStorage() const { return storage; }
+
+void Octree::setLeafSize(size_t leafSize) {
+    if (leafSize == flat.getLeafSize())
+        return;
+    if (leafSize > 1 && layout != OctreeLayout::FLAT)
+        throw runtime_error("Error: Leaves holding several bodies require the flat tree layout.");
+    flat.setLeafSize(leafSize);
+    if (layout == OctreeLayout::FLAT && size > 0)
+        buildTree();
+}
+
+size_t Octree::getLeafSize() const { return flat.getLeafSize(); }
+
+void Octree::setQuadrupoles(bool enabled) {
+    if (enabled == flat.hasQuadrupoles())
+        return;
+    if (enabled && layout != OctreeLayout::FLAT)
+        throw runtime_error("Error: Quadrupole moments require the flat tree layout.");
+    flat.setQuadrupoles(enabled);
+    if (layout == OctreeLayout::FLAT && size > 0)
+        buildTree();
+}
+
+BodyArrays& Octree::getArrays() { return arrays; }
+const BodyArrays& Octree::getArrays() const { return arrays; }
+
+Octree::OctreeIterator Octree::begin() {
+    if (storage == BodyStorage::SOA)
+        return OctreeIterator(nullptr, &arrays, 0);
+    return OctreeIterator(bodies, nullptr, 0);
+}
+Octree::OctreeIterator Octree::end() {
+    if (storage == BodyStorage::SOA)
+        return OctreeIterator(nullptr, &arrays, size);
+    return OctreeIterator(bodies, nullptr, size);
+}
+
+size_t Octree::count() const { return size; }
+
+Body& Octree::getBody(size_t index) { return bodies[index]; }
+const Body& Octree::getBody(size_t index) const { return bodies[index]; }
+
+Body Octree::loadBody(size_t index) const { return storage == BodyStorage::SOA ? arrays.load(index) : bodies[index]; }
+
+Body Octree::loadBodyById(size_t id) const { return loadBody(slots[id]); }
+
+size_t Octree::getId(size_t index) const { return ids[index]; }
+
+size_t Octree::findCoincidentBody() const {
+    vector<uint32_t> order(size);
+    iota(order.begin(), order.end(), 0);
+    // bodies at the same position end up next to each other, in insertion
+    // order
+    auto key = [this](uint32_t index) {
+        Vec3 position = getPosition(index);
+        return make_tuple(position.x, position.y, position.z, ids[index]);
+    };
+    sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) { return key(a) < key(b); });
+    size_t coincident = size;
+    for (size_t i = 1; i < size; i++) {
+        if (getPosition(order[i]) == getPosition(order[i - 1]))
+            coincident = min(coincident, size_t(ids[order[i]]));
+    }
+    return coincident;
+}
\ No newline at end of file
@@ -3,11 +3,19 @@
 #define OCTREE_H
 
 #include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <ostream>
 #include <vector>
 
 #include "nbsim/core/octree/body.hpp"
+#include "nbsim/core/octree/body_arrays.hpp"
+#include "nbsim/core/octree/body_storage.hpp"
+#include "nbsim/core/octree/flat_octree.hpp"
+#include "nbsim/core/octree/node_arena.hpp"
+#include "nbsim/core/octree/octree_layout.hpp"
 #include "nbsim/core/octree/octree_node.hpp"
+#include "nbsim/core/parallel/thread_pool.hpp"
 #include "nbsim/core/vec3/vec3.hpp"
 
 /**
@@ -26,60 +34,233 @@ class Octree {
     // Number of objects stored in object buffer
     size_t size;
     // Width of the root, a cuboid space
-    double width;
+    Real width;
     // Body storage for octree. The tree nodes only contain
     // pointers, so only relative locations are maintained as
     // opposed to data types. Bodies stored separately to separate body access
     // from spatial hierarchy of tree.
     Body* bodies;
+    // Body storage used instead of the body buffer with SoA storage
+    BodyArrays arrays;
+    // Memory layout of the bodies
+    BodyStorage storage;
+    // Memory layout of the spatial hierarchy
+    OctreeLayout layout;
+    // Set when bodies were appended since the tree was last built. The flat
+    // layout does not support incremental insertion, so insert appends.
+    bool stale;
+    // If set, bodies are sorted along a Morton curve every time the tree is
+    // built, so that spatially close bodies are close in memory
+    bool mortonOrdering;
+    // Fraction of bodies allowed outside the cell of their leaf before
+    // updateTree rebuilds a refitted tree. Negative if refitting is disabled.
+    double refitThreshold;
+    // Number of nodes created by all builds of the tree so far
+    size_t nodesBuilt;
+    // Insertion index of the body stored at each index of the body buffer
+    std::vector<uint32_t> ids;
+    // Index in the body buffer of the body with each insertion index
+    std::vector<uint32_t> slots;
+    // Thread pool used to build the tree, if any. Not owned by the tree.
+    ThreadPool* pool;
+    // Scratch space for Morton ordering, kept between builds to avoid
+    // reallocation
+    std::vector<uint64_t> keys, keyScratch;
+    std::vector<uint32_t> permutation, permutationScratch;
+    std::vector<Body> bodyScratch;
+    std::vector<Real> fieldScratch;
+    // Storage for the nodes of the pointer tree, reused between builds. Held
+    // by pointer so that nodes keep a valid arena when the tree is moved.
+    std::unique_ptr<NodeArena> arena;
     // grows the internal object buffer
     void grow();
+    // Releases the pointer tree. Nodes copied from another tree live on the
+    // heap and are deleted, nodes built here are returned to the arena.
+    void releaseRoot();
+    // Sorts the body buffer along a Morton curve
+    void sortBodies();
 
   public:
-    // The root of the internal tree
+    // The root of the internal tree. Only used with the pointer layout.
     OctreeNode* root;
+    // The internal tree. Only used with the flat layout.
+    FlatOctree flat;
     // Adds body to tree.
     void insert(Body& body);
+    // Adds body to the body storage without inserting it into the tree, which
+    // is built over all appended bodies by the next refresh. Much faster than
+    // inserting many bodies one by one into the pointer tree.
+    void append(const Body& body);
     // Prints a summary of all the current bodies and their state to the output
     // stream passed in
     void printSummary(std::ostream& os);
     // Builds the tree from root
     void buildTree();
+    // Builds the tree if bodies were added since the last build which are not
+    // yet part of the tree
+    void refresh();
+    // Brings the tree up to date after bodies moved. If refitting is enabled,
+    // the flat tree is refitted in place and only rebuilt once too many bodies
+    // have left their cells. Otherwise, the tree is rebuilt.
+    void updateTree();
+    // Enables refitting of the flat tree in updateTree, rebuilding once more
+    // than the given fraction of bodies has left their cells. Pass a negative
+    // fraction to rebuild on every update. The pointer layout always rebuilds.
+    void setRefitThreshold(double fraction);
+    // Returns the number of nodes created by all builds of the tree so far.
+    // Refits and bodies inserted one by one into the pointer tree create no
+    // counted nodes.
+    size_t getNodesBuilt() const;
+    // Returns the depth of the deepest node of the tree, zero if it only has a
+    // root. Walks the whole tree.
+    size_t depth() const;
+    // Switches the memory layout of the tree, rebuilding it if needed
+    void setLayout(OctreeLayout newLayout);
+    // Returns the memory layout of the tree
+    OctreeLayout getLayout() const;
+    // Sets the thread pool used to build the tree. Pass nullptr to build on
+    // the calling thread only. Only the flat layout builds concurrently.
+    void setThreadPool(ThreadPool* threadPool);
+    // Enables or disables sorting of bodies along a Morton curve on every
+    // build. While enabled, the body buffer is not in insertion order.
+    void setMortonOrdering(bool enabled);
+    // Switches the memory layout of the bodies, converting stored bodies. SoA
+    // storage requires the flat layout, since pointer nodes refer to Body
+    // objects. Throws std::runtime_error otherwise.
+    void setStorage(BodyStorage newStorage);
+    // Returns the memory layout of the bodies
+    BodyStorage getStorage() const;
+    // Sets the maximum number of bodies per leaf and rebuilds the tree. Leaves
+    // holding more than one body require the flat layout, since pointer nodes
+    // hold a single object. Throws std::runtime_error otherwise.
+    void setLeafSize(size_t leafSize);
+    // Returns the maximum number of bodies per leaf
+    size_t getLeafSize() const;
+    // Enables or disables quadrupole moments in tree nodes and rebuilds the
+    // tree. Quadrupoles require the flat layout. Throws std::runtime_error
+    // otherwise.
+    void setQuadrupoles(bool enabled);
+    // Returns the body arrays. Only used with SoA storage.
+    BodyArrays& getArrays();
+    const BodyArrays& getArrays() const;
     // Returns count of items stored
     size_t count() const;
+    // Returns the body stored at the given index of the body buffer. Only
+    // available with AoS storage.
+    Body& getBody(size_t index);
+    const Body& getBody(size_t index) const;
+    // Returns a copy of the body stored at the given index, with either storage
+    Body loadBody(size_t index) const;
+    // Returns a copy of the body that was inserted with the given insertion
+    // index, regardless of where it is currently stored
+    Body loadBodyById(size_t id) const;
+    // Returns the position of the body stored at the given index
+    Vec3 getPosition(size_t index) const {
+        return storage == BodyStorage::SOA ? arrays.position(index) : bodies[index].position;
+    }
+    // Returns the mass of the body stored at the given index
+    Real getMass(size_t index) const {
+        return storage == BodyStorage::SOA ? arrays.mass[index] : bodies[index].mass;
+    }
+    // Returns the insertion index of the body stored at the given index of the
+    // body buffer
+    size_t getId(size_t index) const;
+    // Returns the lowest insertion index of a body at the same position as a
+    // body inserted before it, or count() if all positions differ. Sorts
+    // bodies by position, needing only an index per body.
+    size_t findCoincidentBody() const;
     // Recalculates the width of the tree. Returns width, and assigns new tree
     // width
-    double calculateWidth() const;
+    Real calculateWidth() const;
     // Default constructor, with default simulation width of 1000 meters.
     Octree();
     // Constructor which takes in simWidth. If the maximum simulation width is
     // known beforehand, then tree construction is faster
-    Octree(double simWidth);
+    Octree(Real simWidth);
     // Constructor with set of objects. If objects are preknown, tree
     // construction is faster.
     Octree(std::vector<Body>& inputBodies);
 
+    /**
+     * Components of a vector of a body, referring to wherever the body is
+     * stored
+     */
+    struct Vec3Ref {
+        Real& x;
+        Real& y;
+        Real& z;
+
+        operator Vec3() const { return Vec3{x, y, z}; }
+        Vec3Ref& operator=(const Vec3& value) {
+            x = value.x;
+            y = value.y;
+            z = value.z;
+            return *this;
+        }
+        Vec3Ref& operator+=(const Vec3& value) {
+            x += value.x;
+            y += value.y;
+            z += value.z;
+            return *this;
+        }
+        Vec3 operator*(const Real value) const { return Vec3(*this) * value; }
+        bool operator==(const Vec3& other) const { return Vec3(*this) == other; }
+    };
+
+    /**
+     * A body stored in the tree, whose fields refer to the Body or to the
+     * entries of BodyArrays holding them
+     */
+    struct BodyRef {
+        Real& mass;
+        Vec3Ref position;
+        Vec3Ref velocity;
+        Vec3Ref acceleration;
+    };
+
     /**
      * Allows iteration through objects stored in tree. Iteration is done in
-     * order of insertion. C++ 17 style with tags.
+     * order of the body buffer, which is the order of insertion unless Morton
+     * ordering is enabled. Dereferencing yields a BodyRef, which works the
+     * same for both storages. C++ 17 style with tags.
      */
     class OctreeIterator {
         using Category = std::forward_iterator_tag;
         using DiffType = std::ptrdiff_t;
         using ValueType = Body;
-        using Pointer = Body*;
-        using Reference = Body&;
+        using Reference = BodyRef;
 
-        Pointer obj_ptr;
+        Body* bodies;       // body buffer with AoS storage, else null
+        BodyArrays* arrays; // body arrays with SoA storage, else null
+        size_t index;       // index of the body in the buffer
 
       public:
-        OctreeIterator(Pointer pointer) : obj_ptr(pointer) {}
-        Reference operator*() const { return *obj_ptr; }
-        bool operator==(const OctreeIterator& other) const { return obj_ptr == other.obj_ptr; }
+        OctreeIterator(Body* bodies, BodyArrays* arrays, size_t index)
+            : bodies(bodies),
+              arrays(arrays),
+              index(index) {}
+        Reference operator*() const {
+            if (bodies) {
+                Body& body = bodies[index];
+                return BodyRef{
+                    body.mass,
+                    {body.position.x, body.position.y, body.position.z},
+                    {body.velocity.x, body.velocity.y, body.velocity.z},
+                    {body.acceleration.x, body.acceleration.y, body.acceleration.z}
+                };
+            }
+            return BodyRef{
+                arrays->mass[index],
+                {arrays->x[index], arrays->y[index], arrays->z[index]},
+                {arrays->vx[index], arrays->vy[index], arrays->vz[index]},
+                {arrays->ax[index], arrays->ay[index], arrays->az[index]}
+            };
+        }
+        bool operator==(const OctreeIterator& other) const { return index == other.index; }
         bool operator!=(const OctreeIterator& other) const { return !(*this == other); }
         // prefix
         OctreeIterator& operator++() {
-            obj_ptr++;
+            index++;
             return *this;
         }
         // postfix
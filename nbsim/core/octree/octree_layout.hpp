@@ -0,0 +1,8 @@
+#pragma once
+#ifndef OCTREE_LAYOUT_H
+#define OCTREE_LAYOUT_H
+// Memory layouts available for the spatial hierarchy of an Octree. POINTER
+// keeps one heap allocated OctreeNode per node, while FLAT stores every node in
+// a single contiguous array addressed by 32-bit indices.
+enum class OctreeLayout : char { POINTER, FLAT };
+#endif
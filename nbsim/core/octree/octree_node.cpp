@@ -1,27 +1,28 @@
 #include "nbsim/core/octree/octree_node.hpp"
 
-using namespace std;
+#include "nbsim/core/octree/node_arena.hpp"
 
-size_t OctreeNode::count = 0;
+using namespace std;
 
 // default constructor
-OctreeNode::OctreeNode(double width, const Vec3& center)
+OctreeNode::OctreeNode(Real width, const Vec3& center, NodeArena* arena)
     : type{OctreeNodeType::EXTERNAL},
       box{BoundingBox(center, width)},
-      localObj{nullptr} {
+      localObj{nullptr},
+      arena{arena} {
     // every single node starts off as external - only by growing does it become
     // internal
     for (size_t i = 0; i < 8; i++) {
         children[i] = nullptr;
     }
-    count++;
 }
 
 // copy constructor
 OctreeNode::OctreeNode(const OctreeNode& other)
     : type{other.type},
       box{BoundingBox(other.box.center, other.box.width)},
-      localObj{nullptr} {
+      localObj{nullptr},
+      arena{nullptr} {
     for (size_t i = 0; i < 8; i++) {
         children[i] = nullptr;
     }
@@ -36,13 +37,10 @@ OctreeNode::OctreeNode(const OctreeNode& other)
             }
         }
     }
-    count++;
 }
 
 // assignment operator. Uses copy swap idiom.
 OctreeNode& OctreeNode::operator=(const OctreeNode& other) {
-    count++;
-
     return *this = OctreeNode(other);
 }
 
@@ -50,7 +48,8 @@ OctreeNode& OctreeNode::operator=(const OctreeNode& other) {
 OctreeNode::OctreeNode(OctreeNode&& other)
     : type{other.type},
       box{BoundingBox(other.box.center, other.box.width)},
-      localObj{other.localObj} {
+      localObj{other.localObj},
+      arena{other.arena} {
     other.localObj = nullptr;
     for (size_t i = 0; i < 8; i++) {
         children[i] = other.children[i];
@@ -58,22 +57,21 @@ OctreeNode::OctreeNode(OctreeNode&& other)
     for (size_t i = 0; i < 8; i++) {
         other.children[i] = nullptr;
     }
-    count++;
 }
 
 // move assignment operator
 OctreeNode& OctreeNode::operator=(OctreeNode&& other) {
-    count++;
-
     swap(other.type, type);
     swap(other.box, box);
     swap(other.localObj, localObj);
+    swap(other.arena, arena);
     swap(other.children, children);
     return *this;
 }
 
 OctreeNode::~OctreeNode() {
-    if (type == OctreeNodeType::INTERNAL) {
+    // the arena owns everything below a node allocated from it
+    if (type == OctreeNodeType::INTERNAL && !arena) {
         // if an internal node, localObj is phantom obj - this instance owns it
         delete localObj;
         // clear all children nodes and reset them
@@ -100,39 +98,42 @@ void OctreeNode::insertOctant(Object* obj) {
         Vec3 newCenter;
         switch (oct) {
         case Octant::FIRST: {
-            newCenter = box.center + Vec3{box.width / 4.0, box.width / 4.0, box.width / 4.0};
+            newCenter = box.center + Vec3{box.width / 4, box.width / 4, box.width / 4};
             break;
         }
         case Octant::SECOND: {
-            newCenter = box.center + Vec3{box.width / 4.0, box.width / 4.0, -1 * box.width / 4.0};
+            newCenter = box.center + Vec3{box.width / 4, box.width / 4, -1 * box.width / 4};
             break;
         }
         case Octant::THIRD: {
-            newCenter = box.center + Vec3{box.width / 4.0, -1 * box.width / 4.0, box.width / 4.0};
+            newCenter = box.center + Vec3{box.width / 4, -1 * box.width / 4, box.width / 4};
             break;
         }
         case Octant::FOURTH: {
-            newCenter = box.center + Vec3{box.width / 4.0, -1 * box.width / 4.0, -1 * box.width / 4.0};
+            newCenter = box.center + Vec3{box.width / 4, -1 * box.width / 4, -1 * box.width / 4};
             break;
         }
         case Octant::FIFTH: {
-            newCenter = box.center + Vec3{-1 * box.width / 4.0, box.width / 4.0, box.width / 4.0};
+            newCenter = box.center + Vec3{-1 * box.width / 4, box.width / 4, box.width / 4};
             break;
         }
         case Octant::SIXTH: {
-            newCenter = box.center + Vec3{-1 * box.width / 4.0, box.width / 4.0, -1 * box.width / 4.0};
+            newCenter = box.center + Vec3{-1 * box.width / 4, box.width / 4, -1 * box.width / 4};
             break;
         }
         case Octant::SEVENTH: {
-            newCenter = box.center + Vec3{-1 * box.width / 4.0, -1 * box.width / 4.0, box.width / 4.0};
+            newCenter = box.center + Vec3{-1 * box.width / 4, -1 * box.width / 4, box.width / 4};
             break;
         }
         default: {
-            newCenter = box.center + Vec3{-1 * box.width / 4.0, -1 * box.width / 4.0, -1 * box.width / 4.0};
+            newCenter = box.center + Vec3{-1 * box.width / 4, -1 * box.width / 4, -1 * box.width / 4};
             break;
         }
         }
-        children[index] = new OctreeNode(box.width / 2.0, newCenter);
+        if (arena)
+            children[index] = arena->createNode(box.width / 2, newCenter);
+        else
+            children[index] = new OctreeNode(box.width / 2, newCenter);
     }
     children[index]->insert(obj);
 }
@@ -142,7 +143,7 @@ void OctreeNode::subdivide() {
         // convert from external to internal
         Object* temp = localObj;
         localObj = nullptr;
-        localObj = new Object;
+        localObj = arena ? arena->createObject() : new Object;
         // insert the old object in new octant
         insertOctant(temp);
         type = OctreeNodeType::INTERNAL;
@@ -157,7 +158,6 @@ void OctreeNode::insert(Object* obj) {
         subdivide();
         insertOctant(obj);
     }
-    // cout << OctreeNode::count << endl;
 }
 
 Octant OctreeNode::getOctant(Object* obj) {
@@ -188,14 +188,17 @@ Octant OctreeNode::getOctant(Object* obj) {
 }
 
 Vec3 OctreeNode::centerOfMass(Object* o1, Object* o2) {
-    Vec3 temp = o1->position * o1->mass + o2->position * o2->mass;
-    temp /= (o1->mass + o2->mass);
-    return temp;
+    // weighted in double precision, as mass times position overflows single
+    // precision for astronomical systems
+    Vec3T<double> temp = o1->position.to<double>() * o1->mass + o2->position.to<double>() * o2->mass;
+    temp /= double(o1->mass) + o2->mass;
+    return temp.to<Real>();
 }
 
 bool OctreeNode::empty() const { return !localObj; }
 const BoundingBox& OctreeNode::getBounds() const { return box; }
 OctreeNodeType OctreeNode::getType() const { return type; }
+NodeArena* OctreeNode::getArena() const { return arena; }
 const Object& OctreeNode::getObject() const {
     if (!empty())
         return *localObj;
@@ -10,6 +10,8 @@
 #include "nbsim/core/octree/octree_node_type.hpp"
 #include "nbsim/core/vec3/vec3.hpp"
 
+class NodeArena;
+
 /**
  * Node in an octree.
  */
@@ -22,8 +24,10 @@ class OctreeNode {
     // The "object" in this region. If an external
     // node, is a pointer to a Body.
     Object* localObj;
-    // temp
-    static size_t count;
+    // Arena the children and center of mass object of this node are allocated
+    // from, or nullptr if they are allocated on the heap. Nodes in an arena do
+    // not free anything; the arena releases them all at once.
+    NodeArena* arena;
     // Gets the octant which this object should belong in with respect to this
     // region of space.
     Octant getOctant(Object* obj);
@@ -48,9 +52,13 @@ class OctreeNode {
     // Returns read-only access to the local object stored here. If no object
     // stored, throws an error.
     const Object& getObject() const;
+    // Returns the arena this node allocates from, or nullptr if it allocates
+    // on the heap
+    NodeArena* getArena() const;
     // The Big Five
-    OctreeNode(double width, const Vec3& center);
+    OctreeNode(Real width, const Vec3& center, NodeArena* arena = nullptr);
     ~OctreeNode();
+    // Copies are always allocated on the heap
     OctreeNode(const OctreeNode& other);
     OctreeNode(OctreeNode&& other);
     OctreeNode& operator=(const OctreeNode& other);
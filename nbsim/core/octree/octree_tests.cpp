@@ -8,6 +8,15 @@ using namespace std;
 class TestOctree : public ::testing::Test {
   protected:
     TestOctree() = default;
+    // 20 bodies at distinct positions alternating between opposite octants
+    static vector<Body> alternatingBodies(const Vec3& velocity = Vec3{}, const Vec3& acceleration = Vec3{}) {
+        vector<Body> bodies;
+        for (int i = 0; i < 20; i++) {
+            Real sign = (i % 2) ? 1 : -1;
+            bodies.push_back(Body(i + 1, Vec3{sign * i, -sign * i, sign * (20 - i)}, velocity, acceleration));
+        }
+        return bodies;
+    }
 };
 
 TEST_F(TestOctree, BasicInitialization) {
@@ -85,7 +94,7 @@ TEST_F(TestOctree, IteratorsLoopThroughAllObjects) {
     vector<Body> bodies({obj, obj2, obj3});
     Octree tree(bodies);
     size_t index = 0;
-    for (auto& body : tree) {
+    for (auto&& body : tree) {
         EXPECT_EQ(body.mass, bodies[index].mass);
         EXPECT_EQ(body.position, bodies[index++].position);
     }
@@ -117,3 +126,144 @@ TEST_F(TestOctree, BoundsAdaptToWidthWhileBuilding) {
     }
     tree.buildTree();
 }
+
+TEST_F(TestOctree, MortonOrderingKeepsTrackOfInsertionOrder) {
+    vector<Body> bodies = alternatingBodies();
+    Octree tree(bodies);
+    tree.setMortonOrdering(true);
+    tree.buildTree();
+    bool reordered = false;
+    for (size_t i = 0; i < bodies.size(); i++) {
+        EXPECT_EQ(tree.loadBodyById(i).mass, bodies[i].mass);
+        EXPECT_EQ(tree.loadBodyById(i).position, bodies[i].position);
+        EXPECT_EQ(tree.loadBodyById(tree.getId(i)).mass, tree.getBody(i).mass);
+        reordered = reordered || tree.getId(i) != i;
+    }
+    EXPECT_TRUE(reordered);
+}
+
+TEST_F(TestOctree, StructureOfArraysStorageRoundTrips) {
+    vector<Body> bodies = alternatingBodies(Vec3{1, 2, 3});
+    Octree tree(bodies);
+    EXPECT_THROW(tree.setStorage(BodyStorage::SOA), std::runtime_error);
+    tree.setLayout(OctreeLayout::FLAT);
+    tree.setStorage(BodyStorage::SOA);
+    EXPECT_THROW(tree.setLayout(OctreeLayout::POINTER), std::runtime_error);
+    tree.setMortonOrdering(true);
+    tree.buildTree();
+    EXPECT_EQ(tree.getArrays().size(), bodies.size());
+    for (size_t i = 0; i < bodies.size(); i++) {
+        Body body = tree.loadBodyById(i);
+        EXPECT_EQ(body.mass, bodies[i].mass);
+        EXPECT_EQ(body.position, bodies[i].position);
+        EXPECT_EQ(body.velocity, bodies[i].velocity);
+        EXPECT_EQ(tree.getPosition(i), tree.loadBody(i).position);
+    }
+    tree.setStorage(BodyStorage::AOS);
+    for (size_t i = 0; i < bodies.size(); i++) {
+        EXPECT_EQ(tree.loadBodyById(i).position, bodies[i].position);
+    }
+}
+
+TEST_F(TestOctree, IteratorsWriteThroughToArrays) {
+    vector<Body> bodies = alternatingBodies(Vec3{1, 2, 3}, Vec3{0, 0, 1});
+    Octree tree(bodies);
+    tree.setLayout(OctreeLayout::FLAT);
+    tree.setStorage(BodyStorage::SOA);
+    size_t index = 0;
+    for (auto&& body : tree) {
+        EXPECT_EQ(body.position, tree.loadBody(index++).position);
+        body.velocity += body.acceleration * 2;
+        body.position = Vec3{};
+    }
+    EXPECT_EQ(index, bodies.size());
+    for (size_t i = 0; i < bodies.size(); i++) {
+        EXPECT_EQ(tree.loadBody(i).velocity, (Vec3{1, 2, 5}));
+        EXPECT_EQ(tree.loadBody(i).position, Vec3{});
+    }
+}
+
+TEST_F(TestOctree, BuildsCountNodesAndReportDepth) {
+    vector<Body> bodies = alternatingBodies();
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        Octree tree(bodies);
+        tree.setLayout(layout);
+        const size_t before = tree.getNodesBuilt();
+        tree.buildTree();
+        const size_t built = tree.getNodesBuilt() - before;
+        EXPECT_GT(built, bodies.size());
+        EXPECT_GT(tree.depth(), 0u);
+        tree.buildTree();
+        EXPECT_EQ(tree.getNodesBuilt(), before + 2 * built);
+    }
+}
+
+TEST_F(TestOctree, AppendedBodiesJoinTheTreeOnRefresh) {
+    vector<Body> bodies = alternatingBodies();
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        Octree tree;
+        tree.setLayout(layout);
+        for (const Body& body : bodies) {
+            tree.append(body);
+        }
+        EXPECT_EQ(tree.getNodesBuilt(), 0u);
+        tree.refresh();
+        EXPECT_EQ(tree.count(), bodies.size());
+        EXPECT_GT(tree.getNodesBuilt(), bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++) {
+            EXPECT_EQ(tree.loadBodyById(i).position, bodies[i].position);
+        }
+        Body appended(1, Vec3{100, 100, 100}, Vec3{}, Vec3{});
+        Body inserted(1, Vec3{-100, 100, 100}, Vec3{}, Vec3{});
+        tree.append(appended);
+        tree.insert(inserted);
+        EXPECT_EQ(tree.count(), bodies.size() + 2);
+    }
+}
+
+TEST_F(TestOctree, FindsFirstBodyAtAnotherBodysPosition) {
+    Octree tree;
+    for (Real x : {3, 1, 2, 5}) {
+        tree.append(Body(1, Vec3{x, -x, 0}, Vec3{}, Vec3{}));
+    }
+    EXPECT_EQ(tree.findCoincidentBody(), tree.count());
+    for (Real x : {4, 2, 3}) {
+        tree.append(Body(1, Vec3{x, -x, 0}, Vec3{}, Vec3{}));
+    }
+    EXPECT_EQ(tree.findCoincidentBody(), 5u);
+}
+
+TEST_F(TestOctree, StructureOfArraysTreesGrowAndCopy) {
+    Octree tree;
+    tree.setLayout(OctreeLayout::FLAT);
+    tree.setStorage(BodyStorage::SOA);
+    vector<Body> bodies;
+    for (int i = 0; i < 100; i++) {
+        bodies.push_back(Body(i + 1, Vec3{Real(i), Real(-2 * i), Real(i % 7)}, Vec3{}, Vec3{}));
+        if (i % 2)
+            tree.append(bodies.back());
+        else
+            tree.insert(bodies.back());
+    }
+    tree.refresh();
+    EXPECT_EQ(tree.count(), bodies.size());
+    EXPECT_EQ(tree.getArrays().size(), bodies.size());
+    Octree copy(tree);
+    Octree assigned;
+    assigned = tree;
+    for (const Octree* other : {&copy, &assigned}) {
+        EXPECT_EQ(other->count(), bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++) {
+            EXPECT_EQ(other->loadBodyById(i).mass, bodies[i].mass);
+            EXPECT_EQ(other->loadBodyById(i).position, bodies[i].position);
+        }
+    }
+    copy.append(Body(1, Vec3{-1, -1, -1}, Vec3{}, Vec3{}));
+    copy.refresh();
+    EXPECT_EQ(copy.count(), bodies.size() + 1);
+    EXPECT_EQ(tree.count(), bodies.size());
+    copy.setStorage(BodyStorage::AOS);
+    for (size_t i = 0; i < bodies.size(); i++) {
+        EXPECT_EQ(copy.loadBodyById(i).position, bodies[i].position);
+    }
+}
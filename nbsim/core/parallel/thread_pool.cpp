@@ -0,0 +1,95 @@
+#include "nbsim/core/parallel/thread_pool.hpp"
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t threads)
+    : job{nullptr},
+      chunks{0},
+      nextChunk{0},
+      busy{0},
+      generation{0},
+      stopping{false} {
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1u);
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const { return workers.size() + 1; }
+
+void ThreadPool::runChunks() {
+    size_t chunk;
+    while ((chunk = nextChunk.fetch_add(1)) < chunks) {
+        try {
+            (*job)(chunk);
+        } catch (...) {
+            lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = current_exception();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    size_t seen = 0;
+    while (true) {
+        {
+            unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        runChunks();
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+                finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run(size_t count, const function<void(size_t)>& chunkJob) {
+    if (count == 0)
+        return;
+    if (workers.empty() || count == 1) {
+        // nothing to share, so skip the synchronization
+        for (size_t chunk = 0; chunk < count; chunk++) {
+            chunkJob(chunk);
+        }
+        return;
+    }
+    {
+        lock_guard<std::mutex> lock(mutex);
+        job = &chunkJob;
+        chunks = count;
+        nextChunk = 0;
+        busy = workers.size();
+        error = nullptr;
+        generation++;
+    }
+    wake.notify_all();
+    runChunks();
+    exception_ptr thrown;
+    {
+        unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+        thrown = error;
+        error = nullptr;
+    }
+    if (thrown)
+        rethrow_exception(thrown);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that execute jobs split into chunks. Chunks
+ * are claimed dynamically, so uneven chunks are balanced between threads. The
+ * calling thread takes part in every job, so a pool of size n runs n - 1
+ * workers.
+ *
+ * Jobs must not submit further jobs to the pool they run on.
+ */
+class ThreadPool {
+  private:
+    // Background worker threads
+    std::vector<std::thread> workers;
+    // Guards all job state below, except the chunk counter
+    std::mutex mutex;
+    // Signals workers that a new job is available or that the pool stops
+    std::condition_variable wake;
+    // Signals the submitting thread that all workers finished a job
+    std::condition_variable finished;
+    // Current job, called once per chunk index
+    const std::function<void(size_t)>* job;
+    // Number of chunks in the current job
+    size_t chunks;
+    // Next chunk of the current job to be claimed
+    std::atomic<size_t> nextChunk;
+    // Number of workers still busy with the current job
+    size_t busy;
+    // Incremented for every job, so workers can tell jobs apart
+    size_t generation;
+    // Set when the pool is being destroyed
+    bool stopping;
+    // First exception thrown by the current job
+    std::exception_ptr error;
+    // Main loop of each worker thread
+    void workerLoop();
+    // Claims and runs chunks of the current job until none are left
+    void runChunks();
+
+  public:
+    // Creates a pool running jobs on the given number of threads, including
+    // the calling thread. A pool of zero threads uses one per hardware thread.
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+    // Returns the number of threads jobs run on, including the calling thread
+    size_t size() const;
+    // Calls job(i) for every chunk index i in [0, count), and returns once all
+    // calls returned. If any call throws, the first exception is rethrown.
+    void run(size_t count, const std::function<void(size_t)>& chunkJob);
+    // Calls body(begin, end) over consecutive ranges of at most grain indices
+    // covering [0, count)
+    template <typename F> void parallelFor(size_t count, size_t grain, F&& body) {
+        if (grain == 0)
+            grain = 1;
+        size_t chunkCount = (count + grain - 1) / grain;
+        run(chunkCount, [&](size_t chunk) {
+            size_t begin = chunk * grain;
+            body(begin, std::min(begin + grain, count));
+        });
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "nbsim/core/parallel/thread_pool.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+class TestThreadPool : public ::testing::Test {
+  protected:
+    TestThreadPool() = default;
+};
+
+TEST_F(TestThreadPool, SizeIncludesCallingThread) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4);
+    ThreadPool single(1);
+    EXPECT_EQ(single.size(), 1);
+}
+
+TEST_F(TestThreadPool, RunsEveryChunkExactlyOnce) {
+    ThreadPool pool(4);
+    vector<atomic<int>> hits(1000);
+    pool.run(hits.size(), [&](size_t chunk) { hits[chunk]++; });
+    for (auto& hit : hits) {
+        EXPECT_EQ(hit.load(), 1);
+    }
+}
+
+TEST_F(TestThreadPool, ParallelForCoversRangeWithUnevenTail) {
+    ThreadPool pool(3);
+    vector<int> values(1003, 0);
+    pool.parallelFor(values.size(), 10, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            values[i] += int(i);
+        }
+    });
+    for (size_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(values[i], int(i));
+    }
+}
+
+TEST_F(TestThreadPool, RunsManyJobsInSequence) {
+    ThreadPool pool(4);
+    atomic<size_t> total{0};
+    for (size_t job = 0; job < 200; job++) {
+        pool.run(16, [&](size_t chunk) { total += chunk; });
+    }
+    EXPECT_EQ(total.load(), 200 * 120);
+}
+
+TEST_F(TestThreadPool, RethrowsExceptionsFromChunks) {
+    ThreadPool pool(4);
+    EXPECT_THROW(
+        pool.run(
+            64,
+            [&](size_t chunk) {
+                if (chunk == 17)
+                    throw runtime_error("failed chunk");
+            }
+        ),
+        runtime_error
+    );
+    // the pool stays usable after a failed job
+    atomic<int> count{0};
+    pool.run(8, [&](size_t) { count++; });
+    EXPECT_EQ(count.load(), 8);
+}
@@ -0,0 +1,88 @@
+#include "nbsim/core/snapshot/async_snapshot_writer.hpp"
+
+#include <utility>
+
+using namespace std;
+
+AsyncSnapshotWriter::AsyncSnapshotWriter(ostream& out, SnapshotFormat format, size_t capacity, uint32_t fields)
+    : writer{out, format, fields},
+      capacity{capacity} {
+    writer.begin();
+    if (capacity > 0)
+        thread = std::thread(&AsyncSnapshotWriter::writerLoop, this);
+}
+
+AsyncSnapshotWriter::~AsyncSnapshotWriter() {
+    try {
+        close();
+    } catch (...) {
+        // errors can only be reported through close()
+    }
+}
+
+void AsyncSnapshotWriter::writerLoop() {
+    unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return closing || !pending.empty(); });
+        if (pending.empty())
+            return;
+        Snapshot current = std::move(pending.front());
+        pending.pop_front();
+        room.notify_one();
+        lock.unlock();
+        // after a failure the rest of the queue is dropped, the error is
+        // reported to the simulation thread instead
+        exception_ptr failure;
+        if (!error) {
+            try {
+                writer.write(current);
+            } catch (...) {
+                failure = current_exception();
+            }
+        }
+        lock.lock();
+        if (failure && !error) {
+            error = failure;
+            room.notify_one();
+        }
+        spare.push_back(std::move(current));
+    }
+}
+
+void AsyncSnapshotWriter::write(Snapshot& snapshot) {
+    if (capacity == 0) {
+        writer.write(snapshot);
+        return;
+    }
+    {
+        unique_lock<std::mutex> lock(mutex);
+        room.wait(lock, [&] { return pending.size() < capacity || error; });
+        if (error)
+            rethrow_exception(error);
+        pending.push_back(std::move(snapshot));
+        if (!spare.empty()) {
+            snapshot = std::move(spare.back());
+            spare.pop_back();
+        } else {
+            snapshot = Snapshot{};
+        }
+    }
+    wake.notify_one();
+}
+
+void AsyncSnapshotWriter::close() {
+    if (closed)
+        return;
+    closed = true;
+    if (thread.joinable()) {
+        {
+            lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+    if (error)
+        rethrow_exception(error);
+    writer.end();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef ASYNC_SNAPSHOT_WRITER_H
+#define ASYNC_SNAPSHOT_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "nbsim/core/snapshot/snapshot.hpp"
+#include "nbsim/core/snapshot/snapshot_format.hpp"
+#include "nbsim/core/snapshot/snapshot_writer.hpp"
+
+/**
+ * Encodes and writes snapshots on a background thread, so the simulation only
+ * waits for output when the writer falls behind by more than a fixed number of
+ * snapshots. Snapshots are handed over by swapping storage, and written
+ * snapshots are handed back for reuse, so a steady run does not allocate.
+ *
+ * With a capacity of zero, snapshots are written on the calling thread
+ * instead. Output is identical either way.
+ */
+class AsyncSnapshotWriter {
+  private:
+    // Encoder of the output. Only used by the writer thread once it runs.
+    SnapshotWriter writer;
+    // Maximum number of snapshots waiting to be written
+    size_t capacity;
+    // Guards all state below
+    std::mutex mutex;
+    // Signals the writer thread that a snapshot is pending or writing ends
+    std::condition_variable wake;
+    // Signals the simulation thread that the queue has room again
+    std::condition_variable room;
+    // Snapshots waiting to be written, oldest first
+    std::deque<Snapshot> pending;
+    // Written snapshots whose storage can be reused
+    std::vector<Snapshot> spare;
+    // Set once no further snapshots will be queued
+    bool closing = false;
+    // Set once the output has been ended
+    bool closed = false;
+    // First exception thrown while writing
+    std::exception_ptr error;
+    // Background thread writing queued snapshots. Not started with a capacity
+    // of zero.
+    std::thread thread;
+    // Main loop of the writer thread
+    void writerLoop();
+
+  public:
+    // Starts writing the given SnapshotField flags of every body to out in the
+    // given format, keeping up to capacity snapshots queued. Throws
+    // std::runtime_error if no field is chosen.
+    AsyncSnapshotWriter(std::ostream& out, SnapshotFormat format, size_t capacity, uint32_t fields = DEFAULT_FIELDS);
+    // Closes the output if that did not happen yet, ignoring any error
+    ~AsyncSnapshotWriter();
+    AsyncSnapshotWriter(const AsyncSnapshotWriter& other) = delete;
+    AsyncSnapshotWriter& operator=(const AsyncSnapshotWriter& other) = delete;
+    // Queues snapshot for writing, blocking while the queue is full. snapshot
+    // is left holding storage of an earlier snapshot to be refilled. Rethrows
+    // the first error of an earlier write as std::runtime_error.
+    void write(Snapshot& snapshot);
+    // Writes all queued snapshots, ends the output and stops the writer
+    // thread. Rethrows the first error of any write.
+    void close();
+};
+
+#endif
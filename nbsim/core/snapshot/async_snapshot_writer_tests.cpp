@@ -0,0 +1,81 @@
+#include "nbsim/core/snapshot/async_snapshot_writer.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace std;
+
+class TestAsyncSnapshotWriter : public ::testing::Test {
+  protected:
+    TestAsyncSnapshotWriter() = default;
+    // Fills snapshot with the state at the given step of a made up run
+    void fill(Snapshot& snapshot, size_t step) {
+        snapshot.time = double(step);
+        snapshot.bodies.resize(50);
+        for (size_t i = 0; i < snapshot.bodies.size(); i++) {
+            const Real value = Real(step * 100 + i);
+            snapshot.bodies[i] = Body(value, Vec3{value, 1, 2}, Vec3{3, value, 4}, Vec3{5, 6, value});
+        }
+    }
+    // Returns the output of writing steps snapshots in format
+    string writeSync(SnapshotFormat format, size_t steps) {
+        ostringstream out;
+        SnapshotWriter writer(out, format);
+        Snapshot snapshot;
+        writer.begin();
+        for (size_t step = 0; step < steps; step++) {
+            fill(snapshot, step);
+            writer.write(snapshot);
+        }
+        writer.end();
+        return out.str();
+    }
+};
+
+TEST_F(TestAsyncSnapshotWriter, MatchesSynchronousOutput) {
+    for (SnapshotFormat format : {SnapshotFormat::JSON, SnapshotFormat::FLOAT64}) {
+        const string expected = writeSync(format, 40);
+        for (size_t capacity : {0, 1, 3}) {
+            ostringstream out;
+            AsyncSnapshotWriter writer(out, format, capacity);
+            Snapshot snapshot;
+            for (size_t step = 0; step < 40; step++) {
+                fill(snapshot, step);
+                writer.write(snapshot);
+            }
+            writer.close();
+            EXPECT_EQ(out.str(), expected) << "capacity " << capacity;
+        }
+    }
+}
+
+TEST_F(TestAsyncSnapshotWriter, DestructorFinishesOutput) {
+    const string expected = writeSync(SnapshotFormat::JSON, 5);
+    ostringstream out;
+    {
+        AsyncSnapshotWriter writer(out, SnapshotFormat::JSON, 2);
+        Snapshot snapshot;
+        for (size_t step = 0; step < 5; step++) {
+            fill(snapshot, step);
+            writer.write(snapshot);
+        }
+    }
+    EXPECT_EQ(out.str(), expected);
+}
+
+TEST_F(TestAsyncSnapshotWriter, ReportsFailedWrites) {
+    ostringstream out;
+    AsyncSnapshotWriter writer(out, SnapshotFormat::FLOAT32, 2);
+    out.setstate(ios::badbit);
+    Snapshot snapshot;
+    fill(snapshot, 0);
+    // the failure surfaces on a later write or when closing
+    EXPECT_THROW(
+        {
+            for (size_t step = 0; step < 100; step++) {
+                writer.write(snapshot);
+            }
+            writer.close();
+        },
+        std::runtime_error
+    );
+}
@@ -0,0 +1,110 @@
+#include "nbsim/core/snapshot/checkpoint.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+// Number of doubles stored per body
+constexpr size_t VALUES_PER_BODY = 10;
+// Size of everything before the first body
+constexpr size_t HEADER_SIZE =
+    sizeof(Checkpoint::MAGIC) + sizeof(uint16_t) + 2 * sizeof(uint64_t) + 3 * sizeof(double);
+
+// Appends the raw bytes of value to buffer
+template <typename T> void append(string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Copies a T from cursor and advances it
+template <typename T> T take(const char*& cursor) {
+    T value;
+    memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+} // namespace
+
+void writeCheckpoint(const string& path, const Checkpoint& checkpoint) {
+    const vector<Body>& bodies = checkpoint.state.bodies;
+    string buffer;
+    buffer.reserve(HEADER_SIZE + bodies.size() * VALUES_PER_BODY * sizeof(double));
+    buffer.append(Checkpoint::MAGIC, sizeof(Checkpoint::MAGIC));
+    append(buffer, Checkpoint::VERSION);
+    append(buffer, checkpoint.step);
+    append(buffer, uint64_t(bodies.size()));
+    append(buffer, checkpoint.state.time);
+    append(buffer, checkpoint.dt);
+    append(buffer, checkpoint.theta);
+    for (const Body& body : bodies) {
+        const double record[VALUES_PER_BODY] = {
+            body.mass,           body.position.x,    body.position.y,    body.position.z,    body.velocity.x,
+            body.velocity.y,     body.velocity.z,    body.acceleration.x, body.acceleration.y, body.acceleration.z,
+        };
+        buffer.append(reinterpret_cast<const char*>(record), sizeof(record));
+    }
+
+    const string temporary = path + ".tmp";
+    int descriptor = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0)
+        throw runtime_error("Error: Could not create checkpoint " + temporary + ".");
+    const char* cursor = buffer.data();
+    size_t remaining = buffer.size();
+    while (remaining > 0) {
+        ssize_t written = write(descriptor, cursor, remaining);
+        if (written < 0) {
+            close(descriptor);
+            unlink(temporary.c_str());
+            throw runtime_error("Error: Could not write checkpoint " + temporary + ".");
+        }
+        cursor += written;
+        remaining -= size_t(written);
+    }
+    // the data has to be on disk before the rename makes it the checkpoint
+    bool synced = fsync(descriptor) == 0;
+    if (close(descriptor) != 0 || !synced || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        throw runtime_error("Error: Could not write checkpoint " + path + ".");
+    }
+}
+
+Checkpoint readCheckpoint(const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open())
+        throw runtime_error("Error: Could not open checkpoint " + path + ".");
+    string buffer(size_t(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(buffer.data(), streamsize(buffer.size()));
+    if (!file || buffer.size() < HEADER_SIZE || memcmp(buffer.data(), Checkpoint::MAGIC, sizeof(Checkpoint::MAGIC)))
+        throw runtime_error("Error: " + path + " is not a checkpoint.");
+
+    const char* cursor = buffer.data() + sizeof(Checkpoint::MAGIC);
+    if (take<uint16_t>(cursor) != Checkpoint::VERSION)
+        throw runtime_error("Error: Unsupported checkpoint version in " + path + ".");
+    Checkpoint checkpoint;
+    checkpoint.step = take<uint64_t>(cursor);
+    const uint64_t count = take<uint64_t>(cursor);
+    checkpoint.state.time = take<double>(cursor);
+    checkpoint.dt = take<double>(cursor);
+    checkpoint.theta = take<double>(cursor);
+    if (buffer.size() != HEADER_SIZE + count * VALUES_PER_BODY * sizeof(double))
+        throw runtime_error("Error: Checkpoint " + path + " is truncated.");
+    checkpoint.state.bodies.resize(count);
+    for (Body& body : checkpoint.state.bodies) {
+        double record[VALUES_PER_BODY];
+        memcpy(record, cursor, sizeof(record));
+        cursor += sizeof(record);
+        // checkpoints always hold doubles, whatever the build's precision
+        body = Body(
+            Real(record[0]), Vec3T<double>{record[1], record[2], record[3]}.to<Real>(),
+            Vec3T<double>{record[4], record[5], record[6]}.to<Real>(),
+            Vec3T<double>{record[7], record[8], record[9]}.to<Real>()
+        );
+    }
+    return checkpoint;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+
+#include "nbsim/core/snapshot/snapshot.hpp"
+
+/**
+ * Everything needed to continue a simulation exactly where it stopped.
+ *
+ * Checkpoint files start with the magic bytes "NBCKPT" and the format version
+ * as a uint16, followed by step and body count as uint64 and time, time step
+ * and theta as doubles. Then come mass, position, velocity and acceleration of
+ * every body as doubles, in insertion order. All values are stored in the
+ * byte order of the writing machine.
+ */
+struct Checkpoint {
+    uint64_t step;  // Number of steps simulated so far
+    double dt;      // Time step of the simulation
+    double theta;   // Opening parameter of the simulation
+    Snapshot state; // Time and state of every body, with ids left empty
+
+    // Magic bytes at the start of a checkpoint file
+    static constexpr char MAGIC[6] = {'N', 'B', 'C', 'K', 'P', 'T'};
+    // Version of the file layout
+    static constexpr uint16_t VERSION = 1;
+};
+
+// Writes checkpoint to the file at path. The file is first written and synced
+// under a temporary name and then renamed over path, so an interrupted write
+// never leaves a partial checkpoint behind. Throws std::runtime_error if
+// writing fails.
+void writeCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+
+// Reads the checkpoint stored in the file at path. Throws std::runtime_error
+// if the file cannot be read or is not a complete checkpoint.
+Checkpoint readCheckpoint(const std::string& path);
+
+#endif
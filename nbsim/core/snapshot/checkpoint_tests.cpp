@@ -0,0 +1,59 @@
+#include "nbsim/core/snapshot/checkpoint.hpp"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+class TestCheckpoint : public ::testing::Test {
+  protected:
+    TestCheckpoint() = default;
+    ~TestCheckpoint() override { remove(path.c_str()); }
+    const string path = testing::TempDir() + "checkpoint_test.bin";
+};
+
+TEST_F(TestCheckpoint, RoundTripsExactly) {
+    Checkpoint checkpoint{12, 0.25, 0.7, Snapshot{3.0 / 7, {}, {}}};
+    for (int i = 0; i < 100; i++) {
+        Real value = Real(1.0 / (i + 3));
+        checkpoint.state.bodies.push_back(Body(
+            value * 1e28, Vec3{value, -value * Real(1e15), 2}, Vec3{value * 3, 0, -1},
+            Vec3{-value * Real(1e-9), 4, value}
+        ));
+    }
+    writeCheckpoint(path, checkpoint);
+    Checkpoint read = readCheckpoint(path);
+    EXPECT_EQ(read.step, 12);
+    EXPECT_EQ(read.dt, 0.25);
+    EXPECT_EQ(read.theta, 0.7);
+    EXPECT_EQ(read.state.time, 3.0 / 7);
+    ASSERT_EQ(read.state.bodies.size(), checkpoint.state.bodies.size());
+    for (size_t i = 0; i < read.state.bodies.size(); i++) {
+        EXPECT_EQ(read.state.bodies[i].mass, checkpoint.state.bodies[i].mass);
+        EXPECT_EQ(read.state.bodies[i].position, checkpoint.state.bodies[i].position);
+        EXPECT_EQ(read.state.bodies[i].velocity, checkpoint.state.bodies[i].velocity);
+        EXPECT_EQ(read.state.bodies[i].acceleration, checkpoint.state.bodies[i].acceleration);
+    }
+    // the temporary file is gone once the checkpoint is in place
+    EXPECT_FALSE(ifstream(path + ".tmp").is_open());
+}
+
+TEST_F(TestCheckpoint, RejectsDamagedFiles) {
+    EXPECT_THROW(readCheckpoint(path), std::runtime_error);
+    Checkpoint checkpoint{1, 1, 0.5, Snapshot{0, {Body(1, Vec3{1, 2, 3}, Vec3{}, Vec3{})}, {}}};
+    writeCheckpoint(path, checkpoint);
+    string contents;
+    {
+        ifstream file(path, ios::binary);
+        contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    ofstream(path, ios::binary) << contents.substr(0, contents.size() - 8);
+    EXPECT_THROW(readCheckpoint(path), std::runtime_error);
+    ofstream(path, ios::binary) << "{\"history\":[]}";
+    EXPECT_THROW(readCheckpoint(path), std::runtime_error);
+}
+
+TEST_F(TestCheckpoint, ReportsUnwritablePath) {
+    Checkpoint checkpoint{0, 1, 0.5, Snapshot{0, {}, {}}};
+    EXPECT_THROW(writeCheckpoint(testing::TempDir() + "missing/dir/checkpoint.bin", checkpoint), std::runtime_error);
+}
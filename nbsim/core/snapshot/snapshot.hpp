@@ -0,0 +1,40 @@
+#pragma once
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "nbsim/core/octree/body.hpp"
+
+/**
+ * State of a simulation, or of a selection of its bodies, at one point in
+ * time.
+ *
+ * Binary snapshot files start with a 16 byte header:
+ *   - the magic bytes "NBSNAP",
+ *   - the format version as a uint16,
+ *   - the size of every body value in bytes, 4 or 8, as a uint32,
+ *   - the SnapshotField flags of the values stored per body as a uint32.
+ * Each snapshot follows as its time as a double and its body count as a
+ * uint64, and then one fixed-width record per body. A record holds the id of
+ * the body as a uint64 if selected, then the selected values as floats or
+ * doubles, in the order of SnapshotField. All values are stored in the byte
+ * order of the writing machine.
+ *
+ * Version 1 files store the number of values per body, always 10, in place of
+ * the fields, and every record holds mass, position, velocity and
+ * acceleration.
+ */
+struct Snapshot {
+    double time;               // Simulation time the state was taken at
+    std::vector<Body> bodies;  // State of every body
+    std::vector<uint32_t> ids; // Id of every body. If empty, ids count up from zero.
+
+    // Magic bytes at the start of a binary snapshot file
+    static constexpr char MAGIC[6] = {'N', 'B', 'S', 'N', 'A', 'P'};
+    // Version of the binary layout
+    static constexpr uint16_t VERSION = 2;
+};
+
+#endif
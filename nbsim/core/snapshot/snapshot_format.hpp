@@ -0,0 +1,40 @@
+#pragma once
+#ifndef SNAPSHOT_FORMAT_H
+#define SNAPSHOT_FORMAT_H
+
+#include <cstdint>
+
+/**
+ * Encoding of simulation snapshots in output files
+ */
+enum class SnapshotFormat : char {
+    JSON,    // One JSON document holding every snapshot, 5 significant digits
+    FLOAT32, // Binary records of single precision values
+    FLOAT64  // Binary records of double precision values
+};
+
+/**
+ * Values written for every body of a snapshot, combined as bit flags. Values
+ * are always written in the order listed here.
+ */
+enum SnapshotField : uint32_t {
+    FIELD_ID = 1 << 0,          // Id of the body, its position in insertion order
+    FIELD_MASS = 1 << 1,        // Mass
+    FIELD_POSITION = 1 << 2,    // Position, as x, y and z
+    FIELD_VELOCITY = 1 << 3,    // Velocity, as x, y and z
+    FIELD_ACCELERATION = 1 << 4 // Acceleration, as x, y and z
+};
+
+// Fields written unless chosen otherwise
+constexpr uint32_t DEFAULT_FIELDS = FIELD_MASS | FIELD_POSITION | FIELD_VELOCITY | FIELD_ACCELERATION;
+// Every field
+constexpr uint32_t ALL_FIELDS = FIELD_ID | DEFAULT_FIELDS;
+
+// Returns the number of floating point values per body for the given fields,
+// which excludes the id
+constexpr uint32_t valueCount(uint32_t fields) {
+    return ((fields & FIELD_MASS) ? 1 : 0) + ((fields & FIELD_POSITION) ? 3 : 0) +
+           ((fields & FIELD_VELOCITY) ? 3 : 0) + ((fields & FIELD_ACCELERATION) ? 3 : 0);
+}
+
+#endif
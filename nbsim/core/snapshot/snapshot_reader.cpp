@@ -0,0 +1,83 @@
+#include "nbsim/core/snapshot/snapshot_reader.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+SnapshotReader::SnapshotReader(istream& in) : in{in} {
+    char magic[sizeof(Snapshot::MAGIC)];
+    uint16_t version = 0;
+    uint32_t valueSize = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&valueSize), sizeof(valueSize));
+    in.read(reinterpret_cast<char*>(&fields), sizeof(fields));
+    if (!in || memcmp(magic, Snapshot::MAGIC, sizeof(magic)) != 0)
+        throw runtime_error("Error: Input is not a binary snapshot file.");
+    // version 1 stored the number of values per body instead of the fields
+    if (version == 1 && fields == valueCount(DEFAULT_FIELDS))
+        fields = DEFAULT_FIELDS;
+    else if (version != Snapshot::VERSION || fields == 0 || (fields & ~ALL_FIELDS) != 0)
+        throw runtime_error("Error: Unsupported binary snapshot version.");
+    if (valueSize == sizeof(float))
+        format = SnapshotFormat::FLOAT32;
+    else if (valueSize == sizeof(double))
+        format = SnapshotFormat::FLOAT64;
+    else
+        throw runtime_error("Error: Unsupported binary snapshot precision.");
+}
+
+bool SnapshotReader::read(Snapshot& snapshot) {
+    uint64_t count = 0;
+    if (!in.read(reinterpret_cast<char*>(&snapshot.time), sizeof(double)))
+        return false;
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    const size_t valueSize = format == SnapshotFormat::FLOAT32 ? sizeof(float) : sizeof(double);
+    const size_t idSize = (fields & FIELD_ID) ? sizeof(uint64_t) : 0;
+    buffer.resize(count * (idSize + valueCount(fields) * valueSize));
+    in.read(buffer.data(), streamsize(buffer.size()));
+    if (!in)
+        throw runtime_error("Error: Binary snapshot file ends within a snapshot.");
+    if (format == SnapshotFormat::FLOAT32)
+        decode<float>(count, snapshot);
+    else
+        decode<double>(count, snapshot);
+    return true;
+}
+
+SnapshotFormat SnapshotReader::getFormat() const { return format; }
+
+uint32_t SnapshotReader::getFields() const { return fields; }
+
+template <typename T> void SnapshotReader::decode(size_t count, Snapshot& snapshot) const {
+    snapshot.bodies.assign(count, Body());
+    snapshot.ids.clear();
+    const char* cursor = buffer.data();
+    const size_t valueSize = valueCount(fields) * sizeof(T);
+    T record[10];
+    for (size_t i = 0; i < count; i++) {
+        if (fields & FIELD_ID) {
+            uint64_t id;
+            memcpy(&id, cursor, sizeof(uint64_t));
+            snapshot.ids.push_back(uint32_t(id));
+            cursor += sizeof(uint64_t);
+        }
+        memcpy(record, cursor, valueSize);
+        cursor += valueSize;
+        const T* value = record;
+        Body& body = snapshot.bodies[i];
+        if (fields & FIELD_MASS)
+            body.mass = Real(*value++);
+        if (fields & FIELD_POSITION) {
+            body.position = Vec3T<T>{value[0], value[1], value[2]}.template to<Real>();
+            value += 3;
+        }
+        if (fields & FIELD_VELOCITY) {
+            body.velocity = Vec3T<T>{value[0], value[1], value[2]}.template to<Real>();
+            value += 3;
+        }
+        if (fields & FIELD_ACCELERATION)
+            body.acceleration = Vec3T<T>{value[0], value[1], value[2]}.template to<Real>();
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef SNAPSHOT_READER_H
+#define SNAPSHOT_READER_H
+
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+#include "nbsim/core/snapshot/snapshot.hpp"
+#include "nbsim/core/snapshot/snapshot_format.hpp"
+
+/**
+ * Reads snapshots back from a binary snapshot file, one at a time. JSON
+ * output cannot be read back.
+ */
+class SnapshotReader {
+  private:
+    std::istream& in;         // stream to read from
+    SnapshotFormat format;    // encoding of the input
+    uint32_t fields;          // SnapshotField flags of the values stored per body
+    std::vector<char> buffer; // raw records of the current snapshot
+    // Reads count records with values of type T from buffer into snapshot
+    template <typename T> void decode(size_t count, Snapshot& snapshot) const;
+
+  public:
+    // Reads the file header from in. Throws std::runtime_error if in does not
+    // hold a binary snapshot file of a supported version.
+    explicit SnapshotReader(std::istream& in);
+    // Reads the next snapshot into snapshot. Fields not stored in the file are
+    // zero, and ids are left empty unless stored. Returns false at the end of
+    // the input. Throws std::runtime_error if the input ends within a
+    // snapshot.
+    bool read(Snapshot& snapshot);
+    // Returns the encoding of the input
+    SnapshotFormat getFormat() const;
+    // Returns the SnapshotField flags of the values stored per body
+    uint32_t getFields() const;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "nbsim/core/snapshot/snapshot_reader.hpp"
+#include "nbsim/core/snapshot/snapshot_writer.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace std;
+
+class TestSnapshot : public ::testing::Test {
+  protected:
+    TestSnapshot() = default;
+    Snapshot makeSnapshot(double time) {
+        Snapshot snapshot{time, {}, {}};
+        snapshot.bodies.push_back(Body(1e28 / 3, Vec3{1.0 / 3, -2e20, 5}, Vec3{0.1, 0.2, 0.3}, Vec3{-1e-9, 0, 7}));
+        snapshot.bodies.push_back(Body(2, Vec3{4, 5, 6}, Vec3{7, 8, 9}, Vec3{10, 11, 12}));
+        return snapshot;
+    }
+};
+
+TEST_F(TestSnapshot, JsonWrapsSnapshotsInHistory) {
+    ostringstream out;
+    SnapshotWriter writer(out, SnapshotFormat::JSON);
+    writer.begin();
+    Snapshot snapshot{1.5, {Body(2, Vec3{1, 2, 3}, Vec3{4, 5, 6}, Vec3{7, 8, 9})}, {}};
+    writer.write(snapshot);
+    writer.write(snapshot);
+    writer.end();
+    const string frame = "{\"time\":1.5,\"bodies\":[{\"mass\":2,\"position\":{\"x\":1,\"y\":2,\"z\":3},"
+                         "\"velocity\":{\"x\":4,\"y\":5,\"z\":6},\"acceleration\":{\"x\":7,\"y\":8,\"z\":9}}]}";
+    EXPECT_EQ(out.str(), "{\"history\":[" + frame + "," + frame + "]}");
+}
+
+TEST_F(TestSnapshot, Float64RoundTripsExactly) {
+    stringstream stream;
+    SnapshotWriter writer(stream, SnapshotFormat::FLOAT64);
+    writer.begin();
+    writer.write(makeSnapshot(0));
+    writer.write(makeSnapshot(10));
+    writer.end();
+
+    SnapshotReader reader(stream);
+    EXPECT_EQ(reader.getFormat(), SnapshotFormat::FLOAT64);
+    Snapshot read;
+    for (double time : {0.0, 10.0}) {
+        ASSERT_TRUE(reader.read(read));
+        const Snapshot expected = makeSnapshot(time);
+        EXPECT_EQ(read.time, time);
+        ASSERT_EQ(read.bodies.size(), expected.bodies.size());
+        for (size_t i = 0; i < expected.bodies.size(); i++) {
+            EXPECT_EQ(read.bodies[i].mass, expected.bodies[i].mass);
+            EXPECT_EQ(read.bodies[i].position, expected.bodies[i].position);
+            EXPECT_EQ(read.bodies[i].velocity, expected.bodies[i].velocity);
+            EXPECT_EQ(read.bodies[i].acceleration, expected.bodies[i].acceleration);
+        }
+    }
+    EXPECT_FALSE(reader.read(read));
+}
+
+TEST_F(TestSnapshot, Float32HasFixedWidthRecords) {
+    stringstream stream;
+    SnapshotWriter writer(stream, SnapshotFormat::FLOAT32);
+    writer.begin();
+    writer.write(makeSnapshot(3));
+    writer.end();
+    const size_t header = 16;
+    const size_t frame = sizeof(double) + sizeof(uint64_t) + 2 * valueCount(DEFAULT_FIELDS) * sizeof(float);
+    EXPECT_EQ(stream.str().size(), header + frame);
+
+    SnapshotReader reader(stream);
+    EXPECT_EQ(reader.getFormat(), SnapshotFormat::FLOAT32);
+    Snapshot read;
+    ASSERT_TRUE(reader.read(read));
+    const Snapshot expected = makeSnapshot(3);
+    EXPECT_EQ(read.time, 3);
+    ASSERT_EQ(read.bodies.size(), 2);
+    EXPECT_FLOAT_EQ(read.bodies[0].mass, expected.bodies[0].mass);
+    EXPECT_FLOAT_EQ(read.bodies[0].position.x, expected.bodies[0].position.x);
+    EXPECT_FLOAT_EQ(read.bodies[0].acceleration.x, expected.bodies[0].acceleration.x);
+    EXPECT_EQ(read.bodies[1].velocity, expected.bodies[1].velocity);
+}
+
+TEST_F(TestSnapshot, WritesOnlySelectedFields) {
+    Snapshot snapshot{2, {Body(2, Vec3{1, 2, 3}, Vec3{4, 5, 6}, Vec3{7, 8, 9})}, {42}};
+    ostringstream json;
+    SnapshotWriter jsonWriter(json, SnapshotFormat::JSON, FIELD_ID | FIELD_POSITION);
+    jsonWriter.begin();
+    jsonWriter.write(snapshot);
+    jsonWriter.end();
+    EXPECT_EQ(
+        json.str(), "{\"history\":[{\"time\":2,\"bodies\":[{\"id\":42,\"position\":{\"x\":1,\"y\":2,\"z\":3}}]}]}"
+    );
+
+    stringstream binary;
+    SnapshotWriter binaryWriter(binary, SnapshotFormat::FLOAT64, FIELD_ID | FIELD_VELOCITY);
+    binaryWriter.begin();
+    binaryWriter.write(snapshot);
+    binaryWriter.end();
+    EXPECT_EQ(binary.str().size(), 16 + 16 + sizeof(uint64_t) + 3 * sizeof(double));
+    SnapshotReader reader(binary);
+    EXPECT_EQ(reader.getFields(), FIELD_ID | FIELD_VELOCITY);
+    Snapshot read;
+    ASSERT_TRUE(reader.read(read));
+    ASSERT_EQ(read.bodies.size(), 1);
+    EXPECT_EQ(read.ids, vector<uint32_t>{42});
+    EXPECT_EQ(read.bodies[0].velocity, (Vec3{4, 5, 6}));
+    EXPECT_EQ(read.bodies[0].mass, 0);
+    EXPECT_EQ(read.bodies[0].position, (Vec3{0, 0, 0}));
+
+    EXPECT_THROW(SnapshotWriter(binary, SnapshotFormat::JSON, 0), std::runtime_error);
+}
+
+TEST_F(TestSnapshot, ReadsVersionOneFiles) {
+    stringstream stream;
+    stream.write(Snapshot::MAGIC, sizeof(Snapshot::MAGIC));
+    const uint16_t version = 1;
+    const uint32_t header[2] = {sizeof(double), 10};
+    stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+    const double time = 4;
+    const uint64_t count = 1;
+    const double record[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    stream.write(reinterpret_cast<const char*>(&time), sizeof(time));
+    stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    stream.write(reinterpret_cast<const char*>(record), sizeof(record));
+
+    SnapshotReader reader(stream);
+    EXPECT_EQ(reader.getFields(), DEFAULT_FIELDS);
+    Snapshot read;
+    ASSERT_TRUE(reader.read(read));
+    EXPECT_EQ(read.time, 4);
+    ASSERT_EQ(read.bodies.size(), 1);
+    EXPECT_EQ(read.bodies[0].mass, 1);
+    EXPECT_EQ(read.bodies[0].acceleration, (Vec3{8, 9, 10}));
+    EXPECT_TRUE(read.ids.empty());
+}
+
+TEST_F(TestSnapshot, ReaderRejectsOtherInput) {
+    istringstream json("{\"history\":[]}");
+    EXPECT_THROW(SnapshotReader reader(json), std::runtime_error);
+
+    stringstream truncated;
+    SnapshotWriter writer(truncated, SnapshotFormat::FLOAT64);
+    writer.begin();
+    writer.write(makeSnapshot(0));
+    string bytes = truncated.str();
+    istringstream cut(bytes.substr(0, bytes.size() - 4));
+    SnapshotReader reader(cut);
+    Snapshot read;
+    EXPECT_THROW(reader.read(read), std::runtime_error);
+}
@@ -0,0 +1,152 @@
+#include "nbsim/core/snapshot/snapshot_writer.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+// Appends the raw bytes of value to buffer
+template <typename T> void append(string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+} // namespace
+
+SnapshotWriter::SnapshotWriter(ostream& out, SnapshotFormat format, uint32_t fields)
+    : out{out},
+      format{format},
+      fields{fields & ALL_FIELDS} {
+    if (this->fields == 0)
+        throw runtime_error("Error: Snapshots must hold at least one field.");
+}
+
+void SnapshotWriter::begin() {
+    written = 0;
+    if (format == SnapshotFormat::JSON) {
+        out << "{\"history\":[";
+        return;
+    }
+    buffer.clear();
+    buffer.append(Snapshot::MAGIC, sizeof(Snapshot::MAGIC));
+    append(buffer, Snapshot::VERSION);
+    append(buffer, uint32_t(format == SnapshotFormat::FLOAT32 ? sizeof(float) : sizeof(double)));
+    append(buffer, fields);
+    out.write(buffer.data(), streamsize(buffer.size()));
+}
+
+void SnapshotWriter::write(const Snapshot& snapshot) {
+    buffer.clear();
+    switch (format) {
+    case SnapshotFormat::JSON:
+        if (written > 0)
+            buffer += ',';
+        encodeJson(snapshot);
+        break;
+    case SnapshotFormat::FLOAT32:
+        encodeBinary<float>(snapshot);
+        break;
+    case SnapshotFormat::FLOAT64:
+        encodeBinary<double>(snapshot);
+        break;
+    }
+    out.write(buffer.data(), streamsize(buffer.size()));
+    if (!out)
+        throw runtime_error("Error: Could not write snapshot to output.");
+    written++;
+}
+
+void SnapshotWriter::end() {
+    if (format == SnapshotFormat::JSON)
+        out << "]}";
+    out.flush();
+    if (!out)
+        throw runtime_error("Error: Could not write snapshot to output.");
+}
+
+SnapshotFormat SnapshotWriter::getFormat() const { return format; }
+
+void SnapshotWriter::encodeJson(const Snapshot& snapshot) {
+    ostringstream stringBuilder;
+    stringBuilder << setprecision(5); // set decimal precision to 5 pts
+    stringBuilder << "{\"time\":" << snapshot.time << ",";
+    stringBuilder << "\"bodies\":[";
+    for (size_t index = 0; index < snapshot.bodies.size(); index++) {
+        const Body& object = snapshot.bodies[index];
+        // every field after the first is preceded by a comma
+        const char* separator = "";
+        stringBuilder << "{";
+        if (fields & FIELD_ID) {
+            stringBuilder << "\"id\":" << (snapshot.ids.empty() ? index : snapshot.ids[index]);
+            separator = ",";
+        }
+        if (fields & FIELD_MASS) {
+            stringBuilder << separator << "\"mass\":" << object.mass;
+            separator = ",";
+        }
+        if (fields & FIELD_POSITION) {
+            stringBuilder << separator << "\"position\":{"
+                          << "\"x\":" << object.position.x << ",\"y\":" << object.position.y
+                          << ",\"z\":" << object.position.z << "}";
+            separator = ",";
+        }
+        if (fields & FIELD_VELOCITY) {
+            stringBuilder << separator << "\"velocity\":{"
+                          << "\"x\":" << object.velocity.x << ",\"y\":" << object.velocity.y
+                          << ",\"z\":" << object.velocity.z << "}";
+            separator = ",";
+        }
+        if (fields & FIELD_ACCELERATION) {
+            stringBuilder << separator << "\"acceleration\":{"
+                          << "\"x\":" << object.acceleration.x << ",\"y\":" << object.acceleration.y
+                          << ",\"z\":" << object.acceleration.z << "}";
+        }
+        stringBuilder << "}";
+        if (index < snapshot.bodies.size() - 1)
+            stringBuilder << ",";
+    }
+    stringBuilder << "]}";
+    buffer += stringBuilder.str();
+}
+
+template <typename T> void SnapshotWriter::encodeBinary(const Snapshot& snapshot) {
+    const size_t header = sizeof(double) + sizeof(uint64_t);
+    const size_t idSize = (fields & FIELD_ID) ? sizeof(uint64_t) : 0;
+    const size_t valueSize = valueCount(fields) * sizeof(T);
+    buffer.resize(header + snapshot.bodies.size() * (idSize + valueSize));
+    char* cursor = buffer.data();
+    const uint64_t count = snapshot.bodies.size();
+    memcpy(cursor, &snapshot.time, sizeof(double));
+    memcpy(cursor + sizeof(double), &count, sizeof(uint64_t));
+    cursor += header;
+    for (size_t index = 0; index < snapshot.bodies.size(); index++) {
+        const Body& body = snapshot.bodies[index];
+        if (idSize) {
+            const uint64_t id = snapshot.ids.empty() ? index : snapshot.ids[index];
+            memcpy(cursor, &id, sizeof(uint64_t));
+            cursor += sizeof(uint64_t);
+        }
+        T record[10];
+        T* value = record;
+        if (fields & FIELD_MASS)
+            *value++ = T(body.mass);
+        if (fields & FIELD_POSITION) {
+            *value++ = T(body.position.x);
+            *value++ = T(body.position.y);
+            *value++ = T(body.position.z);
+        }
+        if (fields & FIELD_VELOCITY) {
+            *value++ = T(body.velocity.x);
+            *value++ = T(body.velocity.y);
+            *value++ = T(body.velocity.z);
+        }
+        if (fields & FIELD_ACCELERATION) {
+            *value++ = T(body.acceleration.x);
+            *value++ = T(body.acceleration.y);
+            *value++ = T(body.acceleration.z);
+        }
+        memcpy(cursor, record, valueSize);
+        cursor += valueSize;
+    }
+}
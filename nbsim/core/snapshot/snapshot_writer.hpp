@@ -0,0 +1,49 @@
+#pragma once
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "nbsim/core/snapshot/snapshot.hpp"
+#include "nbsim/core/snapshot/snapshot_format.hpp"
+
+/**
+ * Writes a sequence of snapshots to a stream in one of the SnapshotFormat
+ * encodings. Call begin() once, write() for every snapshot and end() once.
+ *
+ * JSON output is a single {"history":[...]} document. Binary output is laid
+ * out as described on Snapshot, and every body is a fixed-width record, so
+ * writing it is a plain copy of the values. Either way only the chosen fields
+ * of every body are encoded.
+ */
+class SnapshotWriter {
+  private:
+    std::ostream& out;     // stream to write to
+    SnapshotFormat format; // encoding of the output
+    uint32_t fields;       // SnapshotField flags of the values written per body
+    size_t written = 0;    // number of snapshots written so far
+    std::string buffer;    // encoded snapshot, reused between writes
+    // Encodes snapshot as a JSON object into buffer
+    void encodeJson(const Snapshot& snapshot);
+    // Encodes snapshot as a binary record with values of type T into buffer
+    template <typename T> void encodeBinary(const Snapshot& snapshot);
+
+  public:
+    // Creates a writer to out, writing the given SnapshotField flags of every
+    // body. Binary formats should be written to a stream opened in binary
+    // mode. Throws std::runtime_error if no field is chosen.
+    SnapshotWriter(std::ostream& out, SnapshotFormat format, uint32_t fields = DEFAULT_FIELDS);
+    // Writes the start of the output
+    void begin();
+    // Writes a single snapshot. Throws std::runtime_error if the stream fails.
+    void write(const Snapshot& snapshot);
+    // Writes the end of the output and flushes the stream. Throws
+    // std::runtime_error if the stream fails.
+    void end();
+    // Returns the encoding of the output
+    SnapshotFormat getFormat() const;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "nbsim/core/testing/random_bodies.hpp"
+
+#include <random>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include "nbsim/core/gravity/interaction_list.hpp"
+
+using namespace std;
+
+vector<Body> randomBodies(size_t count, unsigned seed) {
+    mt19937 twister(seed);
+    normal_distribution<Real> positionGen(0, 1e12);
+    uniform_real_distribution<double> massGen(1e20, 1e28);
+    vector<Body> bodies;
+    for (size_t i = 0; i < count; i++) {
+        Vec3 position{positionGen(twister), positionGen(twister), positionGen(twister)};
+        bodies.push_back(Body(massGen(twister), position, Vec3{0, 0, 0}, Vec3{0, 0, 0}));
+    }
+    return bodies;
+}
+
+vector<Vec3> directAccelerations(const vector<Body>& bodies) {
+    InteractionList list;
+    for (const Body& body : bodies) {
+        list.pushBody(body.mass, body.position);
+    }
+    vector<Vec3> accelerations;
+    for (const Body& body : bodies) {
+        accelerations.push_back(accelerationGravity(list, body.position));
+    }
+    return accelerations;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#ifndef RANDOM_BODIES_H
+#define RANDOM_BODIES_H
+
+#include <cstddef>
+#include <vector>
+
+#include "nbsim/core/octree/body.hpp"
+#include "nbsim/core/vec3/vec3.hpp"
+
+// Fixtures shared by the tests of the force solvers and the engine
+
+// Returns count bodies at rest, normally distributed around the origin with a
+// spread of 1e12 meters and masses between 1e20 and 1e28 kilograms
+std::vector<Body> randomBodies(size_t count, unsigned seed);
+
+// Returns the acceleration of every body from a direct sum over all others,
+// indexed like bodies
+std::vector<Vec3> directAccelerations(const std::vector<Body>& bodies);
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef SCALAR_H
+#define SCALAR_H
+
+// Floating point types of the simulation, chosen at build time:
+//  - by default, everything is computed in double precision
+//  - NBSIM_FLOAT computes everything in single precision, which halves the
+//    memory taken by bodies and trees and doubles the width of the gravity
+//    kernels
+//  - NBSIM_MIXED keeps bodies, trees and integration in double precision but
+//    evaluates the field of tree nodes in single precision, accumulating the
+//    resulting accelerations in double precision. Bodies acting on each other
+//    directly are still evaluated in double precision, as single precision
+//    would round away the offsets of nearby bodies far from the origin.
+//
+// Single precision spans magnitudes up to about 3e38 and resolves about 7
+// significant digits, so positions far from the origin move in coarse steps.
+// Values whose intermediates exceed that range, like centers of mass,
+// quadrupole moments and FMM expansions, are always computed in double
+// precision.
+#if defined(NBSIM_FLOAT) && defined(NBSIM_MIXED)
+#error "NBSIM_FLOAT and NBSIM_MIXED are mutually exclusive"
+#endif
+
+#if defined(NBSIM_FLOAT) || defined(NBSIM_MIXED)
+// Defined if gravity kernels evaluate sources in single precision
+#define NBSIM_FLOAT_FIELD
+#endif
+
+#ifdef NBSIM_FLOAT
+// Scalar of the state of bodies and tree nodes, and of accumulated
+// accelerations
+using Real = float;
+#else
+using Real = double;
+#endif
+
+#ifdef NBSIM_FLOAT_FIELD
+// Scalar of sources standing in for groups of bodies, like tree nodes, as
+// handed to gravity kernels, and of the terms they sum
+using FieldReal = float;
+#else
+using FieldReal = double;
+#endif
+
+#endif
@@ -1,6 +1,9 @@
 #include "nbsim/core/vec3/vec3.hpp"
 
-std::ostream& operator<<(std::ostream& os, const Vec3& vec) {
+template <typename T> std::ostream& operator<<(std::ostream& os, const Vec3T<T>& vec) {
     os << "[" << vec.x << "," << vec.y << "," << vec.z << "]";
     return os;
-}
\ No newline at end of file
+}
+
+template std::ostream& operator<<(std::ostream& os, const Vec3T<float>& vec);
+template std::ostream& operator<<(std::ostream& os, const Vec3T<double>& vec);
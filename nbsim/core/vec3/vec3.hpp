@@ -5,16 +5,19 @@
 #include <cmath>
 #include <ostream>
 
+#include "nbsim/core/vec3/scalar.hpp"
+
 /*
-A 3D Vector to represent locations in simulation space
+A 3D Vector to represent locations in simulation space, with components of
+type T
 */
-struct Vec3 {
-    double x; // x component of vector
-    double y; // y component of vector
-    double z; // z component of vector
+template <typename T> struct Vec3T {
+    T x; // x component of vector
+    T y; // y component of vector
+    T z; // z component of vector
 
     // vector addition
-    Vec3& operator+=(const Vec3& other) {
+    Vec3T& operator+=(const Vec3T& other) {
         if (this == &other) {
             *this = *this * 2;
             return *this;
@@ -26,41 +29,41 @@ struct Vec3 {
     }
 
     // reuse += operator b/c DRY code is good
-    Vec3 operator+(const Vec3& other) {
-        Vec3 copy = *this;
+    Vec3T operator+(const Vec3T& other) {
+        Vec3T copy = *this;
         copy += other;
         return copy;
     }
 
     // const version of operator
-    Vec3 operator+(const Vec3& other) const {
-        Vec3 copy = *this;
+    Vec3T operator+(const Vec3T& other) const {
+        Vec3T copy = *this;
         copy += other;
         return copy;
     }
 
     // vector subtraction
-    Vec3& operator-=(const Vec3& other) {
+    Vec3T& operator-=(const Vec3T& other) {
         *this += (other * -1);
         return *this;
     }
 
     // reuse -= operator b/c DRY code is good
-    Vec3 operator-(const Vec3& other) {
-        Vec3 copy = *this;
+    Vec3T operator-(const Vec3T& other) {
+        Vec3T copy = *this;
         copy -= other;
         return copy;
     }
 
     // const version of operator
-    Vec3 operator-(const Vec3& other) const {
-        Vec3 copy = *this;
+    Vec3T operator-(const Vec3T& other) const {
+        Vec3T copy = *this;
         copy -= other;
         return copy;
     }
 
     // scalar multiplication
-    Vec3& operator*=(const double value) {
+    Vec3T& operator*=(const T value) {
         x *= value;
         y *= value;
         z *= value;
@@ -68,49 +71,55 @@ struct Vec3 {
     }
 
     // reuse *= operator b/c DRY code is good
-    Vec3 operator*(const double value) {
-        Vec3 copy = *this;
+    Vec3T operator*(const T value) {
+        Vec3T copy = *this;
         copy *= value;
         return copy;
     }
 
     // const version of operator
-    Vec3 operator*(const double value) const {
-        Vec3 copy = *this;
+    Vec3T operator*(const T value) const {
+        Vec3T copy = *this;
         copy *= value;
         return copy;
     }
 
     // scalar division
-    Vec3& operator/=(const double value) {
-        *this *= 1 / float(value);
+    Vec3T& operator/=(const T value) {
+        *this *= 1 / value;
         return *this;
     }
 
     // reuse /= operator b/c DRY code is good
-    Vec3 operator/(const double value) {
-        Vec3 copy = *this;
+    Vec3T operator/(const T value) {
+        Vec3T copy = *this;
         copy /= value;
         return copy;
     }
 
     // const version of operator
-    Vec3 operator/(const double value) const {
-        Vec3 copy = *this;
+    Vec3T operator/(const T value) const {
+        Vec3T copy = *this;
         copy /= value;
         return copy;
     }
 
     // vector equality
-    bool operator==(const Vec3& other) const { return x == other.x && y == other.y && z == other.z; }
+    bool operator==(const Vec3T& other) const { return x == other.x && y == other.y && z == other.z; }
 
-    bool operator!=(const Vec3& other) const { return !(*this == other); }
+    bool operator!=(const Vec3T& other) const { return !(*this == other); }
 
     // Returns the length of the vector
-    double length() { return sqrt((x * x) + (y * y) + (z * z)); }
+    T length() const { return std::sqrt((x * x) + (y * y) + (z * z)); }
 
-    // Write to output stream overload
-    friend std::ostream& operator<<(std::ostream& os, const Vec3& vec);
+    // Returns the vector with its components converted to type U
+    template <typename U> Vec3T<U> to() const { return Vec3T<U>{U(x), U(y), U(z)}; }
 };
 
+// Write to output stream overload
+template <typename T> std::ostream& operator<<(std::ostream& os, const Vec3T<T>& vec);
+
+// Vector of the precision chosen at build time
+using Vec3 = Vec3T<Real>;
+
 #endif
\ No newline at end of file
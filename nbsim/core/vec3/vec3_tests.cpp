@@ -171,3 +171,28 @@ TEST_F(Vec3Test, DebugPrintout) {
     os << vec;
     EXPECT_EQ(os.str(), result);
 }
+
+TEST_F(Vec3Test, DivisionKeepsDoublePrecision) {
+    Vec3T<double> vec{1, 2, 3};
+    Vec3T<double> result = vec / 3;
+    EXPECT_DOUBLE_EQ(result.x, 1.0 / 3);
+    EXPECT_DOUBLE_EQ(result.y, 2.0 / 3);
+    EXPECT_DOUBLE_EQ(result.z, 1);
+}
+
+TEST_F(Vec3Test, SinglePrecisionArithmetic) {
+    Vec3T<float> vec{1, 2, 2};
+    EXPECT_EQ(vec + vec, (Vec3T<float>{2, 4, 4}));
+    EXPECT_EQ(vec * 0.5f, (Vec3T<float>{0.5f, 1, 1}));
+    EXPECT_FLOAT_EQ(vec.length(), 3);
+    std::ostringstream os;
+    os << vec;
+    EXPECT_EQ(os.str(), "[1,2,2]");
+}
+
+TEST_F(Vec3Test, ConversionBetweenPrecisions) {
+    Vec3T<double> vec{1.0 / 3, -2, 1e20};
+    Vec3T<float> narrowed = vec.to<float>();
+    EXPECT_EQ(narrowed, (Vec3T<float>{1.0f / 3, -2, 1e20f}));
+    EXPECT_EQ(narrowed.to<double>().y, -2);
+}
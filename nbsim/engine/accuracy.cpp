@@ -0,0 +1,11 @@
+#include "nbsim/engine/accuracy.hpp"
+
+using namespace std;
+
+void ForceErrors::writeJson(ostream& out) const {
+    const uint64_t exact = bodies ? bodies - 1 : 0;
+    out << "{\"theta\":" << theta << ",\"bodies\":" << bodies << ",\"samples\":" << samples
+        << ",\"relativeError\":{\"median\":" << median << ",\"p90\":" << p90 << ",\"p99\":" << p99
+        << ",\"max\":" << max << "},\"interactionsPerBody\":{\"bodyNode\":" << bodyNode
+        << ",\"bodyBody\":" << bodyBody << ",\"total\":" << bodyNode + bodyBody << ",\"exact\":" << exact << "}}\n";
+}
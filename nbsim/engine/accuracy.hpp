@@ -0,0 +1,33 @@
+#pragma once
+#ifndef ACCURACY_H
+#define ACCURACY_H
+
+#include <cstdint>
+#include <ostream>
+
+/**
+ * Force errors of Barnes-Hut walks at one theta, measured on a sample of
+ * bodies against exact sums over all other bodies, along with the work the
+ * walks took.
+ *
+ * Errors are relative: the length of the difference between the walked and
+ * the exact acceleration over the length of the exact one. Bodies whose exact
+ * acceleration is zero are left out, and errors stay zero if no body is left.
+ */
+struct ForceErrors {
+    double theta = 0;     // opening parameter of the walks
+    uint64_t bodies = 0;  // bodies simulated
+    uint64_t samples = 0; // bodies whose forces were compared
+    double median = 0;    // median relative error
+    double p90 = 0;       // 90th percentile of the relative error
+    double p99 = 0;       // 99th percentile of the relative error
+    double max = 0;       // largest relative error
+    double bodyNode = 0;  // mean body-node interactions per sampled body
+    double bodyBody = 0;  // mean body-body interactions per sampled body
+
+    // Writes the errors and interaction counts as a JSON object. Counts are
+    // given next to the bodies - 1 interactions of an exact sum.
+    void writeJson(std::ostream& out) const;
+};
+
+#endif
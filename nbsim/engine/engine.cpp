@@ -1,102 +1,734 @@
 #include "nbsim/engine/engine.hpp"
 
-#include <iomanip>
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <iostream>
-#include <sstream>
+#include <random>
 #include <stack>
+#include <stdexcept>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
 
 using namespace std;
 
-Engine::Engine(double theta, double dt) : currentTime{0.0}, theta{theta}, dt{dt}, tree{} {}
+namespace {
+// Returns the value below which the given fraction of the sorted values lie
+double percentile(const vector<double>& sorted, double fraction) {
+    const size_t rank = size_t(ceil(fraction * double(sorted.size())));
+    return sorted[min(sorted.size(), max(rank, size_t(1))) - 1];
+}
+} // namespace
+
+Engine::Engine(double theta, double dt)
+    : currentTime{0.0},
+      theta{theta},
+      dt{dt},
+      tree{},
+      solver{ForceSolver::BARNES_HUT},
+      directThreshold{0},
+      treeCurrent{true},
+      groupSize{0},
+      integrator{Integrator::EULER},
+      accelerationsCurrent{false},
+      maxLevel{0},
+      levelAccuracy{0},
+      levelLength{0} {}
 
 Engine::Engine(double theta, double dt, double simulationWidth)
     : currentTime{0.0},
       theta{theta},
       dt{dt},
-      tree{Octree(simulationWidth)} {}
+      tree{Octree(simulationWidth)},
+      solver{ForceSolver::BARNES_HUT},
+      directThreshold{0},
+      treeCurrent{true},
+      groupSize{0},
+      integrator{Integrator::EULER},
+      accelerationsCurrent{false},
+      maxLevel{0},
+      levelAccuracy{0},
+      levelLength{0} {}
 
 Engine::Engine(double theta, double dt, std::vector<Body>& bodies)
     : currentTime{0.0},
       theta{theta},
       dt{dt},
-      tree{Octree(bodies)} {}
+      tree{Octree(bodies)},
+      solver{ForceSolver::BARNES_HUT},
+      directThreshold{0},
+      treeCurrent{true},
+      groupSize{0},
+      integrator{Integrator::EULER},
+      accelerationsCurrent{false},
+      maxLevel{0},
+      levelAccuracy{0},
+      levelLength{0} {}
 
-void Engine::addBody(Body& body) { tree.insert(body); }
+void Engine::addBody(const Body& body) {
+    tree.append(body);
+    accelerationsCurrent = false;
+}
 
-string Engine::step() {
-    // Step 1 - compute all forces on each object
-    updateForces(theta);
-    // Step 2 - update the motion for each object
-    updateMotion(dt);
+void Engine::setLayout(OctreeLayout layout) { tree.setLayout(layout); }
+
+void Engine::setMortonOrdering(bool enabled) { tree.setMortonOrdering(enabled); }
+
+void Engine::setStorage(BodyStorage storage) { tree.setStorage(storage); }
+
+void Engine::setLeafSize(size_t leafSize) { tree.setLeafSize(leafSize); }
+
+void Engine::setRefitThreshold(double fraction) { tree.setRefitThreshold(fraction); }
+
+void Engine::setSolver(ForceSolver newSolver) {
+    if (newSolver == ForceSolver::FMM && tree.getLayout() != OctreeLayout::FLAT)
+        throw runtime_error("Error: The FMM solver requires the flat tree layout.");
+    solver = newSolver;
+}
+
+void Engine::setDirectThreshold(size_t count) { directThreshold = count; }
+
+void Engine::setExpansionOrder(int order) { fmm.setOrder(order); }
+
+void Engine::setFmmTheta(double fmmTheta) { fmm.setTheta(fmmTheta); }
+
+void Engine::setQuadrupoles(bool enabled) { tree.setQuadrupoles(enabled); }
+
+void Engine::setGroupSize(size_t size) {
+    if (size > 0 && tree.getLayout() != OctreeLayout::FLAT)
+        throw runtime_error("Error: Grouped tree walks require the flat tree layout.");
+    groupSize = size;
+}
+
+void Engine::setThreads(size_t threads) {
+    pool = make_unique<ThreadPool>(threads);
+    if (pool->size() == 1)
+        pool.reset();
+    tree.setThreadPool(pool.get());
+}
+
+void Engine::setIntegrator(Integrator newIntegrator) {
+    if (maxLevel > 0 && newIntegrator != Integrator::LEAPFROG)
+        throw runtime_error("Error: Block timesteps require the leapfrog integrator.");
+    integrator = newIntegrator;
+}
+
+void Engine::setTimestepLevels(int levels, double accuracy, double length) {
+    if (levels < 0 || levels > MAX_TIMESTEP_LEVEL)
+        throw runtime_error(
+            "Error: Block timestep levels must be between 0 and " + to_string(MAX_TIMESTEP_LEVEL) + "."
+        );
+    if (levels > 0 && integrator != Integrator::LEAPFROG)
+        throw runtime_error("Error: Block timesteps require the leapfrog integrator.");
+    maxLevel = levels;
+    levelAccuracy = accuracy;
+    levelLength = length;
+}
+
+void Engine::step() {
+    if (integrator == Integrator::LEAPFROG && maxLevel > 0) {
+        blockStep();
+    } else if (integrator == Integrator::LEAPFROG) {
+        leapfrog(dt);
+    } else if (integrator == Integrator::YOSHIDA) {
+        // Yoshida's triple jump: a forward, a backward and a forward substep
+        // whose leading error terms cancel
+        const double forward = 1 / (2 - cbrt(2.0));
+        const double backward = 1 - 2 * forward;
+        leapfrog(forward * dt);
+        leapfrog(backward * dt);
+        leapfrog(forward * dt);
+    } else {
+        // Step 1 - compute all forces on each object
+        updateForces(theta);
+        // Step 2 - update the motion for each object
+        updateMotion(dt);
+        rebuildTree();
+    }
     currentTime += dt;
-    tree.buildTree();
-    return printStateJson();
+    metrics.steps++;
+}
+
+void Engine::leapfrog(double dt) {
+    // the closing kick of a step leaves accelerations at the new positions,
+    // so the next step opens with them and costs a single force evaluation
+    if (!accelerationsCurrent)
+        updateForces(theta);
+    kick(dt / 2);
+    drift(dt);
+    rebuildTree();
+    updateForces(theta);
+    kick(dt / 2);
+    accelerationsCurrent = true;
+}
+
+void Engine::blockStep() {
+    const uint32_t substeps = 1u << maxLevel;
+    const double tick = dt / substeps;
+    const size_t count = tree.count();
+    // a body on level k takes substeps >> k substeps per step
+    auto span = [&](int level) { return substeps >> level; };
+    if (!accelerationsCurrent)
+        updateForces(theta);
+    accelerationsCurrent = true;
+    levels.resize(count);
+    activeFlags.resize(count);
+    const double length = levelLength > 0 ? levelLength : meanSpacing();
+    // substeps all bodies have drifted through
+    uint32_t drifted = 0;
+    for (uint32_t substep = 0; substep < substeps; substep++) {
+        // open a new step for every body whose last one ended here
+        int deepest = 0;
+        {
+            PhaseTimer timer(metrics.integrateSeconds);
+            for (size_t i = 0; i < count; i++) {
+                uint8_t& level = levels[tree.getId(i)];
+                if (substep % span(level) == 0) {
+                    level = uint8_t(chooseLevel(i, substep, level, length));
+                    kickBody(i, span(level) * tick / 2);
+                }
+                deepest = max(deepest, int(level));
+            }
+        }
+        // nothing happens before the shortest step ends, so all bodies drift
+        // there at once
+        if ((substep + 1) % span(deepest) != 0)
+            continue;
+        drift((substep + 1 - drifted) * tick);
+        drifted = substep + 1;
+        rebuildTree();
+        // the tree may have reordered the body buffer
+        active.clear();
+        for (size_t i = 0; i < count; i++) {
+            activeFlags[i] = (substep + 1) % span(levels[tree.getId(i)]) == 0;
+            if (activeFlags[i])
+                active.push_back(uint32_t(i));
+        }
+        updateForces(theta, active.size() < count);
+        PhaseTimer timer(metrics.integrateSeconds);
+        for (uint32_t i : active) {
+            kickBody(i, span(levels[tree.getId(i)]) * tick / 2);
+        }
+    }
+}
+
+int Engine::chooseLevel(size_t index, uint32_t substep, int current, double length) const {
+    // a fraction of the time the body would take to fall across length from
+    // rest, which unlike its velocity is the same in every frame of reference
+    const double limit = levelAccuracy * sqrt(length / double(tree.loadBody(index).acceleration.length()));
+    int level = 0;
+    while (level < maxLevel && dt / (1u << level) > limit) {
+        level++;
+    }
+    // a body can only move up to a longer step that starts at this substep,
+    // so that its steps stay aligned with those of the levels above
+    while (level < current && substep % ((1u << maxLevel) >> level) != 0) {
+        level++;
+    }
+    return level;
 }
 
-void Engine::computeForce(OctreeNode* root, Body& body) {
+double Engine::meanSpacing() const {
+    const size_t count = tree.count();
+    if (count == 0)
+        return 0;
+    Vec3T<double> low = tree.getPosition(0).to<double>();
+    Vec3T<double> high = low;
+    for (size_t i = 1; i < count; i++) {
+        const Vec3T<double> position = tree.getPosition(i).to<double>();
+        low = Vec3T<double>(min(low.x, position.x), min(low.y, position.y), min(low.z, position.z));
+        high = Vec3T<double>(max(high.x, position.x), max(high.y, position.y), max(high.z, position.z));
+    }
+    const Vec3T<double> size = high - low;
+    return max({size.x, size.y, size.z}) / cbrt(double(count));
+}
+
+void Engine::kickBody(size_t index, double dt) {
+    if (tree.getStorage() == BodyStorage::SOA) {
+        BodyArrays& arrays = tree.getArrays();
+        arrays.vx[index] += arrays.ax[index] * dt;
+        arrays.vy[index] += arrays.ay[index] * dt;
+        arrays.vz[index] += arrays.az[index] * dt;
+    } else {
+        Body& body = tree.getBody(index);
+        body.velocity += body.acceleration * dt;
+    }
+}
+
+Vec3 Engine::computeForce(uint32_t bodyIndex, InteractionList& list, WalkCounts& counts) const {
+    list.clear();
+    const Vec3 position = tree.getPosition(bodyIndex);
+    if (tree.getLayout() == OctreeLayout::FLAT)
+        collectSources(position, bodyIndex, list, counts);
+    else
+        collectSources(tree.root, tree.getBody(bodyIndex), list, counts);
+    return accelerationGravity(list, position);
+}
+
+void Engine::collectSources(OctreeNode* root, const Body& body, InteractionList& list, WalkCounts& counts) const {
     if (root) {
         if (root->getType() != OctreeNodeType::EXTERNAL) {
-            const BoundingBox bounds = root->getBounds();
+            const double width = root->getBounds().width;
             auto d = approx_distance(root->getObject().position, body.position);
-            if ((bounds.width * bounds.width) / d > (theta * theta)) {
+            if ((width * width) / d > (theta * theta)) {
+                counts.opened++;
                 for (size_t i = 0; i < 8; i++) {
-                    computeForce(root->children[i], body);
+                    collectSources(root->children[i], body, list, counts);
                 }
+            } else {
+                // node is far enough away - approximate it by its center of mass
+                list.push(root->getObject().mass, root->getObject().position);
+                counts.nodes++;
             }
         } else if (&root->getObject() != &body) {
-            body.acceleration += accelerationGravity(root->getObject(), body);
+            list.pushBody(root->getObject().mass, root->getObject().position);
+            counts.opened++;
+            counts.bodies++;
+        }
+    }
+}
+
+void Engine::collectSources(
+    const Vec3& position, uint32_t bodyIndex, InteractionList& list, WalkCounts& counts
+) const {
+    const FlatOctree& flat = tree.flat;
+    const uint32_t end = static_cast<uint32_t>(flat.size());
+    // Walk the tree along its skip links: opening a node moves on to its
+    // first child, anything else jumps past the node's subtree
+    uint32_t index = 0;
+    while (index != end) {
+        const FlatOctreeNode& node = flat[index];
+        if (node.bodyCount > 1) {
+            // squared in double precision, which widths and distances of
+            // astronomical size overflow in single precision
+            const double width = node.width;
+            auto d = approx_distance(node.centerOfMass, position);
+            if ((width * width) / d <= (theta * theta)) {
+                list.push(node.mass, node.centerOfMass);
+                if (flat.hasQuadrupoles())
+                    list.pushQuadrupole(node.centerOfMass, flat.quadrupole(index));
+                counts.nodes++;
+                index = node.skip;
+                continue;
+            }
         }
+        counts.opened++;
+        if (!node.isLeaf()) {
+            index = node.firstChild;
+            continue;
+        }
+        // opened leaves are summed directly, body by body
+        for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+            uint32_t other = flat.bodyAt(i);
+            if (other != bodyIndex) {
+                list.pushBody(tree.getMass(other), tree.getPosition(other));
+                counts.bodies++;
+            }
+        }
+        index = node.skip;
     }
 }
 
-void Engine::updateForces(double theta) {
-    if (tree.root->empty())
+void Engine::collectGroups(uint32_t nodeIndex) {
+    const FlatOctreeNode& node = tree.flat[nodeIndex];
+    if (node.bodyCount <= groupSize || node.isLeaf()) {
+        groups.push_back(nodeIndex);
         return;
-    for (auto& object : tree) {
-        computeForce(tree.root, object);
+    }
+    int children = popcount(node.childMask);
+    for (int i = 0; i < children; i++) {
+        collectGroups(node.firstChild + i);
+    }
+}
+
+void Engine::collectSources(const Vec3& low, const Vec3& high, InteractionList& list, WalkCounts& counts) const {
+    const FlatOctree& flat = tree.flat;
+    const uint32_t end = static_cast<uint32_t>(flat.size());
+    uint32_t index = 0;
+    while (index != end) {
+        const FlatOctreeNode& node = flat[index];
+        if (node.bodyCount > 1) {
+            // the opening criterion has to hold for every body in the box, so
+            // measure from the point of the box closest to the node
+            const Vec3& c = node.centerOfMass;
+            double dx = max(Real(0), max(low.x - c.x, c.x - high.x));
+            double dy = max(Real(0), max(low.y - c.y, c.y - high.y));
+            double dz = max(Real(0), max(low.z - c.z, c.z - high.z));
+            double d = dx * dx + dy * dy + dz * dz;
+            const double width = node.width;
+            if (d > 0 && (width * width) / d <= (theta * theta)) {
+                list.push(node.mass, node.centerOfMass);
+                if (flat.hasQuadrupoles())
+                    list.pushQuadrupole(node.centerOfMass, flat.quadrupole(index));
+                counts.nodes++;
+                index = node.skip;
+                continue;
+            }
+        }
+        counts.opened++;
+        if (!node.isLeaf()) {
+            index = node.firstChild;
+            continue;
+        }
+        // bodies of the group itself end up in the list as well, but the
+        // kernel skips sources at the position of the target
+        for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+            uint32_t other = flat.bodyAt(i);
+            list.pushBody(tree.getMass(other), tree.getPosition(other));
+        }
+        counts.bodies += node.bodyCount;
+        index = node.skip;
+    }
+}
+
+void Engine::computeGroupForces(uint32_t groupIndex, InteractionList& list, WalkCounts& counts) {
+    const FlatOctreeNode& group = tree.flat[groupIndex];
+    const uint32_t end = group.firstBody + group.bodyCount;
+    Vec3 low = tree.getPosition(tree.flat.bodyAt(group.firstBody));
+    Vec3 high = low;
+    for (uint32_t i = group.firstBody + 1; i < end; i++) {
+        const Vec3 position = tree.getPosition(tree.flat.bodyAt(i));
+        low = Vec3{min(low.x, position.x), min(low.y, position.y), min(low.z, position.z)};
+        high = Vec3{max(high.x, position.x), max(high.y, position.y), max(high.z, position.z)};
+    }
+    list.clear();
+    WalkCounts walk;
+    collectSources(low, high, list, walk);
+    // every body of the group sums the whole list, except for itself
+    counts.opened += walk.opened;
+    counts.nodes += walk.nodes * group.bodyCount;
+    counts.bodies += (walk.bodies - 1) * group.bodyCount;
+    for (uint32_t i = group.firstBody; i < end; i++) {
+        const uint32_t body = tree.flat.bodyAt(i);
+        setAcceleration(body, accelerationGravity(list, tree.getPosition(body)));
+    }
+}
+
+void Engine::updateForces(double theta, bool activeOnly) {
+    if (summingDirectly()) {
+        sumDirectly(activeOnly);
+        return;
+    }
+    refreshTree();
+    const bool flat = tree.getLayout() == OctreeLayout::FLAT;
+    if (flat ? tree.flat.empty() : tree.root->empty())
+        return;
+    PhaseTimer timer(metrics.forceSeconds);
+    // the fast multipole method always computes the forces on all bodies
+    if (solver == ForceSolver::FMM) {
+        fmm.evaluate(tree, pool.get(), solverAccelerations);
+        for (size_t i = 0; i < tree.count(); i++) {
+            setAcceleration(i, solverAccelerations[i]);
+        }
+        return;
+    }
+    if (flat && groupSize > 0) {
+        groups.clear();
+        collectGroups(0);
+        // bodies sharing a walk with an active body get new forces as well,
+        // which is harmless
+        if (activeOnly) {
+            erase_if(groups, [&](uint32_t group) {
+                const FlatOctreeNode& node = tree.flat[group];
+                for (uint32_t i = node.firstBody; i < node.firstBody + node.bodyCount; i++) {
+                    if (activeFlags[tree.flat.bodyAt(i)])
+                        return false;
+                }
+                return true;
+            });
+        }
+        // groups are disjoint, so each body is still handled by exactly one
+        // walk
+        auto walkGroups = [&](size_t begin, size_t end) {
+            InteractionList list;
+            WalkCounts counts;
+            for (size_t i = begin; i < end; i++) {
+                computeGroupForces(groups[i], list, counts);
+            }
+            addCounts(counts);
+        };
+        if (pool)
+            pool->parallelFor(groups.size(), 1, walkGroups);
+        else
+            walkGroups(0, groups.size());
+        return;
+    }
+    // Every walk only reads the tree and writes the acceleration of its own
+    // body, and each body is always handled by exactly one walk, so results
+    // do not depend on how bodies are split between threads.
+    const size_t count = activeOnly ? active.size() : tree.count();
+    auto walk = [&](size_t begin, size_t end) {
+        InteractionList list;
+        WalkCounts counts;
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t body = activeOnly ? active[i] : uint32_t(i);
+            setAcceleration(body, computeForce(body, list, counts));
+        }
+        addCounts(counts);
+    };
+    if (pool)
+        pool->parallelFor(count, FORCE_GRAIN, walk);
+    else
+        walk(0, count);
+}
+
+bool Engine::summingDirectly() const { return solver == ForceSolver::DIRECT || tree.count() <= directThreshold; }
+
+void Engine::sumDirectly(bool activeOnly) {
+    const size_t count = tree.count();
+    if (count == 0)
+        return;
+    PhaseTimer timer(metrics.forceSeconds);
+    // summing over all pairs at once evaluates each pair once instead of
+    // twice, which pays off unless few bodies need forces
+    if (activeOnly && 2 * active.size() < count) {
+        metrics.bodyBody += active.size() * (count - 1);
+        direct.evaluate(tree, pool.get(), active, solverAccelerations);
+        for (uint32_t i : active) {
+            setAcceleration(i, solverAccelerations[i]);
+        }
+        return;
+    }
+    metrics.bodyBody += count * (count - 1);
+    direct.evaluate(tree, pool.get(), solverAccelerations);
+    for (size_t i = 0; i < count; i++) {
+        setAcceleration(i, solverAccelerations[i]);
+    }
+}
+
+void Engine::addCounts(const WalkCounts& counts) {
+    lock_guard<mutex> lock(metricsMutex);
+    metrics.nodesOpened += counts.opened;
+    metrics.bodyNode += counts.nodes;
+    metrics.bodyBody += counts.bodies;
+}
+
+void Engine::rebuildTree() {
+    // the direct solver reads the body buffer only
+    if (summingDirectly()) {
+        treeCurrent = false;
+        return;
+    }
+    PhaseTimer timer(metrics.treeSeconds);
+    const size_t built = tree.getNodesBuilt();
+    tree.updateTree();
+    recordBuild(built);
+}
+
+void Engine::refreshTree() {
+    PhaseTimer timer(metrics.treeSeconds);
+    const size_t built = tree.getNodesBuilt();
+    if (treeCurrent)
+        tree.refresh();
+    else
+        tree.buildTree();
+    treeCurrent = true;
+    recordBuild(built);
+}
+
+void Engine::recordBuild(size_t nodesBefore) {
+    const size_t built = tree.getNodesBuilt();
+    if (built == nodesBefore)
+        return;
+    metrics.nodesBuilt += built - nodesBefore;
+    metrics.maxDepth = max(metrics.maxDepth, uint64_t(tree.depth()));
+}
+
+void Engine::setAcceleration(size_t index, const Vec3& acceleration) {
+    if (tree.getStorage() == BodyStorage::SOA) {
+        BodyArrays& arrays = tree.getArrays();
+        arrays.ax[index] = acceleration.x;
+        arrays.ay[index] = acceleration.y;
+        arrays.az[index] = acceleration.z;
+    } else {
+        tree.getBody(index).acceleration = acceleration;
     }
 }
 
 void Engine::updateMotion(double dt) {
+    PhaseTimer timer(metrics.integrateSeconds);
     // Integrate acceleration into velocity, and velocity into position
-    for (auto& object : tree) {
+    if (tree.getStorage() == BodyStorage::SOA) {
+        // one pass per component, so each loop streams only three arrays
+        BodyArrays& arrays = tree.getArrays();
+        const size_t count = arrays.size();
+        Real* velocities[3] = {arrays.vx.data(), arrays.vy.data(), arrays.vz.data()};
+        Real* positions[3] = {arrays.x.data(), arrays.y.data(), arrays.z.data()};
+        const Real* accelerations[3] = {arrays.ax.data(), arrays.ay.data(), arrays.az.data()};
+        for (size_t axis = 0; axis < 3; axis++) {
+            Real* velocity = velocities[axis];
+            Real* position = positions[axis];
+            const Real* acceleration = accelerations[axis];
+            for (size_t i = 0; i < count; i++) {
+                velocity[i] += acceleration[i] * dt;
+                position[i] += velocity[i] * dt;
+            }
+        }
+        return;
+    }
+    for (auto&& object : tree) {
         object.velocity += object.acceleration * dt;
         object.position += object.velocity * dt;
     }
 }
 
-inline Vec3 Engine::accelerationGravity(const Object& o1, const Object& o2) const {
-    Vec3 r12 = o2.position - o1.position;
-    double G = 6.678E-11;
-    double constantTerm = -1 * G * o1.mass / (r12.length() * r12.length() * r12.length());
-    Vec3 force = r12 * constantTerm;
-    return force;
-}
-
-string Engine::printStateJson() {
-    ostringstream stringBuilder;
-    stringBuilder << setprecision(5); // set decimal precision to 5 pts
-    stringBuilder << "{\"time\":" << currentTime << ",";
-    stringBuilder << "\"bodies\":[";
-    size_t index = 0;
-    for (auto& object : tree) {
-        stringBuilder << "{\"mass\":" << object.mass;
-        stringBuilder << ",\"position\":{"
-                      << "\"x\":" << object.position.x << ",\"y\":" << object.position.y
-                      << ",\"z\":" << object.position.z << "}";
-        stringBuilder << ",\"velocity\":{"
-                      << "\"x\":" << object.velocity.x << ",\"y\":" << object.velocity.y
-                      << ",\"z\":" << object.velocity.z << "}";
-        stringBuilder << ",\"acceleration\":{"
-                      << "\"x\":" << object.acceleration.x << ",\"y\":" << object.acceleration.y
-                      << ",\"z\":" << object.acceleration.z << "}";
-        stringBuilder << "}";
-        if (index < tree.count() - 1)
-            stringBuilder << ",";
-        index++;
-    }
-    stringBuilder << "]}";
-    return stringBuilder.str();
+void Engine::kick(double dt) {
+    PhaseTimer timer(metrics.integrateSeconds);
+    if (tree.getStorage() == BodyStorage::SOA) {
+        BodyArrays& arrays = tree.getArrays();
+        const size_t count = arrays.size();
+        for (size_t i = 0; i < count; i++) {
+            arrays.vx[i] += arrays.ax[i] * dt;
+            arrays.vy[i] += arrays.ay[i] * dt;
+            arrays.vz[i] += arrays.az[i] * dt;
+        }
+        return;
+    }
+    for (auto&& object : tree) {
+        object.velocity += object.acceleration * dt;
+    }
+}
+
+void Engine::drift(double dt) {
+    PhaseTimer timer(metrics.integrateSeconds);
+    if (tree.getStorage() == BodyStorage::SOA) {
+        BodyArrays& arrays = tree.getArrays();
+        const size_t count = arrays.size();
+        for (size_t i = 0; i < count; i++) {
+            arrays.x[i] += arrays.vx[i] * dt;
+            arrays.y[i] += arrays.vy[i] * dt;
+            arrays.z[i] += arrays.vz[i] * dt;
+        }
+        return;
+    }
+    for (auto&& object : tree) {
+        object.position += object.velocity * dt;
+    }
+}
+
+void Engine::snapshot(Snapshot& snapshot) const {
+    snapshot.time = currentTime;
+    snapshot.ids.clear();
+    snapshot.bodies.resize(tree.count());
+    // bodies are written in insertion order, independent of how they are
+    // currently stored
+    for (size_t index = 0; index < tree.count(); index++) {
+        snapshot.bodies[index] = tree.loadBodyById(index);
+    }
+}
+
+void Engine::snapshot(Snapshot& snapshot, const vector<uint32_t>& ids) const {
+    snapshot.time = currentTime;
+    snapshot.ids = ids;
+    snapshot.bodies.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (ids[i] >= tree.count())
+            throw runtime_error("Error: Body id " + to_string(ids[i]) + " is out of range.");
+        snapshot.bodies[i] = tree.loadBodyById(ids[i]);
+    }
+}
+
+size_t Engine::count() const { return tree.count(); }
+
+size_t Engine::findCoincidentBody() const { return tree.findCoincidentBody(); }
+
+void Engine::setTheta(double newTheta) { theta = newTheta; }
+
+double Engine::getTheta() const { return theta; }
+
+void Engine::sampleForces(size_t samples, vector<uint32_t>& sample, vector<Vec3>& exact) {
+    const size_t count = tree.count();
+    if (count < 2)
+        throw runtime_error("Error: Measuring force errors requires at least two bodies.");
+    if (samples == 0)
+        throw runtime_error("Error: Measuring force errors requires at least one sample.");
+    refreshTree();
+    // bodies are picked by insertion index, so the same bodies are measured
+    // whatever the layout and ordering of the tree
+    vector<uint32_t> ids(count);
+    for (size_t i = 0; i < count; i++) {
+        ids[tree.getId(i)] = uint32_t(i);
+    }
+    sample.clear();
+    std::sample(ids.begin(), ids.end(), back_inserter(sample), samples, mt19937(SAMPLE_SEED));
+    direct.evaluate(tree, pool.get(), sample, exact);
+}
+
+ForceErrors Engine::measureForceErrors(
+    double walkTheta, const vector<uint32_t>& sample, const vector<Vec3>& exact
+) {
+    // walks read the opening parameter of the engine
+    const double runTheta = theta;
+    theta = walkTheta;
+    vector<double> errors;
+    errors.reserve(sample.size());
+    WalkCounts counts;
+    InteractionList list;
+    for (uint32_t body : sample) {
+        // relative errors are undefined where the exact forces cancel out
+        const double norm = exact[body].to<double>().length();
+        if (norm == 0)
+            continue;
+        const Vec3 walked = computeForce(body, list, counts);
+        errors.push_back((walked.to<double>() - exact[body].to<double>()).length() / norm);
+    }
+    theta = runTheta;
+    ForceErrors result;
+    result.theta = walkTheta;
+    result.bodies = tree.count();
+    result.samples = errors.size();
+    if (errors.empty())
+        return result;
+    sort(errors.begin(), errors.end());
+    const double samples = double(errors.size());
+    result.median = percentile(errors, 0.5);
+    result.p90 = percentile(errors, 0.9);
+    result.p99 = percentile(errors, 0.99);
+    result.max = errors.back();
+    result.bodyNode = double(counts.nodes) / samples;
+    result.bodyBody = double(counts.bodies) / samples;
+    return result;
+}
+
+ForceErrors Engine::measureForceErrors(double theta, size_t samples) {
+    vector<uint32_t> sample;
+    sampleForces(samples, sample, solverAccelerations);
+    return measureForceErrors(theta, sample, solverAccelerations);
+}
+
+double Engine::tuneTheta(double targetError, size_t samples) {
+    vector<uint32_t> sample;
+    sampleForces(samples, sample, solverAccelerations);
+    if (measureForceErrors(MAX_THETA, sample, solverAccelerations).p99 <= targetError)
+        return MAX_THETA;
+    // theta zero opens every node and is exact, so low always meets the target
+    double low = 0;
+    double high = MAX_THETA;
+    for (int i = 0; i < TUNE_STEPS; i++) {
+        const double middle = (low + high) / 2;
+        if (measureForceErrors(middle, sample, solverAccelerations).p99 <= targetError)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+double Engine::getTime() const { return currentTime; }
+
+Metrics Engine::getMetrics() const {
+    Metrics result = metrics;
+    result.bodies = tree.count();
+    return result;
+}
+
+void Engine::resume(double time) {
+    currentTime = time;
+    accelerationsCurrent = false;
+    // bodies added one by one grow the tree as they come, while every step
+    // ends with a rebuild over all bodies
+    tree.buildTree();
+    treeCurrent = true;
 }
 
 double Engine::approx_distance(const Vec3& pos1, const Vec3& pos2) const {
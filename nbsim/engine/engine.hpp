@@ -2,13 +2,42 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "nbsim/core/direct/direct_solver.hpp"
+#include "nbsim/core/fmm/fmm_solver.hpp"
+#include "nbsim/core/gravity/interaction_list.hpp"
 #include "nbsim/core/octree/octree.hpp"
+#include "nbsim/core/parallel/thread_pool.hpp"
+#include "nbsim/core/snapshot/snapshot.hpp"
+#include "nbsim/engine/accuracy.hpp"
+#include "nbsim/engine/force_solver.hpp"
+#include "nbsim/engine/integrator.hpp"
+#include "nbsim/engine/metrics.hpp"
 
 /**
  * Performs simulation and returns results
  */
 class Engine {
   private:
+    // Number of bodies handed to a thread at a time while computing forces
+    static constexpr size_t FORCE_GRAIN = 64;
+    // Deepest supported block timestep level
+    static constexpr int MAX_TIMESTEP_LEVEL = 20;
+    // Seed of the generator picking the bodies force errors are measured on
+    static constexpr uint32_t SAMPLE_SEED = 42;
+    // Largest theta tried when tuning
+    static constexpr double MAX_THETA = 1;
+    // Number of times the range of theta is halved when tuning
+    static constexpr int TUNE_STEPS = 12;
+    // Work done by the tree walks of one thread, added to metrics at once
+    struct WalkCounts {
+        uint64_t opened = 0; // nodes opened
+        uint64_t nodes = 0;  // body-node interactions
+        uint64_t bodies = 0; // body-body interactions
+    };
     // The current time of the simulation. Starts at zero.
     double currentTime;
     // Theta parameter - dictates boundary between choosing to approximate and
@@ -19,20 +48,132 @@ class Engine {
     double dt;
     // Spatial tree structure.
     Octree tree;
+    // Threads used to run the simulation. Null when running on the calling
+    // thread only.
+    std::unique_ptr<ThreadPool> pool;
+    // Method forces are computed with
+    ForceSolver solver;
+    // Fast multipole solver, used with ForceSolver::FMM
+    FmmSolver fmm;
+    // Direct summation solver, used with ForceSolver::DIRECT and for small
+    // systems
+    DirectSolver direct;
+    // Largest number of bodies whose forces are summed directly whatever the
+    // solver
+    size_t directThreshold;
+    // False once bodies moved while forces were summed directly, which needs
+    // no tree, so that the tree has to be rebuilt before it is walked again
+    bool treeCurrent;
+    // Accelerations computed by the fast multipole and direct solvers, by
+    // body index
+    std::vector<Vec3> solverAccelerations;
+    // Maximum number of bodies that share one tree walk, or zero to walk the
+    // tree once per body
+    size_t groupSize;
+    // Flat tree nodes whose bodies share a walk
+    std::vector<uint32_t> groups;
+    // Scheme bodies are advanced in time with
+    Integrator integrator;
+    // True if the stored accelerations belong to the current positions, so
+    // that a kick-drift-kick step can open with them
+    bool accelerationsCurrent;
+    // Deepest block timestep level. Bodies on level k advance in steps of
+    // dt / 2^k. Zero gives every body the full time step.
+    int maxLevel;
+    // Accuracy parameter of the block timestep criterion: a body takes the
+    // longest step up to this fraction of sqrt(levelLength / |a|)
+    double levelAccuracy;
+    // Length scale of the block timestep criterion, or zero to use the mean
+    // spacing of the bodies at the start of every step
+    double levelLength;
+    // Block timestep level of every body, by insertion index
+    std::vector<uint8_t> levels;
+    // Bodies whose step ends on the current substep, by index of the body
+    // buffer
+    std::vector<uint32_t> active;
+    // Set for every body in active, by index of the body buffer
+    std::vector<char> activeFlags;
+    // Time spent and work done so far
+    Metrics metrics;
+    // Guards the counters of metrics while threads add to them
+    std::mutex metricsMutex;
     // Gets approximate Euclidean distance between two points in space (omits
     // the square root for speed)
     double approx_distance(const Vec3& pos1, const Vec3& pos2) const;
-    // Returns the gravitational force exerted between two objects
-    Vec3 accelerationGravity(const Object& o1, const Object& o2) const;
-    // Updates the forces between all different objects in the simulation
-    void updateForces(double theta);
+    // Updates the forces between all different objects in the simulation. If
+    // activeOnly is set, only bodies in active are guaranteed to get new
+    // forces.
+    void updateForces(double theta, bool activeOnly = false);
+    // Returns true if forces are summed directly over all pairs, without the
+    // tree
+    bool summingDirectly() const;
+    // Sums the forces on all bodies, or only on those in active if activeOnly
+    // is set, directly over all pairs
+    void sumDirectly(bool activeOnly);
+    // Adds the work of tree walks to metrics
+    void addCounts(const WalkCounts& counts);
+    // Brings the tree up to date after bodies moved. Skipped while forces are
+    // summed directly.
+    void rebuildTree();
+    // Makes sure the tree holds all bodies at their current positions before
+    // it is walked
+    void refreshTree();
+    // Adds the nodes built since the tree had built the given number to
+    // metrics, along with the depth of a newly built tree
+    void recordBuild(size_t nodesBefore);
+    // Sets the acceleration of the body stored at the given index
+    void setAcceleration(size_t index, const Vec3& acceleration);
     // Updates the motion between all different objects in the simulation
     void updateMotion(double dt);
-    // Returns JSON string of current system state;
-    std::string printStateJson();
-    // Computes the force exerted on the object obj by all other bodies in the
-    // tree
-    void computeForce(OctreeNode* root, Body& obj);
+    // Advances all velocities by their accelerations over dt
+    void kick(double dt);
+    // Advances all positions by their velocities over dt
+    void drift(double dt);
+    // Advances the system by one kick-drift-kick step of length dt
+    void leapfrog(double dt);
+    // Advances the system by dt in kick-drift-kick substeps of dt / 2^maxLevel,
+    // kicking every body only at the ends of its own block step
+    void blockStep();
+    // Returns the block timestep level the body at the given index of the
+    // body buffer should continue on, when its step on level current ends at
+    // the given substep, for the given length scale of the criterion
+    int chooseLevel(size_t index, uint32_t substep, int current, double length) const;
+    // Returns the largest side of the box around all bodies divided by the
+    // cube root of their number
+    double meanSpacing() const;
+    // Advances the velocity of the body at the given index by its
+    // acceleration over dt
+    void kickBody(size_t index, double dt);
+    // Returns the acceleration exerted on the body at index bodyIndex by all
+    // other bodies in the tree. Sources are gathered into list, which is
+    // scratch space reused between calls, and evaluated in one batch.
+    Vec3 computeForce(uint32_t bodyIndex, InteractionList& list, WalkCounts& counts) const;
+    // Appends the sources in the subtree at root acting on obj to list
+    void collectSources(OctreeNode* root, const Body& obj, InteractionList& list, WalkCounts& counts) const;
+    // Appends the sources in the flat tree acting on the body at index
+    // bodyIndex, located at position, to list
+    void collectSources(const Vec3& position, uint32_t bodyIndex, InteractionList& list, WalkCounts& counts) const;
+    // Collects the largest flat tree nodes below nodeIndex holding at most
+    // groupSize bodies into groups
+    void collectGroups(uint32_t nodeIndex);
+    // Appends the sources in the flat tree acting on any body inside the box
+    // from low to high to list
+    void collectSources(const Vec3& low, const Vec3& high, InteractionList& list, WalkCounts& counts) const;
+    // Computes the forces on all bodies of the group at the given flat tree
+    // node from a single walk against their bounding box
+    void computeGroupForces(uint32_t groupIndex, InteractionList& list, WalkCounts& counts);
+    // Picks up to samples bodies at random into sample, by index of the body
+    // buffer, and sums their exact accelerations into exact, indexed like
+    // the body buffer. Throws std::runtime_error unless there are at least
+    // two bodies and one sample.
+    void sampleForces(size_t samples, std::vector<uint32_t>& sample, std::vector<Vec3>& exact);
+    // Measures the errors of tree walks opened with walkTheta on the bodies of
+    // sample against their exact accelerations
+    ForceErrors measureForceErrors(
+        double walkTheta, const std::vector<uint32_t>& sample, const std::vector<Vec3>& exact
+    );
+    // Lets benchmarks time the phases of a step separately
+    friend struct EnginePhases;
 
   public:
     // Constructor with only default parameters
@@ -41,10 +182,94 @@ class Engine {
     Engine(double theta, double dt, double simulationWidth);
     // Constructor with input of simulation bodies
     Engine(double theta, double dt, std::vector<Body>& bodies);
-    // Add bodies to the simulation
-    void addBody(Body& body);
+    // Add bodies to the simulation. The tree is built over all added bodies
+    // when forces are next needed.
+    void addBody(const Body& body);
+    // Selects the memory layout of the spatial tree
+    void setLayout(OctreeLayout layout);
+    // Enables sorting of bodies along a Morton curve before every tree build
+    void setMortonOrdering(bool enabled);
+    // Selects the memory layout of the bodies. SoA storage requires the flat
+    // tree layout.
+    void setStorage(BodyStorage storage);
+    // Sets the maximum number of bodies per tree leaf. Leaves holding more
+    // than one body require the flat tree layout.
+    void setLeafSize(size_t leafSize);
+    // Refits the flat tree between steps instead of rebuilding it, until more
+    // than the given fraction of bodies has left their cells. Pass a negative
+    // fraction to rebuild every step.
+    void setRefitThreshold(double fraction);
+    // Selects the method forces are computed with. The fast multipole method
+    // requires the flat tree layout; throws std::runtime_error otherwise.
+    void setSolver(ForceSolver newSolver);
+    // Sums forces directly over all pairs whenever the simulation holds at
+    // most count bodies, whatever the selected solver. Zero always uses the
+    // selected solver.
+    void setDirectThreshold(size_t count);
+    // Sets the expansion order of the fast multipole method
+    void setExpansionOrder(int order);
+    // Sets the opening parameter of the fast multipole method, which is
+    // separate from theta of the Barnes-Hut walks
+    void setFmmTheta(double fmmTheta);
+    // Adds quadrupole moments to the far field of the Barnes-Hut walk.
+    // Requires the flat tree layout.
+    void setQuadrupoles(bool enabled);
+    // Lets groups of up to size nearby bodies share one walk of the flat tree,
+    // opened against the group's bounding box. Zero walks the tree once per
+    // body. Throws std::runtime_error unless the layout is flat.
+    void setGroupSize(size_t size);
+    // Sets the number of threads used to build the tree and compute forces.
+    // Zero uses one thread per hardware thread. Results are identical for any
+    // number of threads.
+    void setThreads(size_t threads);
+    // Selects the scheme bodies are advanced in time with. Throws
+    // std::runtime_error if block timesteps are enabled and the scheme is
+    // not leapfrog.
+    void setIntegrator(Integrator newIntegrator);
+    // Gives every body its own power of two fraction of the time step, down
+    // to dt / 2^levels, the longest one up to accuracy * sqrt(length / |a|)
+    // for its acceleration a. A length of zero uses the mean spacing of the
+    // bodies. Substeps only compute forces on the bodies whose step ends
+    // there, and drift all others. Zero levels advances all bodies together.
+    // Block timesteps require the leapfrog integrator; throws
+    // std::runtime_error otherwise or if levels is out of range.
+    void setTimestepLevels(int levels, double accuracy, double length);
+    // Sets the opening parameter of the tree walks
+    void setTheta(double newTheta);
+    // Returns the opening parameter of the tree walks
+    double getTheta() const;
+    // Compares the Barnes-Hut accelerations of up to samples bodies, picked at
+    // random with a fixed seed, against exact sums over all other bodies.
+    // Walks are opened with the given theta and follow the tree layout, leaf
+    // size and quadrupole settings, one walk per body. Throws
+    // std::runtime_error unless there are at least two bodies and one sample.
+    ForceErrors measureForceErrors(double theta, size_t samples);
+    // Returns the largest theta, up to 1, for which the 99th percentile of the
+    // force error on samples bodies is at most targetError. Error is assumed
+    // to grow with theta. Throws std::runtime_error like measureForceErrors.
+    double tuneTheta(double targetError, size_t samples);
     // Simulates one time step of the system
-    std::string step();
+    void step();
+    // Stores the current state of the system in snapshot, reusing its storage
+    void snapshot(Snapshot& snapshot) const;
+    // Stores the current state of the bodies with the given ids in snapshot.
+    // Throws std::runtime_error if an id is out of range.
+    void snapshot(Snapshot& snapshot, const std::vector<uint32_t>& ids) const;
+    // Returns the number of bodies in the simulation
+    size_t count() const;
+    // Returns the lowest index of a body at the same position as a body added
+    // before it, or count() if all positions differ
+    size_t findCoincidentBody() const;
+    // Returns the current time of the simulation
+    double getTime() const;
+    // Returns the time spent and work done by all steps so far. Serialization
+    // and output happen outside the engine and are left at zero.
+    Metrics getMetrics() const;
+    // Continues a run saved at the given time, once all of its bodies were
+    // added. The tree is rebuilt the way the last step before saving left it,
+    // so the run goes on exactly as if never interrupted, unless the flat tree
+    // was being refit.
+    void resume(double time);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include "nbsim/engine/engine.hpp"
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <memory>
+#include <numbers>
+#include <numeric>
+#include <vector>
+
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include "nbsim/core/testing/random_bodies.hpp"
+
+using namespace std;
+
+class TestEngine : public ::testing::Test {
+  protected:
+    // Mass of each body of the binary
+    static constexpr double MASS = 1e30;
+    // Distance between the bodies of the binary
+    static constexpr double SEPARATION = 1e11;
+    // Energy drift caused by rounding alone, which bounds how far higher
+    // order integrators can improve on lower ones
+    static constexpr double ROUNDING_DRIFT = is_same_v<FieldReal, float> ? 1e-5 : 0;
+    // Relative force error of exact sums caused by rounding alone
+    static constexpr double ROUNDING_ERROR = is_same_v<FieldReal, float> ? 1e-5 : 1e-12;
+
+    TestEngine() = default;
+
+    // Returns the time the binary takes for one orbit
+    static double period() {
+        return 2 * numbers::pi * sqrt(pow(SEPARATION, 3) / (2 * GRAVITATIONAL_CONSTANT * MASS));
+    }
+
+    // Returns two bodies of equal mass on a circular orbit around their
+    // common center of mass at the origin
+    static vector<Body> binary() {
+        const double speed = sqrt(GRAVITATIONAL_CONSTANT * MASS / (2 * SEPARATION));
+        return {
+            Body(Real(MASS), Vec3(Real(SEPARATION / 2), 0, 0), Vec3(0, Real(speed), 0), Vec3()),
+            Body(Real(MASS), Vec3(Real(-SEPARATION / 2), 0, 0), Vec3(0, Real(-speed), 0), Vec3()),
+        };
+    }
+
+    // Returns an engine holding the given bodies, summing forces over all
+    // pairs so that only the integrator is tested
+    static unique_ptr<Engine> start(vector<Body> bodies, Integrator integrator, double dt) {
+        auto engine = make_unique<Engine>(0, dt, SEPARATION);
+        engine->setSolver(ForceSolver::DIRECT);
+        engine->setIntegrator(integrator);
+        for (Body& body : bodies) {
+            engine->addBody(body);
+        }
+        return engine;
+    }
+
+    // Returns an engine holding the given bodies, walking the tree with
+    // theta 0.5 in steps of a day
+    static unique_ptr<Engine> start(vector<Body> bodies, OctreeLayout layout) {
+        auto engine = make_unique<Engine>(0.5, 86400, 1e13);
+        engine->setLayout(layout);
+        for (Body& body : bodies) {
+            engine->addBody(body);
+        }
+        return engine;
+    }
+
+    // Expects both engines to hold exactly the same state
+    static void expectSameState(const Engine& engine, const Engine& expected) {
+        Snapshot state, expectedState;
+        engine.snapshot(state);
+        expected.snapshot(expectedState);
+        EXPECT_EQ(state.time, expectedState.time);
+        ASSERT_EQ(state.bodies.size(), expectedState.bodies.size());
+        for (size_t i = 0; i < state.bodies.size(); i++) {
+            EXPECT_EQ(state.bodies[i].position, expectedState.bodies[i].position) << "body " << i;
+            EXPECT_EQ(state.bodies[i].velocity, expectedState.bodies[i].velocity) << "body " << i;
+            EXPECT_EQ(state.bodies[i].acceleration, expectedState.bodies[i].acceleration) << "body " << i;
+        }
+    }
+
+    // Returns the error of the acceleration of every body after one step,
+    // relative to the exact acceleration at the starting positions
+    static vector<double> forceErrors(Engine& engine, const vector<Vec3>& exact) {
+        engine.step();
+        Snapshot state;
+        engine.snapshot(state);
+        vector<double> errors;
+        for (size_t i = 0; i < exact.size(); i++) {
+            errors.push_back((state.bodies[i].acceleration - exact[i]).length() / exact[i].length());
+        }
+        return errors;
+    }
+
+    static double mean(const vector<double>& values) {
+        return accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+    }
+
+    // Returns the total energy of the system
+    static double energy(const Engine& engine) {
+        Snapshot state;
+        engine.snapshot(state);
+        double total = 0;
+        for (size_t i = 0; i < state.bodies.size(); i++) {
+            const Body& body = state.bodies[i];
+            const double speed = body.velocity.to<double>().length();
+            total += 0.5 * double(body.mass) * speed * speed;
+            for (size_t j = i + 1; j < state.bodies.size(); j++) {
+                const Body& other = state.bodies[j];
+                const double distance = (body.position.to<double>() - other.position.to<double>()).length();
+                total -= GRAVITATIONAL_CONSTANT * double(body.mass) * double(other.mass) / distance;
+            }
+        }
+        return total;
+    }
+
+    // Returns the largest relative energy error of the binary over one orbit
+    // in steps of the given number per orbit
+    static double energyDrift(Integrator integrator, int steps) {
+        auto engine = start(binary(), integrator, period() / steps);
+        const double initial = energy(*engine);
+        double drift = 0;
+        for (int i = 0; i < steps; i++) {
+            engine->step();
+            drift = max(drift, abs((energy(*engine) - initial) / initial));
+        }
+        return drift;
+    }
+
+    // Returns the distance of the first body of the binary from its exact
+    // position a quarter orbit on, taken in the given number of steps,
+    // relative to the separation
+    static double quarterOrbitError(Integrator integrator, int steps) {
+        auto engine = start(binary(), integrator, period() / 4 / steps);
+        for (int i = 0; i < steps; i++) {
+            engine->step();
+        }
+        Snapshot state;
+        engine->snapshot(state);
+        return (state.bodies[0].position.to<double>() - Vec3T<double>(0, SEPARATION / 2, 0)).length() / SEPARATION;
+    }
+};
+
+TEST_F(TestEngine, BinaryKeepsCircularOrbit) {
+    const int steps = 1000;
+    auto engine = start(binary(), Integrator::LEAPFROG, period() / steps);
+    Snapshot state;
+    for (int i = 0; i < steps; i++) {
+        engine->step();
+        engine->snapshot(state);
+        const Vec3T<double> first = state.bodies[0].position.to<double>();
+        const Vec3T<double> second = state.bodies[1].position.to<double>();
+        EXPECT_NEAR((first - second).length(), SEPARATION, 1e-4 * SEPARATION);
+        // momentum is conserved, so the center of mass stays at the origin
+        EXPECT_NEAR((first + second).length(), 0, 1e-6 * SEPARATION);
+    }
+    EXPECT_NEAR(engine->getTime(), period(), 1e-9 * period());
+    // a quarter of the way round, the first body has moved from +x to +y
+    EXPECT_LT(quarterOrbitError(Integrator::LEAPFROG, steps / 4), 1e-3);
+}
+
+TEST_F(TestEngine, EnergyDriftFallsWithOrder) {
+    const double euler = energyDrift(Integrator::EULER, 1000);
+    const double leapfrog = energyDrift(Integrator::LEAPFROG, 1000);
+    const double yoshida = energyDrift(Integrator::YOSHIDA, 1000);
+    EXPECT_LT(euler, 1e-4);
+    EXPECT_LT(leapfrog, max(euler / 1000, ROUNDING_DRIFT));
+    EXPECT_LT(yoshida, max(leapfrog / 1000, ROUNDING_DRIFT));
+}
+
+TEST_F(TestEngine, ErrorConvergesAtOrderOfIntegrator) {
+    // halving the step divides the error by 2^order
+    const struct {
+        Integrator integrator;
+        int steps;
+        double order;
+    } cases[] = {
+        {Integrator::EULER, 1000, 1},
+        {Integrator::LEAPFROG, 100, 2},
+        {Integrator::YOSHIDA, 12, 4},
+    };
+    for (const auto& test : cases) {
+        const double coarse = quarterOrbitError(test.integrator, test.steps);
+        const double fine = quarterOrbitError(test.integrator, 2 * test.steps);
+        EXPECT_NEAR(log2(coarse / fine), test.order, 0.3) << "integrator " << int(test.integrator);
+    }
+}
+
+TEST_F(TestEngine, ThreadsGiveIdenticalResults) {
+    const vector<Body> bodies = randomBodies(3000, 7);
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        auto serial = start(bodies, layout);
+        for (int i = 0; i < 3; i++) {
+            serial->step();
+        }
+        for (size_t threads : {2, 4}) {
+            auto parallel = start(bodies, layout);
+            parallel->setThreads(threads);
+            for (int i = 0; i < 3; i++) {
+                parallel->step();
+            }
+            expectSameState(*parallel, *serial);
+        }
+    }
+}
+
+TEST_F(TestEngine, GroupedWalksAreAtLeastAsAccurate) {
+    const vector<Body> bodies = randomBodies(3000, 11);
+    const vector<Vec3> exact = directAccelerations(bodies);
+    // leaves of 32 bodies are larger than the groups and are walked for as a
+    // whole
+    for (size_t leafSize : {1, 32}) {
+        auto perBody = start(bodies, OctreeLayout::FLAT);
+        perBody->setLeafSize(leafSize);
+        auto grouped = start(bodies, OctreeLayout::FLAT);
+        grouped->setLeafSize(leafSize);
+        grouped->setGroupSize(16);
+        const vector<double> expected = forceErrors(*perBody, exact);
+        const vector<double> errors = forceErrors(*grouped, exact);
+        EXPECT_LE(mean(errors), mean(expected)) << "leaf size " << leafSize;
+        EXPECT_LE(*max_element(errors.begin(), errors.end()), *max_element(expected.begin(), expected.end()))
+            << "leaf size " << leafSize;
+    }
+}
+
+TEST_F(TestEngine, BlockStepsOnLevelZeroMatchLeapfrog) {
+    const vector<Body> bodies = randomBodies(2000, 13);
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        auto leapfrog = start(bodies, layout);
+        leapfrog->setIntegrator(Integrator::LEAPFROG);
+        // a limit far above the time step keeps every body on level 0
+        auto block = start(bodies, layout);
+        block->setIntegrator(Integrator::LEAPFROG);
+        block->setTimestepLevels(4, 1e9, 0);
+        for (int i = 0; i < 3; i++) {
+            leapfrog->step();
+            block->step();
+        }
+        expectSameState(*block, *leapfrog);
+    }
+}
+
+TEST_F(TestEngine, BlockStepsRestartExactly) {
+    const vector<Body> bodies = randomBodies(500, 17);
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        auto configure = [](Engine& engine) {
+            engine.setIntegrator(Integrator::LEAPFROG);
+            engine.setTimestepLevels(4, 1e-4, 0);
+        };
+        auto uninterrupted = start(bodies, layout);
+        configure(*uninterrupted);
+        for (int i = 0; i < 4; i++) {
+            uninterrupted->step();
+        }
+        auto interrupted = start(bodies, layout);
+        configure(*interrupted);
+        for (int i = 0; i < 2; i++) {
+            interrupted->step();
+        }
+        Snapshot saved;
+        interrupted->snapshot(saved);
+        auto restarted = start(saved.bodies, layout);
+        configure(*restarted);
+        restarted->resume(saved.time);
+        for (int i = 0; i < 2; i++) {
+            restarted->step();
+        }
+        expectSameState(*restarted, *uninterrupted);
+    }
+}
+
+TEST_F(TestEngine, CountsEveryPairAtThetaZero) {
+    const size_t count = 300;
+    const vector<Body> bodies = randomBodies(count, 19);
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        auto engine = start(bodies, layout);
+        engine->setTheta(0);
+        engine->step();
+        const Metrics metrics = engine->getMetrics();
+        EXPECT_EQ(metrics.steps, 1u);
+        EXPECT_EQ(metrics.bodies, count);
+        EXPECT_EQ(metrics.bodyBody, count * (count - 1));
+        EXPECT_EQ(metrics.bodyNode, 0u);
+        EXPECT_GT(metrics.nodesOpened, 0u);
+        EXPECT_GT(metrics.nodesBuilt, 0u);
+        EXPECT_GT(metrics.maxDepth, 0u);
+    }
+    // direct summation evaluates every pair without building a tree
+    auto engine = start(bodies, OctreeLayout::POINTER);
+    engine->setSolver(ForceSolver::DIRECT);
+    engine->step();
+    const Metrics metrics = engine->getMetrics();
+    EXPECT_EQ(metrics.bodyBody, count * (count - 1));
+    EXPECT_EQ(metrics.nodesOpened, 0u);
+    EXPECT_EQ(metrics.nodesBuilt, 0u);
+}
+
+TEST_F(TestEngine, ForceErrorsVanishAtThetaZero) {
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        auto engine = start(randomBodies(1000, 23), layout);
+        const ForceErrors errors = engine->measureForceErrors(0, 200);
+        EXPECT_EQ(errors.samples, 200u);
+        EXPECT_LT(errors.max, ROUNDING_ERROR);
+        EXPECT_EQ(errors.bodyNode, 0);
+        EXPECT_EQ(errors.bodyBody, 999);
+    }
+}
+
+TEST_F(TestEngine, TunedThetaMeetsTarget) {
+    auto engine = start(randomBodies(2000, 29), OctreeLayout::POINTER);
+    for (double target : {1e-2, 1e-3}) {
+        const double theta = engine->tuneTheta(target, 300);
+        EXPECT_GT(theta, 0);
+        EXPECT_LE(engine->measureForceErrors(theta, 300).p99, target);
+    }
+}
+
+TEST_F(TestEngine, ForceErrorsSkipBodiesFeelingNoForce) {
+    // nothing pulls on the first body, as the second one has no mass
+    vector<Body> bodies = {
+        Body(Real(1e30), Vec3(0, 0, 0), Vec3(), Vec3()),
+        Body(0, Vec3(Real(1e11), 0, 0), Vec3(), Vec3()),
+    };
+    auto engine = start(bodies, OctreeLayout::POINTER);
+    const ForceErrors errors = engine->measureForceErrors(0.5, bodies.size());
+    EXPECT_EQ(errors.samples, 1u);
+    EXPECT_TRUE(isfinite(errors.max));
+    EXPECT_LT(errors.max, ROUNDING_ERROR);
+}
+
+TEST_F(TestEngine, WalksHandleAstronomicalScales) {
+    // squares of widths and distances at this scale overflow single
+    // precision, while the walks should be as accurate as at the usual one
+    const vector<Body> bodies = randomBodies(1000, 31);
+    vector<Body> scaled = bodies;
+    for (Body& body : scaled) {
+        body.position = body.position * Real(1e8);
+    }
+    for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+        const ForceErrors expected = start(bodies, layout)->measureForceErrors(0.5, 200);
+        const ForceErrors errors = start(scaled, layout)->measureForceErrors(0.5, 200);
+        EXPECT_NEAR(errors.bodyNode, expected.bodyNode, expected.bodyNode / 100);
+        EXPECT_LT(errors.p99, 2 * expected.p99);
+    }
+    auto grouped = start(bodies, OctreeLayout::FLAT);
+    grouped->setGroupSize(16);
+    const vector<double> expected = forceErrors(*grouped, directAccelerations(bodies));
+    grouped = start(scaled, OctreeLayout::FLAT);
+    grouped->setGroupSize(16);
+    const vector<double> errors = forceErrors(*grouped, directAccelerations(scaled));
+    EXPECT_LT(*max_element(errors.begin(), errors.end()), 2 * *max_element(expected.begin(), expected.end()));
+}
+
+#ifndef NBSIM_FLOAT
+TEST_F(TestEngine, CloseBodiesFarFromOriginFeelEachOther) {
+    // single precision resolves about 1e5 m this far from the origin, which
+    // must not apply to bodies with double precision positions
+    const Vec3 position{1e12, -1e12, 1e12};
+    const Vec3 offset{300, -400, 1200};
+    const vector<Body> bodies{
+        Body(1e3, position, Vec3(), Vec3()),
+        Body(1e3, position + offset, Vec3(), Vec3()),
+    };
+    // pulled towards each other, 1300 m apart
+    const Vec3 pull = offset * (GRAVITATIONAL_CONSTANT * 1e3 / pow(1300.0, 3));
+    const vector<Vec3> exact{pull, pull * -1};
+    for (ForceSolver solver : {ForceSolver::BARNES_HUT, ForceSolver::DIRECT, ForceSolver::FMM}) {
+        for (OctreeLayout layout : {OctreeLayout::POINTER, OctreeLayout::FLAT}) {
+            if (solver == ForceSolver::FMM && layout == OctreeLayout::POINTER)
+                continue;
+            auto engine = start(bodies, layout);
+            engine->setSolver(solver);
+            for (double error : forceErrors(*engine, exact)) {
+                EXPECT_LT(error, ROUNDING_ERROR) << "solver " << int(solver) << ", layout " << int(layout);
+            }
+        }
+    }
+    auto grouped = start(bodies, OctreeLayout::FLAT);
+    grouped->setGroupSize(16);
+    for (double error : forceErrors(*grouped, exact)) {
+        EXPECT_LT(error, ROUNDING_ERROR);
+    }
+}
+#endif
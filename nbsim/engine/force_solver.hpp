@@ -0,0 +1,8 @@
+#pragma once
+#ifndef FORCE_SOLVER_H
+#define FORCE_SOLVER_H
+
+// Methods the engine can compute gravitational forces with
+enum class ForceSolver : char { BARNES_HUT, FMM, DIRECT };
+
+#endif
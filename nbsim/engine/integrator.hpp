@@ -0,0 +1,13 @@
+#pragma once
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+// Schemes the engine can advance bodies in time with
+//
+// EULER kicks velocities with the current accelerations, then drifts positions
+// with the new velocities. LEAPFROG is the symplectic kick-drift-kick scheme,
+// second order and free of secular energy drift. YOSHIDA chains three leapfrog
+// substeps into a fourth order scheme, at three force evaluations per step.
+enum class Integrator : char { EULER, LEAPFROG, YOSHIDA };
+
+#endif
@@ -5,17 +5,31 @@
 #include <random>
 #include <sstream>
 #include <unordered_map>
-#include <unordered_set>
 
 #include "getopt.h"
+#include "nbsim/core/fmm/fmm_solver.hpp"
+#include "nbsim/core/gravity/gravity_kernel.hpp"
+#include "nbsim/core/input/body_parser.hpp"
+#include "nbsim/core/input/mapped_file.hpp"
 #include "nbsim/core/octree/object.hpp"
 #include "nbsim/core/octree/octree.hpp"
+#include "nbsim/core/snapshot/async_snapshot_writer.hpp"
+#include "nbsim/core/snapshot/checkpoint.hpp"
 #include "nbsim/core/vec3/vec3.hpp"
 #include "nbsim/engine/engine.hpp"
-#include "nbsim/engine/io_handler.hpp"
+#include "nbsim/engine/metrics.hpp"
 
 using namespace std;
 
+// Number of bodies up to which forces are summed directly by default. Below
+// it, a tiled sum over all pairs is faster than building and walking a tree.
+constexpr size_t DIRECT_BELOW = 1024;
+// no. of bodies force errors are measured on while tuning theta, unless given
+constexpr size_t ACCURACY_SAMPLES = 1000;
+// Bodies per leaf of the fast multipole method by default. Large leaves move
+// work from translations to direct sums, which are much cheaper per pair.
+constexpr size_t FMM_LEAF_SIZE = 64;
+
 /**
  * Generates a JSON string of randomly generated objects
  */
@@ -48,6 +62,100 @@ void generateRandomObjects(stringstream& stringOutput, size_t count) {
     stringOutput << "]}";
 }
 
+/**
+ * Inclusive range of body ids
+ */
+struct IdRange {
+    uint32_t first; // first id of the range
+    uint32_t last;  // last id of the range
+};
+
+/**
+ * Parses a comma separated list of body ids and inclusive ranges of ids, such
+ * as "0,4,10-20". Ranges are kept as such until the number of bodies is known.
+ * Throws std::runtime_error on malformed lists.
+ */
+vector<IdRange> parseBodyIds(const string& list) {
+    vector<IdRange> ranges;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ',')) {
+        size_t dash = item.find('-');
+        try {
+            size_t end = 0;
+            unsigned long first = stoul(item.substr(0, dash), &end);
+            unsigned long last = first;
+            if (end != item.substr(0, dash).size())
+                throw std::invalid_argument(item);
+            if (dash != string::npos) {
+                last = stoul(item.substr(dash + 1), &end);
+                if (end != item.size() - dash - 1)
+                    throw std::invalid_argument(item);
+            }
+            if (last < first || last > UINT32_MAX)
+                throw std::invalid_argument(item);
+            ranges.push_back(IdRange{uint32_t(first), uint32_t(last)});
+        } catch (std::logic_error&) {
+            throw std::runtime_error("Invalid body id or range \"" + item + "\".");
+        }
+    }
+    if (ranges.empty()) {
+        throw std::runtime_error("No bodies selected for output.");
+    }
+    return ranges;
+}
+
+/**
+ * Returns the ids in the given ranges, in order. Throws std::runtime_error if
+ * a range reaches beyond the given number of bodies, before expanding any, so
+ * that a huge range cannot exhaust memory.
+ */
+vector<uint32_t> expandBodyIds(const vector<IdRange>& ranges, size_t count) {
+    for (const IdRange& range : ranges) {
+        if (range.last >= count) {
+            throw std::runtime_error("Body id " + to_string(max<size_t>(range.first, count)) + " is out of range.");
+        }
+    }
+    vector<uint32_t> ids;
+    for (const IdRange& range : ranges) {
+        for (uint64_t id = range.first; id <= range.last; id++) {
+            ids.push_back(uint32_t(id));
+        }
+    }
+    return ids;
+}
+
+/**
+ * Parses a comma separated list of output fields into SnapshotField flags.
+ * Throws std::runtime_error on unknown fields.
+ */
+uint32_t parseFields(const string& list) {
+    uint32_t fields = 0;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (item == "id") {
+            fields |= FIELD_ID;
+        } else if (item == "mass") {
+            fields |= FIELD_MASS;
+        } else if (item == "position") {
+            fields |= FIELD_POSITION;
+        } else if (item == "velocity") {
+            fields |= FIELD_VELOCITY;
+        } else if (item == "acceleration") {
+            fields |= FIELD_ACCELERATION;
+        } else {
+            throw std::runtime_error(
+                "Unknown output field \"" + item + "\", expected id, mass, position, velocity or acceleration."
+            );
+        }
+    }
+    if (fields == 0) {
+        throw std::runtime_error("No output fields chosen.");
+    }
+    return fields;
+}
+
 struct NbsimOptions {
     /**
      * bit options for chosen parameters. The bits read as:
@@ -56,28 +164,51 @@ struct NbsimOptions {
      * 2 - any input chosen
      * 3 - any output chosen
      * 4 - is verbose mode enabled
+     * 5 - is Morton ordering of bodies enabled
+     * 6 - are quadrupole moments enabled
+     * 7 - are output fields chosen
+     * 8 - restart from a checkpoint chosen
+     * 9 - are time step and theta given
      */
-    bitset<5> options;
+    bitset<10> options;
     int nRand = 0;         // Number of planets to randomly generate
     size_t iterations = 0; // no. of iterations
     double timeStep = 1e2; // timestep to follow
     double theta = 0.5;    // theta param - level of approximation
     string finName;        // input filename
     string foutName;       // output filename
-};
-
-class Vec3HashFunction {
-  private:
-    hash<double> hasher;
-    const size_t C = 0x9e3779b9; // large prime
-  public:
-    size_t operator()(const Vec3& vec) const {
-        size_t seed = 0;
-        seed ^= hasher(vec.x) + C + (seed << 6) + (seed >> 2);
-        seed ^= hasher(vec.y) + C + (seed << 6) + (seed >> 2);
-        seed ^= hasher(vec.z) + C + (seed << 6) + (seed >> 2);
-        return seed;
-    }
+    size_t threads = 1;    // no. of threads to run on, zero for all
+    size_t leafSize = 0;   // max no. of bodies per tree leaf, zero for the default of the solver
+    double refit = -1;     // fraction of escaped bodies before a rebuild, negative to always rebuild
+    int order = 4;         // expansion order of the fast multipole method
+    // opening parameter of the fast multipole method
+    double fmmTheta = FmmSolver::DEFAULT_THETA;
+    size_t groupSize = 0;  // max no. of bodies sharing a tree walk, zero for one walk per body
+    // method forces are computed with
+    ForceSolver solver = ForceSolver::BARNES_HUT;
+    size_t directBelow = DIRECT_BELOW; // max no. of bodies summed directly whatever the solver
+    // scheme bodies are advanced in time with
+    Integrator integrator = Integrator::EULER;
+    int blockLevels = 0;         // deepest block timestep level, zero for one step for all bodies
+    double blockAccuracy = 0.02; // block timestep as a fraction of sqrt(length / |a|)
+    double blockLength = 0;      // length scale of the block timestep criterion, zero for the mean spacing
+    // memory layout of the spatial tree
+    OctreeLayout layout = OctreeLayout::POINTER;
+    // memory layout of the bodies
+    BodyStorage storage = BodyStorage::AOS;
+    // encoding of the output
+    SnapshotFormat format = SnapshotFormat::JSON;
+    size_t writeQueue = 4; // max no. of snapshots waiting to be written, zero to write synchronously
+    size_t every = 1;      // no. of steps between written snapshots
+    vector<IdRange> ids;   // ranges of ids of the bodies to write, empty for all
+    // SnapshotField flags of the values written per body
+    uint32_t fields = DEFAULT_FIELDS;
+    string checkpointName;        // checkpoint filename, empty for no checkpoints
+    size_t checkpointEvery = 100; // no. of steps between checkpoints
+    string restartName;           // checkpoint filename to restart from
+    string metricsName;           // metrics filename, empty for no metrics
+    size_t accuracySamples = 0;   // no. of bodies to report force errors on instead of simulating, zero to simulate
+    double targetError = -1;      // 99th percentile force error to tune theta to, negative to keep theta
 };
 
 void printHelp() {
@@ -92,10 +223,66 @@ void printHelp() {
     cout << "   options:\n";
     cout << setw(25) << "-o,--output filename"
          << "\tSpecifies filename, the output file for simulation results.\n ";
+    cout << setw(25) << "-f,--format format"
+         << "\tEncoding of the output: json, or binary records of float32 or float64 values. Defaults to json\n";
+    cout << setw(25) << "-w,--write-queue n"
+         << "\tWrites output on a background thread, at most n snapshots behind. 0 writes inline. Defaults to 4\n";
+    cout << setw(25) << "-e,--every n"
+         << "\tWrites a snapshot every n steps only. Defaults to 1\n";
+    cout << setw(25) << "-n,--bodies list"
+         << "\tWrites only the bodies with the given comma separated ids or ranges of ids, like 0,4,10-20\n";
+    cout << setw(25) << "-d,--fields list"
+         << "\tWrites only the given comma separated fields: id, mass, position, velocity, acceleration\n";
+    cout << setw(25) << "-c,--checkpoint filename"
+         << "\tPeriodically saves the full simulation state to filename, and once more at the end\n";
+    cout << setw(25) << "-x,--checkpoint-every n"
+         << "\tSaves a checkpoint every n steps. Defaults to 100\n";
+    cout << setw(25) << "-y,--restart filename"
+         << "\tContinues the run saved in checkpoint filename, up to iterations steps in total\n";
+    cout << setw(25) << "-M,--metrics filename"
+         << "\tWrites time spent per phase and tree work done by the run to filename as JSON\n";
     cout << setw(25) << "-i,--input filename"
          << "\tSpecifies filename, the input file to read objects from\n";
     cout << setw(25) << "-r,--random n"
          << "\tRandomly generates n objects to simulate.\n";
+    cout << setw(25) << "-l,--layout pointer|flat"
+         << "\tMemory layout of the spatial tree. Defaults to pointer\n";
+    cout << setw(25) << "-s,--storage aos|soa"
+         << "\tMemory layout of the bodies. soa requires the flat layout. Defaults to aos\n";
+    cout << setw(25) << "-b,--leaf-size k"
+         << "\tHolds up to k bodies per tree leaf. Above 1 requires the flat layout. Defaults to 64 for fmm, else 1\n";
+    cout << setw(25) << "-u,--refit fraction"
+         << "\tRefits the flat tree between steps, rebuilding once fraction of bodies left their cells\n";
+    cout << setw(25) << "-a,--solver bh|fmm|direct"
+         << "\tComputes forces with Barnes-Hut, the fast multipole method or all pairs. fmm requires the flat layout\n";
+    cout << setw(25) << "-D,--direct-below n"
+         << "\tSums forces over all pairs whatever the solver for up to n bodies, 0 never. Defaults to 1024\n";
+    cout << setw(25) << "-j,--integrator scheme"
+         << "\tTime integration: euler, leapfrog (kick-drift-kick) or yoshida (4th order). Defaults to euler\n";
+    cout << setw(25) << "-z,--block-levels n"
+         << "\tGives each body its own step of dt / 2^k, for k up to n. Requires leapfrog. Defaults to 0\n";
+    cout << setw(25) << "-A,--block-accuracy eta"
+         << "\tLimits each body's block step to eta * sqrt(length / |a|) for its acceleration a. Defaults to 0.02\n";
+    cout << setw(25) << "-L,--block-length length"
+         << "\tLength scale of the block step limit. Defaults to the mean spacing of the bodies\n";
+    cout << setw(25) << "-E,--accuracy n"
+         << "\tPrints Barnes-Hut force errors on n random bodies against exact sums as JSON, and exits\n";
+    cout << setw(25) << "-T,--tune-theta error"
+         << "\tReplaces theta by the largest up to 1 keeping 99% of force errors below error, e.g. 0.001\n";
+    cout << setw(25) << "-p,--order p"
+         << "\tExpansion order of the fast multipole method. Defaults to 4\n";
+    cout << setw(25) << "-F,--fmm-theta theta"
+         << "\tOpening parameter of the fast multipole method, in place of theta. Defaults to 0.7\n";
+    cout << setw(25) << "-q,--quadrupole"
+         << "\tAdds quadrupole moments to approximated tree nodes. Requires the flat layout\n";
+    cout << setw(25) << "-g,--group-size n"
+         << "\tLets up to n nearby bodies share one tree walk. Requires the flat layout. Defaults to 0, one per body\n";
+    cout << setw(25) << "-m,--morton"
+         << "\tSorts bodies along a Morton curve before every tree build\n";
+    cout << setw(25) << "-t,--threads n"
+         << "\tRuns the simulation on n threads, or on all hardware threads if n is 0. Defaults to 1\n";
+    cout << setw(25) << "-k,--kernel target"
+         << "\tInstruction set for gravity evaluation: auto, scalar, avx2 or avx512. Defaults to auto\n";
     cout << setw(25) << "-v,--verbose"
          << "\tPrints verbose output messages on simulation progress\n";
     cout << setw(25) << "-h,--help"
@@ -112,18 +299,105 @@ NbsimOptions getOptions(int argc, char** argv) {
     int choice;
     int opt_index;
     option long_options[] = {
-        {"output",  required_argument, nullptr, 'o'},
-        {"input",   required_argument, nullptr, 'i'},
-        {"random",  required_argument, nullptr, 'r'},
-        {"help",    no_argument,       nullptr, 'h'},
-        {"verbose", no_argument,       nullptr, 'v'}
+        {"output",           required_argument, nullptr, 'o'},
+        {"input",            required_argument, nullptr, 'i'},
+        {"random",           required_argument, nullptr, 'r'},
+        {"help",             no_argument,       nullptr, 'h'},
+        {"verbose",          no_argument,       nullptr, 'v'},
+        {"layout",           required_argument, nullptr, 'l'},
+        {"morton",           no_argument,       nullptr, 'm'},
+        {"threads",          required_argument, nullptr, 't'},
+        {"kernel",           required_argument, nullptr, 'k'},
+        {"storage",          required_argument, nullptr, 's'},
+        {"leaf-size",        required_argument, nullptr, 'b'},
+        {"refit",            required_argument, nullptr, 'u'},
+        {"solver",           required_argument, nullptr, 'a'},
+        {"integrator",       required_argument, nullptr, 'j'},
+        {"block-levels",     required_argument, nullptr, 'z'},
+        {"block-accuracy",   required_argument, nullptr, 'A'},
+        {"block-length",     required_argument, nullptr, 'L'},
+        {"direct-below",     required_argument, nullptr, 'D'},
+        {"accuracy",         required_argument, nullptr, 'E'},
+        {"tune-theta",       required_argument, nullptr, 'T'},
+        {"order",            required_argument, nullptr, 'p'},
+        {"fmm-theta",        required_argument, nullptr, 'F'},
+        {"quadrupole",       no_argument,       nullptr, 'q'},
+        {"group-size",       required_argument, nullptr, 'g'},
+        {"format",           required_argument, nullptr, 'f'},
+        {"write-queue",      required_argument, nullptr, 'w'},
+        {"every",            required_argument, nullptr, 'e'},
+        {"bodies",           required_argument, nullptr, 'n'},
+        {"fields",           required_argument, nullptr, 'd'},
+        {"checkpoint",       required_argument, nullptr, 'c'},
+        {"checkpoint-every", required_argument, nullptr, 'x'},
+        {"restart",          required_argument, nullptr, 'y'},
+        {"metrics",          required_argument, nullptr, 'M'},
+        {nullptr,            0,                 nullptr, 0  }
     };
-    while ((choice = getopt_long(argc, argv, "o:i:r:hv", long_options, &opt_index)) != -1) {
+    const char* shortOptions = "o:i:r:hvl:mt:k:s:b:u:a:D:j:z:A:L:p:F:qg:f:w:e:n:d:c:x:y:M:E:T:";
+    while ((choice = getopt_long(argc, argv, shortOptions, long_options, &opt_index)) != -1) {
         switch (choice) {
         case 'o':
             options.foutName = string(optarg);
             options.options[3] = true;
             break;
+        case 'f':
+            if (string(optarg) == "json") {
+                options.format = SnapshotFormat::JSON;
+            } else if (string(optarg) == "float32") {
+                options.format = SnapshotFormat::FLOAT32;
+            } else if (string(optarg) == "float64") {
+                options.format = SnapshotFormat::FLOAT64;
+            } else {
+                throw std::runtime_error("Unknown output format, expected json, float32 or float64.");
+            }
+            break;
+        case 'w': {
+            int writeQueue = atoi(optarg);
+            if (writeQueue < 0) {
+                throw std::runtime_error("Write queue length cannot be negative.");
+            }
+            options.writeQueue = size_t(writeQueue);
+            break;
+        }
+        case 'e': {
+            int every = atoi(optarg);
+            if (every < 1) {
+                throw std::runtime_error("Snapshots must be written at least every 1 step.");
+            }
+            options.every = size_t(every);
+            break;
+        }
+        case 'n':
+            options.ids = parseBodyIds(optarg);
+            break;
+        case 'd':
+            options.fields = parseFields(optarg);
+            options.options[7] = true;
+            break;
+        case 'c':
+            options.checkpointName = string(optarg);
+            break;
+        case 'x': {
+            int every = atoi(optarg);
+            if (every < 1) {
+                throw std::runtime_error("Checkpoints must be saved at least every 1 step.");
+            }
+            options.checkpointEvery = size_t(every);
+            break;
+        }
+        case 'y':
+            if (!options.options[2]) {
+                options.options[8] = true;
+                options.restartName = string(optarg);
+                options.options[2] = true;
+            } else {
+                throw std::runtime_error("Cannot set two different input modes");
+            }
+            break;
+        case 'M':
+            options.metricsName = string(optarg);
+            break;
         case 'i':
             if (!options.options[2]) {
                 options.options[0] = true;
@@ -154,15 +428,194 @@ NbsimOptions getOptions(int argc, char** argv) {
             break;
         case 'v':
             options.options[4] = true;
+            break;
+        case 'l':
+            if (string(optarg) == "pointer") {
+                options.layout = OctreeLayout::POINTER;
+            } else if (string(optarg) == "flat") {
+                options.layout = OctreeLayout::FLAT;
+            } else {
+                throw std::runtime_error("Unknown tree layout, expected pointer or flat.");
+            }
+            break;
+        case 'm':
+            options.options[5] = true;
+            break;
+        case 'q':
+            options.options[6] = true;
+            break;
+        case 'g': {
+            int groupSize = atoi(optarg);
+            if (groupSize < 0) {
+                throw std::runtime_error("Group size cannot be negative.");
+            }
+            options.groupSize = size_t(groupSize);
+            break;
+        }
+        case 's':
+            if (string(optarg) == "aos") {
+                options.storage = BodyStorage::AOS;
+            } else if (string(optarg) == "soa") {
+                options.storage = BodyStorage::SOA;
+            } else {
+                throw std::runtime_error("Unknown body storage, expected aos or soa.");
+            }
+            break;
+        case 't': {
+            int threads = atoi(optarg);
+            if (threads < 0) {
+                throw std::runtime_error("Cannot run on a negative number of threads.");
+            }
+            options.threads = size_t(threads);
+            break;
+        }
+        case 'b': {
+            int leafSize = atoi(optarg);
+            if (leafSize < 1) {
+                throw std::runtime_error("Leaves must hold at least one body.");
+            }
+            options.leafSize = size_t(leafSize);
+            break;
+        }
+        case 'u':
+            options.refit = atof(optarg);
+            if (options.refit < 0 || options.refit > 1) {
+                throw std::runtime_error("Refit fraction must be between 0 and 1.");
+            }
+            break;
+        case 'a':
+            if (string(optarg) == "bh") {
+                options.solver = ForceSolver::BARNES_HUT;
+            } else if (string(optarg) == "fmm") {
+                options.solver = ForceSolver::FMM;
+            } else if (string(optarg) == "direct") {
+                options.solver = ForceSolver::DIRECT;
+            } else {
+                throw std::runtime_error("Unknown solver, expected bh, fmm or direct.");
+            }
+            break;
+        case 'D': {
+            int below = atoi(optarg);
+            if (below < 0) {
+                throw std::runtime_error("Direct summation threshold cannot be negative.");
+            }
+            options.directBelow = size_t(below);
+            break;
+        }
+        case 'j':
+            if (string(optarg) == "euler") {
+                options.integrator = Integrator::EULER;
+            } else if (string(optarg) == "leapfrog") {
+                options.integrator = Integrator::LEAPFROG;
+            } else if (string(optarg) == "yoshida") {
+                options.integrator = Integrator::YOSHIDA;
+            } else {
+                throw std::runtime_error("Unknown integrator, expected euler, leapfrog or yoshida.");
+            }
+            break;
+        case 'z':
+            options.blockLevels = atoi(optarg);
+            if (options.blockLevels < 0 || options.blockLevels > 20) {
+                throw std::runtime_error("Block timestep levels must be between 0 and 20.");
+            }
+            break;
+        case 'A':
+            options.blockAccuracy = atof(optarg);
+            if (options.blockAccuracy <= 0) {
+                throw std::runtime_error("Block timestep accuracy must be greater than zero.");
+            }
+            break;
+        case 'L':
+            options.blockLength = atof(optarg);
+            if (options.blockLength <= 0) {
+                throw std::runtime_error("Block timestep length must be greater than zero.");
+            }
+            break;
+        case 'E': {
+            int samples = atoi(optarg);
+            if (samples < 1) {
+                throw std::runtime_error("Force errors must be measured on at least 1 body.");
+            }
+            options.accuracySamples = size_t(samples);
+            break;
+        }
+        case 'T':
+            options.targetError = atof(optarg);
+            if (options.targetError <= 0) {
+                throw std::runtime_error("Target force error must be greater than zero.");
+            }
+            break;
+        case 'p':
+            options.order = atoi(optarg);
+            if (options.order < 0 || options.order > FmmSolver::MAX_ORDER) {
+                throw std::runtime_error(
+                    "Expansion order must be between 0 and " + to_string(FmmSolver::MAX_ORDER) + "."
+                );
+            }
+            break;
+        case 'F':
+            options.fmmTheta = atof(optarg);
+            if (options.fmmTheta <= 0 || options.fmmTheta > 1) {
+                throw std::runtime_error("FMM theta must be greater than 0 and at most 1.");
+            }
+            break;
+        case 'k':
+            if (string(optarg) == "scalar") {
+                setKernelTarget(KernelTarget::SCALAR);
+            } else if (string(optarg) == "avx2") {
+                setKernelTarget(KernelTarget::AVX2);
+            } else if (string(optarg) == "avx512") {
+                setKernelTarget(KernelTarget::AVX512);
+            } else if (string(optarg) != "auto") {
+                throw std::runtime_error("Unknown gravity kernel, expected auto, scalar, avx2 or avx512.");
+            }
+            break;
         }
     }
     // asserts that an input mode is chosen
     if (!options.options[2]) {
         throw std::runtime_error("No input mode chosen");
     }
+    if (options.storage == BodyStorage::SOA && options.layout != OctreeLayout::FLAT) {
+        throw std::runtime_error("SoA body storage requires the flat tree layout.");
+    }
+    if (options.leafSize == 0) {
+        options.leafSize = options.solver == ForceSolver::FMM ? FMM_LEAF_SIZE : 1;
+    }
+    if (options.leafSize > 1 && options.layout != OctreeLayout::FLAT) {
+        throw std::runtime_error("Leaves holding several bodies require the flat tree layout.");
+    }
+    if (options.refit >= 0 && options.layout != OctreeLayout::FLAT) {
+        throw std::runtime_error("Refitting requires the flat tree layout.");
+    }
+    if (options.solver == ForceSolver::FMM && options.layout != OctreeLayout::FLAT) {
+        throw std::runtime_error("The FMM solver requires the flat tree layout.");
+    }
+    if (options.options[6] && options.layout != OctreeLayout::FLAT) {
+        throw std::runtime_error("Quadrupole moments require the flat tree layout.");
+    }
+    if (options.groupSize > 0 && options.layout != OctreeLayout::FLAT) {
+        throw std::runtime_error("Grouped tree walks require the flat tree layout.");
+    }
+    if (options.blockLevels > 0 && options.integrator != Integrator::LEAPFROG) {
+        throw std::runtime_error("Block timesteps require the leapfrog integrator.");
+    }
+    if ((options.accuracySamples > 0 || options.targetError > 0) && options.solver != ForceSolver::BARNES_HUT) {
+        throw std::runtime_error("Force errors are measured on Barnes-Hut walks and require the bh solver.");
+    }
+    // a selection of bodies is useless without knowing which body is which
+    if (!options.ids.empty() && !options.options[7]) {
+        options.fields |= FIELD_ID;
+    }
 
     // ---- REMAINDER PARAMETER HANDLING ----
     size_t index = optind;
+    // a restart may take time step and theta from the checkpoint
+    if (options.options[8] && argc - optind == 1) {
+        options.iterations = size_t(atoi(argv[index]));
+        return options;
+    }
+    options.options[9] = true;
     if (argv[index] != nullptr) {
         options.timeStep = atof(argv[index++]);
         if (options.timeStep <= 0) {
@@ -191,37 +644,23 @@ NbsimOptions getOptions(int argc, char** argv) {
     return options;
 }
 
-Engine* setupEngine(const NbsimOptions& options, IOHandler& io) {
-    vector<Body> bodies;
-    unordered_set<Vec3, Vec3HashFunction> positions;
-    // load objects into vector
-    size_t body_count = 0;
-    double max_coord = 0;
-    while (io) {
-        Body temp;
-        io >> temp;
-        auto duplicateIter = positions.find(temp.position);
-        if (duplicateIter != positions.end()) {
-            // Hash check triggered - do finer comparision to make sure they
-            // actually conflict
-            if (temp.position == *duplicateIter && options.options[0]) {
-                ostringstream str;
-                str << "Body at index " << body_count << " in " << options.finName
-                    << " has the same position as another body, which is "
-                       "not allowed.";
-                throw std::runtime_error(str.str());
-            }
-        }
-        double max_obj_coord = max(abs(temp.position.x), max(abs(temp.position.y), abs(temp.position.z)));
-        max_coord = max(max_coord, max_obj_coord);
-        bodies.push_back(temp);
-        positions.insert(temp.position);
-        body_count++;
-    }
-    Engine* engine = new Engine(options.theta, options.timeStep, max_coord);
-    for (Body& body : bodies) {
-        engine->addBody(body);
-    }
+Engine* setupEngine(const NbsimOptions& options) {
+    // the tree is sized to the bodies once they are all loaded
+    Engine* engine = new Engine(options.theta, options.timeStep);
+    engine->setLayout(options.layout);
+    engine->setStorage(options.storage);
+    engine->setLeafSize(options.leafSize);
+    engine->setRefitThreshold(options.refit);
+    engine->setSolver(options.solver);
+    engine->setDirectThreshold(options.directBelow);
+    engine->setIntegrator(options.integrator);
+    engine->setTimestepLevels(options.blockLevels, options.blockAccuracy, options.blockLength);
+    engine->setQuadrupoles(options.options[6]);
+    engine->setGroupSize(options.groupSize);
+    engine->setExpansionOrder(options.order);
+    engine->setFmmTheta(options.fmmTheta);
+    engine->setMortonOrdering(options.options[5]);
+    engine->setThreads(options.threads);
     return engine;
 }
 
@@ -231,53 +670,148 @@ int main(int argc, char** argv) {
     ios_base::sync_with_stdio(false);
 #endif
     NbsimOptions options;
-    IOHandler* io = nullptr;
     Engine* engine = nullptr;
-    ifstream fin;
+    AsyncSnapshotWriter* writer = nullptr;
     ofstream fout;
-    stringstream inputString; // holds random output if used
+    ofstream metricsOut;
+    vector<uint32_t> ids; // ids of the bodies to write, empty for all
+    size_t firstStep = 0; // no. of steps simulated before this run
+    double startTime = 0; // simulation time this run starts at
     try {
         options = getOptions(argc, argv);
-        if (options.options[1])
+        // all input errors resolved, parse the input. Parsed bodies go
+        // straight into the engine, which only builds its tree once all are in.
+        Checkpoint restart{};
+        if (options.options[8]) {
+            restart = readCheckpoint(options.restartName);
+            firstStep = restart.step;
+            startTime = restart.state.time;
+            if (!options.options[9]) {
+                options.timeStep = restart.dt;
+                options.theta = restart.theta;
+            }
+        }
+        engine = setupEngine(options);
+        if (options.options[8]) {
+            for (const Body& body : restart.state.bodies) {
+                engine->addBody(body);
+            }
+            // the engine keeps its own copy of every body
+            vector<Body>().swap(restart.state.bodies);
+            engine->resume(startTime);
+        } else if (options.options[0]) {
+            MappedFile input(options.finName);
+            BodyParser(input.contents()).parse([engine](const Body& body) { engine->addBody(body); });
+            size_t coincident = engine->findCoincidentBody();
+            if (coincident < engine->count()) {
+                ostringstream str;
+                str << "Body at index " << coincident << " in " << options.finName
+                    << " has the same position as another body, which is "
+                       "not allowed.";
+                throw std::runtime_error(str.str());
+            }
+        } else {
+            stringstream inputString;
             generateRandomObjects(inputString, options.nRand);
-
-        // all input errors resolved, open files if needed
-        if (options.options[0]) {
-            fin.open(options.finName);
-            if (!fin.is_open()) {
-                throw std::runtime_error("Could not open input file.");
+            const string input = inputString.str();
+            BodyParser(input).parse([engine](const Body& body) { engine->addBody(body); });
+        }
+        if (options.targetError > 0) {
+            size_t samples = options.accuracySamples ? options.accuracySamples : ACCURACY_SAMPLES;
+            options.theta = engine->tuneTheta(options.targetError, samples);
+            engine->setTheta(options.theta);
+            if (options.options[4]) {
+                cout << "Tuned theta: " << options.theta << endl;
             }
         }
-        if (options.options[2]) {
-            fout.open(options.foutName);
+        if (options.accuracySamples > 0) {
+            engine->measureForceErrors(options.theta, options.accuracySamples).writeJson(cout);
+            delete engine;
+            return 0;
+        }
+        if (options.options[3]) {
+            // binary snapshots must not have line endings translated
+            ios::openmode mode = ios::out;
+            if (options.format != SnapshotFormat::JSON)
+                mode |= ios::binary;
+            fout.open(options.foutName, mode);
             if (!fout.is_open()) {
                 throw std::runtime_error("Could not open output file.");
             }
         }
+        // opened up front, so that a bad path fails before the run rather
+        // than after it
+        if (!options.metricsName.empty()) {
+            metricsOut.open(options.metricsName);
+            if (!metricsOut.is_open()) {
+                throw std::runtime_error("Could not open metrics file.");
+            }
+        }
 
-        // need to cast fin/fout to regular stream b/c it is a derived type
-        istream& input = (options.options[0]) ? static_cast<istream&>(fin) : inputString;
-        ostream& output = (options.options[2]) ? static_cast<ostream&>(fout) : cout;
-        io = new IOHandler(input, output);
-        engine = setupEngine(options, *io);
+        // need to cast fout to regular stream b/c it is a derived type
+        ostream& output = (options.options[3]) ? static_cast<ostream&>(fout) : cout;
+        ids = expandBodyIds(options.ids, engine->count());
+        // the console is shared with progress messages, so only files are
+        // written in the background
+        size_t writeQueue = (options.options[3]) ? options.writeQueue : 0;
+        writer = new AsyncSnapshotWriter(output, options.format, writeQueue, options.fields);
     } catch (std::exception& e) {
         cerr << "ERROR:" << e.what() << endl;
         return 1;
     }
     size_t iterations = options.iterations;
-    *io << "{\"history\":[";
-    for (size_t i = 0; i < iterations; i++) {
-        *io << engine->step();
-        if (i < iterations - 1)
-            *io << ",";
-        if (options.options[4]) {
-            cout << "Step: " << i + 1 << "/" << iterations << endl;
+    Snapshot snapshot;
+    Checkpoint checkpoint{0, options.timeStep, options.theta, Snapshot{}};
+    // serialization and output happen here, so they are timed here
+    Metrics metrics;
+    try {
+        // steps are numbered from the start of the original run, so output
+        // and checkpoints line up across restarts
+        for (size_t i = firstStep; i < iterations; i++) {
+            engine->step();
+            if ((i + 1) % options.every == 0) {
+                {
+                    PhaseTimer timer(metrics.serializeSeconds);
+                    if (ids.empty())
+                        engine->snapshot(snapshot);
+                    else
+                        engine->snapshot(snapshot, ids);
+                }
+                PhaseTimer timer(metrics.writeSeconds);
+                writer->write(snapshot);
+            }
+            if (!options.checkpointName.empty() && ((i + 1) % options.checkpointEvery == 0 || i + 1 == iterations)) {
+                checkpoint.step = i + 1;
+                {
+                    PhaseTimer timer(metrics.serializeSeconds);
+                    engine->snapshot(checkpoint.state);
+                }
+                PhaseTimer timer(metrics.writeSeconds);
+                writeCheckpoint(options.checkpointName, checkpoint);
+            }
+            if (options.options[4]) {
+                cout << "Step: " << i + 1 << "/" << iterations << endl;
+            }
+        }
+        {
+            PhaseTimer timer(metrics.writeSeconds);
+            writer->close();
         }
+        if (!options.metricsName.empty()) {
+            const double serializeSeconds = metrics.serializeSeconds;
+            const double writeSeconds = metrics.writeSeconds;
+            metrics = engine->getMetrics();
+            metrics.serializeSeconds = serializeSeconds;
+            metrics.writeSeconds = writeSeconds;
+            metrics.writeJson(metricsOut);
+        }
+    } catch (std::exception& e) {
+        cerr << "ERROR:" << e.what() << endl;
+        return 1;
     }
-    *io << "]}";
 
     // cleanup procedures
+    delete writer;
     delete engine;
-    delete io;
     return 0;
 }
\ No newline at end of file
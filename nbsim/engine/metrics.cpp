@@ -0,0 +1,28 @@
+#include "nbsim/engine/metrics.hpp"
+
+using namespace std;
+
+void Metrics::writeJson(ostream& out) const {
+    const double perStep = steps ? 1.0 / double(steps) : 0;
+    const double seconds = forceSeconds + integrateSeconds + treeSeconds + serializeSeconds + writeSeconds;
+    auto phases = [&](double scale) {
+        out << "{\"total\":" << seconds * scale << ",\"force\":" << forceSeconds * scale
+            << ",\"integrate\":" << integrateSeconds * scale << ",\"tree\":" << treeSeconds * scale
+            << ",\"serialize\":" << serializeSeconds * scale << ",\"write\":" << writeSeconds * scale << "}";
+    };
+    // totals are exact integers, means per step are not
+    auto counters = [&](auto scale) {
+        out << "{\"nodesBuilt\":" << nodesBuilt * scale << ",\"nodesOpened\":" << nodesOpened * scale
+            << ",\"bodyNodeInteractions\":" << bodyNode * scale << ",\"bodyBodyInteractions\":" << bodyBody * scale
+            << "}";
+    };
+    out << "{\"steps\":" << steps << ",\"bodies\":" << bodies << ",\"maxDepth\":" << maxDepth << ",\"seconds\":";
+    phases(1);
+    out << ",\"secondsPerStep\":";
+    phases(perStep);
+    out << ",\"counts\":";
+    counters(uint64_t(1));
+    out << ",\"countsPerStep\":";
+    counters(perStep);
+    out << "}\n";
+}
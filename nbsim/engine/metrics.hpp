@@ -0,0 +1,53 @@
+#pragma once
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * Totals of the time spent and the work done by a run, for sizing jobs and
+ * noticing when a change of code or input makes runs slower.
+ *
+ * Interactions count sources summed into the acceleration of a body: tree
+ * nodes approximated by their center of mass, and bodies summed one by one by
+ * tree walks and direct summation. The fast multipole method counts no
+ * interactions.
+ */
+struct Metrics {
+    uint64_t steps = 0;            // time steps taken
+    uint64_t bodies = 0;           // bodies simulated
+    double forceSeconds = 0;       // wall time spent computing accelerations
+    double integrateSeconds = 0;   // wall time spent advancing velocities and positions
+    double treeSeconds = 0;        // wall time spent rebuilding or refitting the tree
+    double serializeSeconds = 0;   // wall time spent copying state into snapshots and checkpoints
+    double writeSeconds = 0;       // wall time spent handing snapshots and checkpoints to output
+    uint64_t nodesBuilt = 0;       // tree nodes created by rebuilds
+    uint64_t maxDepth = 0;         // depth of the deepest tree node
+    uint64_t nodesOpened = 0;      // tree nodes opened by walks
+    uint64_t bodyNode = 0;         // body-node interactions
+    uint64_t bodyBody = 0;         // body-body interactions
+
+    // Writes the totals, and their mean per step, as a JSON object
+    void writeJson(std::ostream& out) const;
+};
+
+/**
+ * Adds the wall time from its construction to its destruction to a total
+ */
+class PhaseTimer {
+  private:
+    // Total the elapsed time is added to, in seconds
+    double& total;
+    // Time the timer was started at
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    explicit PhaseTimer(double& total) : total{total}, start{std::chrono::steady_clock::now()} {}
+    ~PhaseTimer() { total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+    PhaseTimer(const PhaseTimer& other) = delete;
+    PhaseTimer& operator=(const PhaseTimer& other) = delete;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "nbsim/engine/metrics.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace std;
+
+TEST(TestMetrics, WritesTotalsAndMeansPerStep) {
+    Metrics metrics;
+    metrics.steps = 2;
+    metrics.bodies = 10;
+    metrics.forceSeconds = 3;
+    metrics.integrateSeconds = 1;
+    metrics.treeSeconds = 0.5;
+    metrics.serializeSeconds = 0.25;
+    metrics.writeSeconds = 0.25;
+    metrics.nodesBuilt = 8;
+    metrics.maxDepth = 3;
+    metrics.nodesOpened = 20;
+    metrics.bodyNode = 6;
+    metrics.bodyBody = 90;
+    ostringstream out;
+    metrics.writeJson(out);
+    EXPECT_EQ(
+        out.str(),
+        "{\"steps\":2,\"bodies\":10,\"maxDepth\":3,"
+        "\"seconds\":{\"total\":5,\"force\":3,\"integrate\":1,\"tree\":0.5,\"serialize\":0.25,\"write\":0.25},"
+        "\"secondsPerStep\":{\"total\":2.5,\"force\":1.5,\"integrate\":0.5,\"tree\":0.25,\"serialize\":0.125,"
+        "\"write\":0.125},"
+        "\"counts\":{\"nodesBuilt\":8,\"nodesOpened\":20,\"bodyNodeInteractions\":6,\"bodyBodyInteractions\":90},"
+        "\"countsPerStep\":{\"nodesBuilt\":4,\"nodesOpened\":10,\"bodyNodeInteractions\":3,"
+        "\"bodyBodyInteractions\":45}}\n"
+    );
+}
+
+TEST(TestMetrics, WritesZeroMeansWithoutSteps) {
+    Metrics metrics;
+    metrics.forceSeconds = 1;
+    metrics.bodyBody = 12;
+    ostringstream out;
+    metrics.writeJson(out);
+    EXPECT_NE(out.str().find("\"secondsPerStep\":{\"total\":0,\"force\":0,"), string::npos);
+    EXPECT_NE(out.str().find("\"countsPerStep\":{\"nodesBuilt\":0,"), string::npos);
+    EXPECT_NE(out.str().find("\"bodyBodyInteractions\":12}"), string::npos);
+}